@@ -8,7 +8,10 @@
  *
  */
 
+#include <string.h>
+
 #include "CAN.h"
+#include "can_stats.h"
 
 #include "sam.h"
 
@@ -21,7 +24,18 @@
 
 #define F_MCK (84000000)  // 84MHz
 
-#define BRP_CALCULATE(baudrate) ((uint32_t) (F_MCK) / ((uint32_t) baudrate) - 1)
+// Bit timing, solved at compile time; TQ = (BRP + 1) / F_MCK
+#define M_SP CAN_SAMPLE_POINT_PERMILLE
+enum { M_TQ_PER_BIT = CAN_BT_TQ(F_MCK, 1, 0x7F, CAN_BITRATE, M_SP) };
+_Static_assert(M_TQ_PER_BIT != 0, "no SAM3X CAN bit timing for CAN_BITRATE and CAN_SAMPLE_POINT_PERMILLE");
+_Static_assert(CAN_BT_SAMPLE_POINT_OK(M_TQ_PER_BIT, M_SP), "SAM3X CAN sample point out of tolerance");
+
+#define M_CAN_BR (CAN_BR_PHASE2(CAN_BT_PHASE2(M_TQ_PER_BIT, M_SP) - 1) | \
+                  CAN_BR_PHASE1(CAN_BT_PHASE1(M_TQ_PER_BIT, M_SP) - 1) | \
+                  CAN_BR_PROPAG(CAN_BT_PROP(M_TQ_PER_BIT, M_SP) - 1) | \
+                  CAN_BR_SJW(CAN_BT_SJW(M_TQ_PER_BIT, M_SP) - 1) | \
+                  CAN_BR_BRP(CAN_BT_BRP(F_MCK, CAN_BITRATE, M_TQ_PER_BIT)) | \
+                  CAN_BR_SMP_ONCE)
 
 static can_rx_handler_t m_rx_handler;
 static can_tx_handler_t m_tx_handler;
@@ -29,6 +43,70 @@ static can_tx_handler_t m_tx_handler;
 static uint8_t m_rx_buf_count;
 static uint8_t m_tx_buf_count;
 
+static can_error_handler_t m_error_handler;
+
+// Shared with the interrupt handler
+static can_error_stats_t m_error_stats;
+static bool m_bus_off_pending;
+
+// CAN disabled until the bus-off backoff has passed
+static bool m_recovering;
+static uint32_t m_recover_at_ms;
+static uint32_t m_last_recovery_ms;
+static can_error_state_t m_reported_state;
+
+// Status bits set for every error frame, cleared on read
+#define M_CAN_SR_BUS_ERRORS (CAN_SR_CERR | CAN_SR_SERR | CAN_SR_AERR | CAN_SR_FERR | CAN_SR_BERR)
+
+static void m_count(uint16_t * p_count)
+{
+    if (*p_count < UINT16_MAX)
+    {
+        (*p_count)++;
+    }
+}
+
+// Account for a CAN_SR value. Reading CAN_SR clears the error frame bits, so
+// every read must go through here. Call with the CAN interrupt disabled.
+static void m_error_sr_update(uint32_t can_sr)
+{
+    can_error_state_t state;
+
+    if (can_sr & M_CAN_SR_BUS_ERRORS)
+    {
+        m_count(&m_error_stats.bus_error_count);
+    }
+
+    if (m_recovering)
+    {
+        return;
+    }
+
+    if (can_sr & CAN_SR_BOFF)
+    {
+        state = CAN_ERROR_STATE_BUS_OFF;
+    }
+    else if (can_sr & CAN_SR_ERRP)
+    {
+        state = CAN_ERROR_STATE_PASSIVE;
+    }
+    else if (can_sr & CAN_SR_WARN)
+    {
+        state = CAN_ERROR_STATE_WARNING;
+    }
+    else
+    {
+        state = CAN_ERROR_STATE_ACTIVE;
+    }
+
+    if (state == CAN_ERROR_STATE_BUS_OFF && m_error_stats.state != CAN_ERROR_STATE_BUS_OFF)
+    {
+        m_count(&m_error_stats.bus_off_count);
+        m_bus_off_pending = true;
+    }
+    m_error_stats.state = state;
+}
+
 static void m_rx_parse(uint8_t buf_no, can_msg_rx_t *msg, uint8_t *data)
 {
     //Get data from CAN mailbox
@@ -68,10 +146,20 @@ static void m_rx_evt_handle(uint8_t buf_no)
     static can_msg_rx_t rx_msg;
     static uint8_t rx_data_buf[8];
 
+    // Read once: reading clears MMI
+    uint32_t can_msr = CAN0->CAN_MB[buf_no].CAN_MSR;
+
+    // A frame arrived while the mailbox was still full and was dropped
+    if (can_msr & CAN_MSR_MMI)
+    {
+        m_count(&m_error_stats.rx_overflow_count);
+    }
+
     // Double check that mailbox is ready
-    if (CAN0->CAN_MB[buf_no].CAN_MSR & CAN_MSR_MRDY)
+    if (can_msr & CAN_MSR_MRDY)
     {
         m_rx_parse(buf_no, &rx_msg, &rx_data_buf[0]);
+        can_stats_rx((uint16_t) rx_msg.id.value, rx_msg.data.len);
         m_rx_handler(buf_no, &rx_msg);
     }
 }
@@ -83,7 +171,9 @@ void CAN0_Handler(void)
         uart_printf("CAN0 interrupt\n\r");
     }
 
-    char can_sr = CAN0->CAN_SR;
+    uint32_t can_sr = CAN0->CAN_SR;
+
+    m_error_sr_update(can_sr);
 
 	for (uint8_t tx_buf = 0; tx_buf < m_tx_buf_count; tx_buf++)
 	{
@@ -107,6 +197,11 @@ void CAN0_Handler(void)
 			uart_printf("CAN0 ERRP error\n\r");
 		}
     }
+    if (can_sr & CAN_SR_BOFF)
+    {
+        // Level triggered; can_error_poll() enables it again after recovery
+        CAN0->CAN_IDR = CAN_IDR_BOFF;
+    }
     if (can_sr & CAN_SR_TOVF)
     {
     	if (DEBUG_INTERRUPT) {
@@ -141,14 +236,16 @@ uint8_t can_init(const can_init_t * init_params)
 		return CAN_ERROR_INVALID;
 	}
 
-    uint32_t brp = BRP_CALCULATE(init_params->bit.baudrate);
-	if (brp < 1 || 0x7F < brp)
-	{
-		return CAN_ERROR_INVALID;
-	}
-
     m_rx_handler = init_params->rx_handler;
     m_tx_handler = init_params->tx_handler;
+    m_error_handler = init_params->error_handler;
+
+    memset(&m_error_stats, 0, sizeof(m_error_stats));
+    m_error_stats.backoff_ms = CAN_BUS_OFF_BACKOFF_MIN_MS;
+    m_bus_off_pending = false;
+    m_recovering = false;
+    m_reported_state = CAN_ERROR_STATE_ACTIVE;
+    can_stats_init();
 
     uint32_t ul_status;
 	(void)ul_status;
@@ -172,16 +269,11 @@ uint8_t can_init(const can_init_t * init_params)
     PIOA->PIO_PUER = (PIO_PA1A_CANRX0 | PIO_PA0A_CANTX0);
 
     //Enable Clock for CAN0 in PMC
-    PMC->PMC_PCR = PMC_PCR_EN | (0 << PMC_PCR_DIV_Pos) | PMC_PCR_CMD | (ID_CAN0 << PMC_PCR_PID_Pos); // DIV = 1(can clk = MCK/2), CMD = 1 (write), PID = 2B (CAN0)
+    PMC->PMC_PCR = PMC_PCR_EN | (0 << PMC_PCR_DIV_Pos) | PMC_PCR_CMD | (ID_CAN0 << PMC_PCR_PID_Pos); // DIV = 0 (can clk = MCK, as the bit timing assumes), CMD = 1 (write), PID = 2B (CAN0)
     PMC->PMC_PCER1 |= 1 << (ID_CAN0 - 32);
 
-    //Set baudrate, Phase1, phase2 and propagation delay for can bus. Must match on all nodes!
-    CAN0->CAN_BR = CAN_BR_PHASE2(init_params->bit.phase_2_len - 1) |
-                   CAN_BR_PHASE1(init_params->bit.phase_1_len - 1) |
-                   CAN_BR_PROPAG(init_params->bit.prop_seg_len - 1) |
-                   CAN_BR_SJW(init_params->bit.sync_jump_len - 1) |
-                   CAN_BR_BRP(brp) |
-                   CAN_BR_SMP_ONCE;
+    //Set baudrate, Phase1, phase2 and propagation delay for can bus. Solved from CAN_BITRATE, shared by all nodes
+    CAN0->CAN_BR = M_CAN_BR;
 
     /****** Start of mailbox configuration ******/
     m_rx_buf_count = init_params->buf.rx_buf_count;
@@ -213,6 +305,10 @@ uint8_t can_init(const can_init_t * init_params)
 
     /****** End of mailbox configuraion ******/
 
+    // Error frames and bus-off. The other error state bits are levels and
+    // would interrupt continuously, so can_error_poll() reads them instead.
+    can_ier |= CAN_IER_CERR | CAN_IER_SERR | CAN_IER_AERR | CAN_IER_FERR | CAN_IER_BERR | CAN_IER_BOFF;
+
     //Enable interrupt on receive mailboxes
     CAN0->CAN_IER = can_ier;
 
@@ -278,6 +374,7 @@ uint8_t can_data_send(uint8_t tx_buf_no, const can_id_t *id, const can_data_t *d
 
     //Set message length and mailbox ready to send
     CAN0->CAN_MB[tx_buf_no].CAN_MCR = CAN_MCR_MDLC(data->len) | CAN_MCR_MTCR;
+    can_stats_tx((uint16_t) id->value, data->len);
 
     return CAN_SUCCESS;
 }
@@ -290,3 +387,64 @@ uint8_t can_get_error_counters(can_error_counter_t * counts)
 
     return CAN_SUCCESS;
 }
+
+void can_error_poll(uint32_t now_ms)
+{
+    NVIC_DisableIRQ(ID_CAN0);
+
+    // The error state bits do not interrupt, so read them here
+    m_error_sr_update(CAN0->CAN_SR);
+    (void) can_get_error_counters(&m_error_stats.counters);
+
+    if (m_bus_off_pending)
+    {
+        // Stay off the bus for the backoff time. Pending transmissions are
+        // dropped; the application resends periodically anyway.
+        m_bus_off_pending = false;
+        CAN0->CAN_ACR = (1 << m_tx_buf_count) - 1;
+        CAN0->CAN_MR &= ~CAN_MR_CANEN;
+        m_recovering = true;
+        m_recover_at_ms = now_ms + m_error_stats.backoff_ms;
+    }
+    else if (m_recovering && (int32_t) (now_ms - m_recover_at_ms) >= 0)
+    {
+        // The controller rejoins after 128 x 11 recessive bits
+        CAN0->CAN_MR |= CAN_MR_CANEN;
+        CAN0->CAN_IER = CAN_IER_BOFF;
+        m_recovering = false;
+        m_last_recovery_ms = now_ms;
+        m_count(&m_error_stats.recovery_count);
+        m_error_stats.backoff_ms = MIN(m_error_stats.backoff_ms * 2, CAN_BUS_OFF_BACKOFF_MAX_MS);
+    }
+    else if (!m_recovering &&
+             m_error_stats.state != CAN_ERROR_STATE_BUS_OFF &&
+             now_ms - m_last_recovery_ms >= CAN_BUS_OFF_STABLE_MS)
+    {
+        m_error_stats.backoff_ms = CAN_BUS_OFF_BACKOFF_MIN_MS;
+    }
+
+    can_error_stats_t stats = m_error_stats;
+
+    NVIC_EnableIRQ(ID_CAN0);
+
+    if (stats.state != m_reported_state)
+    {
+        m_reported_state = stats.state;
+        if (m_error_handler)
+        {
+            m_error_handler(stats.state, &stats);
+        }
+    }
+}
+
+void can_error_stats_get(can_error_stats_t * stats)
+{
+    if (!stats)
+    {
+        return;
+    }
+
+    NVIC_DisableIRQ(ID_CAN0);
+    *stats = m_error_stats;
+    NVIC_EnableIRQ(ID_CAN0);
+}
@@ -0,0 +1,25 @@
+/*
+ * Node2 side of the shared CAN statistics (common/src/can_stats.c).
+ */
+#ifndef CAN_STATS_PORT_H__
+#define CAN_STATS_PORT_H__
+
+#include <stdint.h>
+#include <sam3x8e.h>
+
+typedef uint32_t can_stats_lock_t;
+
+// Disable interrupts, returning the state to restore
+static inline can_stats_lock_t can_stats_lock(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static inline void can_stats_unlock(can_stats_lock_t primask)
+{
+    __set_PRIMASK(primask);
+}
+
+#endif /* CAN_STATS_PORT_H__ */
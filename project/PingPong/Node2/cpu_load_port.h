@@ -0,0 +1,32 @@
+/*
+ * Node2 side of the shared CPU load accounting (common/src/cpu_load.c),
+ * counting with the Cortex-M3 DWT cycle counter at MCK.
+ */
+#ifndef CPU_LOAD_PORT_H__
+#define CPU_LOAD_PORT_H__
+
+#include <stdint.h>
+#include <sam3x8e.h>
+
+#define CPU_LOAD_F_MCK (84000000)  // 84MHz
+
+#define CPU_LOAD_CYCLES_PER_MS (CPU_LOAD_F_MCK / 1000)
+
+static inline void cpu_load_cycles_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cpu_load_cycles_get(void)
+{
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t cpu_load_cycles_to_us(uint32_t cycles)
+{
+    return cycles / (CPU_LOAD_F_MCK / 1000000);
+}
+
+#endif /* CPU_LOAD_PORT_H__ */
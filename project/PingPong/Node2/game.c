@@ -0,0 +1,95 @@
+#include "game.h"
+
+#include "timer.h"
+
+static game_state_t m_state;
+static uint8_t m_lives;
+
+static uint32_t m_start_ms;
+static uint32_t m_end_ms;        // end of the game, for a frozen elapsed time
+static uint32_t m_resume_ms;     // when play last started or resumed
+static uint32_t m_goal_ms;       // when the last goal was scored
+static uint32_t m_play_ms;       // time in play before m_resume_ms
+
+static uint32_t m_play_time_get(uint32_t now)
+{
+    return m_state == GAME_STATE_PLAYING ? m_play_ms + (now - m_resume_ms) : m_play_ms;
+}
+
+void game_init(void)
+{
+    m_state = GAME_STATE_IDLE;
+    m_lives = 0;
+    m_start_ms = 0;
+    m_end_ms = 0;
+    m_play_ms = 0;
+}
+
+void game_start(void)
+{
+    uint32_t now = timer_ms_get();
+
+    m_state = GAME_STATE_PLAYING;
+    m_lives = GAME_START_LIVES;
+    m_start_ms = now;
+    m_resume_ms = now;
+    m_play_ms = 0;
+}
+
+void game_abort(void)
+{
+    m_state = GAME_STATE_IDLE;
+}
+
+void game_goal(uint32_t timestamp_ms)
+{
+    if (m_state != GAME_STATE_PLAYING || (int32_t) (timestamp_ms - m_resume_ms) < 0)
+    {
+        return;
+    }
+
+    m_play_ms += timestamp_ms - m_resume_ms;
+    m_goal_ms = timestamp_ms;
+    m_lives--;
+
+    if (m_lives == 0)
+    {
+        m_state = GAME_STATE_GAME_OVER;
+        m_end_ms = timestamp_ms;
+    }
+    else
+    {
+        m_state = GAME_STATE_GOAL;
+    }
+}
+
+void game_update(void)
+{
+    uint32_t now = timer_ms_get();
+
+    if (m_state == GAME_STATE_GOAL && now - m_goal_ms >= GAME_GOAL_PAUSE_MS)
+    {
+        m_state = GAME_STATE_PLAYING;
+        m_resume_ms = now;
+    }
+}
+
+void game_frame_get(game_frame_t * p_frame_out)
+{
+    uint32_t now = timer_ms_get();
+    uint32_t elapsed_ms = 0;
+
+    if (m_state == GAME_STATE_GAME_OVER)
+    {
+        elapsed_ms = m_end_ms - m_start_ms;
+    }
+    else if (m_state != GAME_STATE_IDLE)
+    {
+        elapsed_ms = now - m_start_ms;
+    }
+
+    p_frame_out->state = m_state;
+    p_frame_out->score = (uint16_t) ((m_play_time_get(now) / 1000) * GAME_POINTS_PER_S);
+    p_frame_out->lives = m_lives;
+    p_frame_out->elapsed_ds = (uint16_t) (elapsed_ms / 100);
+}
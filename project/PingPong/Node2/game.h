@@ -0,0 +1,28 @@
+#ifndef GAME_H__
+#define GAME_H__
+
+#include <stdint.h>
+#include "game_state.h"
+
+// Lives at the start of a game; every goal costs one
+#define GAME_START_LIVES 3
+// Pause after a goal before play resumes
+#define GAME_GOAL_PAUSE_MS 2000
+// Points per second of play
+#define GAME_POINTS_PER_S 1
+
+void game_init(void);
+// Start a new game. Ends any game in progress.
+void game_start(void);
+// End the game in progress and return to idle
+void game_abort(void);
+// Register a goal detected at the given time. Goals outside of play, or
+// from before play last resumed, are ignored.
+void game_goal(uint32_t timestamp_ms);
+// Advance the game timers
+void game_update(void);
+// Current state as broadcast to the other node. Does not set the sequence
+// number or the servo position.
+void game_frame_get(game_frame_t * p_frame_out);
+
+#endif // GAME_H__
@@ -7,55 +7,268 @@
 
 #include "ir.h"
 #include <sam3x8e.h>
-#include <string.h>
-#include <stdbool.h>
+#include "timer.h"
 
+/*
+ * Goal detection runs entirely in interrupt context:
+ *
+ *   CLEAR --(reading below low threshold)--> BLOCKED: goal event queued
+ *   BLOCKED --(reading above high threshold)--> DEAD_TIME: TC0 ch2 started
+ *   DEAD_TIME --(TC0 ch2 compare)--> CLEAR
+ *
+ * The ADC comparison window only watches for the next transition, so the
+ * gap between the two thresholds gives the hysteresis and the compare
+ * filter rejects single-sample spikes.
+ *
+ * In streaming mode the PDC additionally copies every sample into one of
+ * two buffers. Each full buffer raises ENDRX; the handler summarizes it
+ * and, while the beam is clear, lets the thresholds follow the ambient
+ * level.
+ */
+
+/* Below this the IR is considered blocked. Note: Max 12 bits. */
+#define M_LOW_THRESHOLD (0xFFF/5) // TODO: adjust
+
+/* Above this the IR is considered clear again. Note: Max 12 bits. */
+#define M_HIGH_THRESHOLD (0xFFF/3)
+
+/* Streaming mode thresholds as a fraction (1/256) of the clear beam level */
+#define M_LOW_THRESHOLD_RATIO  (128)
+#define M_HIGH_THRESHOLD_RATIO (192)
 
-/* Threshold at which the IR is considered blocked. Note: Max 12 bits. */
-#define M_SAMPLE_THRESHOLD (0xFFF/5) // TODO: adjust
+/* Thresholds never adapt below these, so a dark sensor still works */
+#define M_LOW_THRESHOLD_MIN  (0xFFF/16)
+#define M_HIGH_THRESHOLD_MIN (0xFFF/8)
 
-/* Number of consecutive samples required to trigger an interrupt */
-#define M_SAMPLE_NUM_THRESHOLD 1 // cannot be zero
+/* Baseline filter: each buffer mean moves it by 1/2^shift of the difference */
+#define M_BASELINE_SHIFT (3)
 
-#define M_EVENT_MIN_PERIOD 500
+/* Samples per PDC buffer; one interrupt per buffer (~16 ms at ~8 kS/s) */
+#define M_STREAM_BUFFER_LEN (128)
+
+/* Consecutive samples beyond a threshold needed for a comparison event,
+   minus one (ADC_EMR CMPFILTER field, max 3) */
+#define M_SAMPLE_FILTER (3)
+
+/* Time after the beam clears during which it is ignored */
+#define M_DEAD_TIME_MS (500)
+
+/* TC0 channel 2 counts at MCK/128 */
+#define M_DEAD_TIME_TICKS ((M_DEAD_TIME_MS * (84000000UL / 128)) / 1000)
 
 /* ADC channel used for the IR */
-#define M_NUM_CHANNELS   (1)
 #define M_IR_ADC_CHANNEL (0)
 
-static uint32_t m_compe_count;
+static volatile ir_state_t m_state;
+static ir_mode_t m_mode;
+
+static uint16_t m_stream_buffers[2][M_STREAM_BUFFER_LEN];
+static uint8_t m_stream_done_index; // buffer the PDC fills up next
 
+static volatile ir_stats_t m_stats;
+static uint32_t m_baseline_fp; // baseline << M_BASELINE_SHIFT
 
-bool hacky_cooldown_timer(void)
+static ir_goal_event_t m_goal_queue[IR_GOAL_QUEUE_SIZE];
+static volatile uint8_t m_goal_head;
+static volatile uint8_t m_goal_tail;
+static volatile uint32_t m_goal_dropped;
+static ir_goal_notify_t m_goal_notify;
+
+static void m_compare_mode_set(uint32_t cmpmode)
 {
-	// Read overflow status of servo timer (clears on read)
-	return TC0->TC_CHANNEL[0].TC_SR & TC_SR_CPCS;
+	ADC->ADC_EMR = cmpmode
+				 | ADC_EMR_CMPSEL(M_IR_ADC_CHANNEL)
+				 | ADC_EMR_CMPFILTER(M_SAMPLE_FILTER);
 }
 
-void ADC_Handler(void)
+static void m_goal_push(uint16_t level)
+{
+	uint8_t next = (m_goal_tail + 1) & (IR_GOAL_QUEUE_SIZE - 1);
+
+	if (next == m_goal_head)
+	{
+		m_goal_dropped++;
+		return;
+	}
+
+	m_goal_queue[m_goal_tail].timestamp_ms = timer_ms_get();
+	m_goal_queue[m_goal_tail].level = level;
+	m_goal_tail = next;
+
+	if (m_goal_notify)
+	{
+		m_goal_notify();
+	}
+}
+
+static void m_thresholds_set(uint16_t low, uint16_t high)
+{
+	m_stats.low_threshold = low;
+	m_stats.high_threshold = high;
+	ADC->ADC_CWR = ADC_CWR_HIGHTHRES(high) | ADC_CWR_LOWTHRES(low);
+}
+
+static void m_thresholds_adapt(uint16_t baseline)
 {
-	// read out the status register
-	volatile uint32_t interrupt_status = ADC->ADC_ISR;
+	uint16_t low = (uint16_t) (((uint32_t) baseline * M_LOW_THRESHOLD_RATIO) >> 8);
+	uint16_t high = (uint16_t) (((uint32_t) baseline * M_HIGH_THRESHOLD_RATIO) >> 8);
 
-	if (interrupt_status & ADC_ISR_COMPE)
+	if (low < M_LOW_THRESHOLD_MIN)
 	{
-		if (hacky_cooldown_timer())
+		low = M_LOW_THRESHOLD_MIN;
+	}
+	if (high < M_HIGH_THRESHOLD_MIN)
+	{
+		high = M_HIGH_THRESHOLD_MIN;
+	}
+
+	m_thresholds_set(low, high);
+}
+
+static void m_stream_buffer_process(const uint16_t * p_samples)
+{
+	uint16_t min = 0xFFF;
+	uint16_t max = 0;
+	uint32_t sum = 0;
+
+	for (uint16_t i = 0; i < M_STREAM_BUFFER_LEN; i++)
+	{
+		uint16_t sample = p_samples[i] & 0xFFF;
+
+		sum += sample;
+		if (sample < min)
 		{
-			m_compe_count++;	
+			min = sample;
 		}
+		if (sample > max)
+		{
+			max = sample;
+		}
+	}
+
+	m_stats.min = min;
+	m_stats.max = max;
+	m_stats.mean = (uint16_t) (sum / M_STREAM_BUFFER_LEN);
+	m_stats.buffer_count++;
+
+	// Only a buffer that saw nothing but the clear beam may move the baseline
+	if (m_state == IR_STATE_CLEAR && min > m_stats.low_threshold)
+	{
+		m_baseline_fp = m_baseline_fp - (m_baseline_fp >> M_BASELINE_SHIFT) + m_stats.mean;
+		m_stats.baseline = (uint16_t) (m_baseline_fp >> M_BASELINE_SHIFT);
+		m_thresholds_adapt(m_stats.baseline);
 	}
 }
 
-void ir_adc_init(void)
+static void m_stream_start(void)
+{
+	m_stream_done_index = 0;
+
+	ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+	ADC->ADC_RPR = (uint32_t) m_stream_buffers[0];
+	ADC->ADC_RCR = M_STREAM_BUFFER_LEN;
+	ADC->ADC_RNPR = (uint32_t) m_stream_buffers[1];
+	ADC->ADC_RNCR = M_STREAM_BUFFER_LEN;
+	ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+
+	ADC->ADC_IER = ADC_IER_ENDRX;
+}
+
+static void m_stream_handle(void)
+{
+	// The PDC has moved on to the other buffer; summarize the full one and
+	// queue it again behind the one being filled
+	uint16_t * p_done = m_stream_buffers[m_stream_done_index];
+
+	m_stream_buffer_process(p_done);
+
+	ADC->ADC_RNPR = (uint32_t) p_done;
+	ADC->ADC_RNCR = M_STREAM_BUFFER_LEN; // also clears ENDRX
+	m_stream_done_index ^= 1;
+}
+
+void ADC_Handler(void)
+{
+	uint32_t interrupt_status = ADC->ADC_ISR;
+
+	if ((interrupt_status & ADC_ISR_ENDRX) && (ADC->ADC_IMR & ADC_IMR_ENDRX))
+	{
+		m_stream_handle();
+	}
+
+	if (!(interrupt_status & ADC_ISR_COMPE) || !(ADC->ADC_IMR & ADC_IMR_COMPE))
+	{
+		return;
+	}
+
+	if (m_state == IR_STATE_CLEAR)
+	{
+		m_goal_push(ADC->ADC_CDR[M_IR_ADC_CHANNEL] & 0xFFF);
+		m_state = IR_STATE_BLOCKED;
+		m_compare_mode_set(ADC_EMR_CMPMODE_HIGH);
+	}
+	else if (m_state == IR_STATE_BLOCKED)
+	{
+		// Ignore the sensor until the dead time has passed
+		ADC->ADC_IDR = ADC_IDR_COMPE;
+		m_state = IR_STATE_DEAD_TIME;
+		TC0->TC_CHANNEL[2].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+	}
+}
+
+void TC2_Handler(void)
+{
+	uint32_t status = TC0->TC_CHANNEL[2].TC_SR;
+
+	if ((status & TC_SR_CPCS) && m_state == IR_STATE_DEAD_TIME)
+	{
+		m_compare_mode_set(ADC_EMR_CMPMODE_LOW);
+		// Drop a comparison event from before the mode change
+		(void) ADC->ADC_ISR;
+		m_state = IR_STATE_CLEAR;
+		ADC->ADC_IER = ADC_IER_COMPE;
+	}
+}
+
+static void m_dead_time_timer_init(void)
+{
+	// TC0 channel 2 is a separate peripheral (TC2) with its own clock and IRQ
+	PMC->PMC_PCR = PMC_PCR_PID(ID_TC2) |
+				   PMC_PCR_CMD |
+				   PMC_PCR_DIV_PERIPH_DIV_MCK |
+				   PMC_PCR_EN;
+	PMC->PMC_PCER0 = 1 << ID_TC2;
+
+	TC0->TC_CHANNEL[2].TC_CCR = TC_CCR_CLKDIS;
+	// One-shot: the counter stops when it reaches RC
+	TC0->TC_CHANNEL[2].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK4
+							  | TC_CMR_WAVE
+							  | TC_CMR_WAVSEL_UP_RC
+							  | TC_CMR_CPCSTOP;
+	TC0->TC_CHANNEL[2].TC_RC = M_DEAD_TIME_TICKS;
+	TC0->TC_CHANNEL[2].TC_IDR = 0xFFFFFFFF;
+	TC0->TC_CHANNEL[2].TC_IER = TC_IER_CPCS;
+
+	NVIC_EnableIRQ(TC2_IRQn);
+}
+
+void ir_adc_init(ir_mode_t mode)
 {
 	// reset internal state
-	m_compe_count = 0;
+	m_mode = mode;
+	m_state = IR_STATE_CLEAR;
+	m_stats = (ir_stats_t) { 0 };
+	m_goal_head = 0;
+	m_goal_tail = 0;
+	m_goal_dropped = 0;
+
+	m_dead_time_timer_init();
 
 	PMC->PMC_PCR = PMC_PCR_PID(ID_ADC) |
 				   PMC_PCR_CMD |
 				   PMC_PCR_DIV_PERIPH_DIV_MCK |
 				   PMC_PCR_EN;
-    PMC->PMC_PCER1 |= (uint32_t) (32 - ID_ADC);
+	PMC->PMC_PCER1 = 1 << (ID_ADC - 32);
 
 	// reset ADC
 	ADC->ADC_CR |= ADC_CR_SWRST;
@@ -75,14 +288,12 @@ void ir_adc_init(void)
 	            | ADC_MR_TRANSFER(1)
 				| ADC_MR_USEQ_NUM_ORDER;
 
-	// Configure Extended Mode Register to only generate interrupts when samples are below the threshold
-	ADC->ADC_EMR = ADC_EMR_CMPMODE_LOW // Generate an interrupt when data is lower than the threshold
-				 | ADC_EMR_CMPSEL(M_IR_ADC_CHANNEL)
-				 | ADC_EMR_CMPFILTER(0);
-				 // | ADC_EMR_CMPFILTER(M_SAMPLE_NUM_THRESHOLD);
-
-	// ADC->ADC_CWR = ADC_CWR_LOWTHRES(M_SAMPLE_THRESHOLD);
-	ADC->ADC_CWR = ADC_CWR_HIGHTHRES(0xFFF) | ADC_CWR_LOWTHRES(M_SAMPLE_THRESHOLD);
+	// Start out waiting for the beam to be blocked. Streaming mode adapts
+	// the thresholds from here on.
+	m_compare_mode_set(ADC_EMR_CMPMODE_LOW);
+	m_thresholds_set(M_LOW_THRESHOLD, M_HIGH_THRESHOLD);
+	m_stats.baseline = M_HIGH_THRESHOLD;
+	m_baseline_fp = (uint32_t) M_HIGH_THRESHOLD << M_BASELINE_SHIFT;
 
 	// Enable channel
 	ADC->ADC_CHDR = 0xFFFFFFFF & ~(1 << M_IR_ADC_CHANNEL); // disable all except the channel we want
@@ -90,6 +301,10 @@ void ir_adc_init(void)
 
 	// Configure interrupts
 	ADC->ADC_IER = ADC_IER_COMPE; // Comparison Event
+	if (m_mode == IR_MODE_STREAMING)
+	{
+		m_stream_start();
+	}
 	NVIC_EnableIRQ(ADC_IRQn);
 	
 	// Start ADC
@@ -98,24 +313,38 @@ void ir_adc_init(void)
 	ADC->ADC_CR |= ADC_CR_START;
 }
 
-uint32_t ir_blocked_count_get(void)
-{
-	return m_compe_count;
-}
-
-void ir_blocked_count_reset(void)
+void ir_goal_notify_set(ir_goal_notify_t notify)
 {
-	m_compe_count = 0;
+	NVIC_DisableIRQ(ADC_IRQn);
+	m_goal_notify = notify;
+	NVIC_EnableIRQ(ADC_IRQn);
 }
 
 ir_state_t ir_state_get(void)
 {	
-	if (m_compe_count)
-	{
-		return M_BLOCKED;
-	}
-	else
+	return m_state;
+}
+
+bool ir_goal_event_get(ir_goal_event_t * p_event_out)
+{
+	if (m_goal_head == m_goal_tail)
 	{
-		return M_NOT_BLOCKED;
+		return false;
 	}
-}
\ No newline at end of file
+
+	*p_event_out = m_goal_queue[m_goal_head];
+	m_goal_head = (m_goal_head + 1) & (IR_GOAL_QUEUE_SIZE - 1);
+	return true;
+}
+
+void ir_stats_get(ir_stats_t * p_stats_out)
+{
+	NVIC_DisableIRQ(ADC_IRQn);
+	*p_stats_out = m_stats;
+	NVIC_EnableIRQ(ADC_IRQn);
+}
+
+uint32_t ir_goal_dropped_get(void)
+{
+	return m_goal_dropped;
+}
@@ -9,16 +9,52 @@
 #define IR_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/* Goal events waiting to be fetched. Must be a power of two. */
+#define IR_GOAL_QUEUE_SIZE (4)
 
 typedef enum
 {
-	M_NOT_BLOCKED = 0,
-	M_BLOCKED,
+	IR_MODE_COMPARE = 0, // fixed thresholds, interrupts on compare events only
+	IR_MODE_STREAMING,   // PDC streams every sample, thresholds track the signal
+} ir_mode_t;
+
+typedef enum
+{
+	IR_STATE_CLEAR = 0, // beam intact, waiting for it to be blocked
+	IR_STATE_BLOCKED,   // goal registered, waiting for the beam to clear
+	IR_STATE_DEAD_TIME, // beam cleared, ignoring the sensor for a while
 } ir_state_t;
 
-void ir_adc_init(void);
-uint32_t ir_blocked_count_get(void);
+typedef struct
+{
+	uint32_t timestamp_ms; // timer_ms_get() when the beam was blocked
+	uint16_t level;        // ADC reading that triggered the goal
+} ir_goal_event_t;
+
+typedef struct
+{
+	uint16_t min;            // lowest sample in the last buffer
+	uint16_t max;            // highest sample in the last buffer
+	uint16_t mean;           // mean of the last buffer
+	uint16_t baseline;       // long-term level of the clear beam
+	uint16_t low_threshold;  // blocked below this
+	uint16_t high_threshold; // clear again above this
+	uint32_t buffer_count;   // buffers processed (streaming mode only)
+} ir_stats_t;
+
+/* Called from interrupt context whenever a goal event is queued */
+typedef void (*ir_goal_notify_t)(void);
+
+void ir_adc_init(ir_mode_t mode);
+void ir_goal_notify_set(ir_goal_notify_t notify);
 ir_state_t ir_state_get(void);
-void ir_blocked_count_reset(void);
+// Fetch the signal statistics and current thresholds
+void ir_stats_get(ir_stats_t * p_stats_out);
+// Fetch the oldest goal event. Returns false if there is none.
+bool ir_goal_event_get(ir_goal_event_t * p_event_out);
+// Goals lost because the queue was full
+uint32_t ir_goal_dropped_get(void);
 
 #endif /* IR_H_ */
@@ -15,16 +15,80 @@
 #include "servo.h"
 #include "ir.h"
 #include "CAN.h"
+#include "can_stats.h"
+#include "cpu_load.h"
+#include "timer.h"
+#include "sched.h"
+#include "power.h"
+#include "motor.h"
+#include "solenoid.h"
+#include "game.h"
 
-/* Approximative delay routines for 84MHz */
-#define _delay_us(time_us) {for (uint32_t i = 0; i < (12*time_us); i++){asm ("nop");asm ("nop");asm ("nop");asm ("nop");asm ("nop");asm ("nop");asm ("nop");}}
-#define _delay_ms(time_ms) _delay_us((time_ms*1000))
+#define M_CPU_LOAD_WINDOW_MS (1000)
+
+/* The servo signal is wired to PB25 (TIOA0). SERVO_BACKEND_PWM needs it on
+   PC22 (Due pin 8) instead. */
+#define M_SERVO_BACKEND SERVO_BACKEND_TC
+
+/* Task periods */
+#define M_CAN_DRAIN_PERIOD_MS (5)
+#define M_GAME_PERIOD_MS      (20) // game state broadcast rate; goals release the task early
+#define M_SERVO_PERIOD_MS     (20) // one servo PWM period
+#define M_TELEMETRY_PERIOD_MS (200) // one report section per run, each drains at 9600 baud before the next
 
 /* TODO: Fine-tune this value for an enhanced user experience */
-#define M_JOYSTICK_IMPACT_ON_SERVO (20)
+#define M_JOYSTICK_IMPACT_ON_SERVO (4) // steps per servo period while the stick is held
+
+/* Joystick input older than this is treated as neutral */
+#define M_JOYSTICK_TIMEOUT_MS (250)
+
+/* Received CAN messages waiting for the drain task. Must be a power of two. */
+#define M_CAN_RX_QUEUE_SIZE (8)
+
+/* Node2 has a single TX mailbox */
+#define M_GAME_STATE_TXBUF_NO (0)
+#define M_CAN_STATS_TXBUF_NO  (0)
+
+typedef struct
+{
+	can_msg_type_t type;
+	can_id_t id;
+	uint8_t len;
+	uint8_t data[8];
+} m_can_rx_entry_t;
+
+/* Telemetry report sections, printed one per telemetry task run */
+typedef enum
+{
+	M_TELEMETRY_SUMMARY = 0,
+	M_TELEMETRY_TASKS,
+	M_TELEMETRY_CAN_ERRORS,
+	M_TELEMETRY_CAN_BUS,
+	M_TELEMETRY_CAN_IDS_LOW,
+	M_TELEMETRY_CAN_IDS_HIGH,
+	M_TELEMETRY_SERVO,
+	M_TELEMETRY_SOLENOID,
+	M_TELEMETRY_POWER,
+	M_TELEMETRY_SECTION_COUNT
+} m_telemetry_section_t;
+
+#define M_TELEMETRY_CAN_IDS_PER_LINE (CAN_STATS_MAX_IDS / 2)
 
-/* Goals are registered when the IR beam is blocked. 1 block = 1 point */
-static uint32_t m_current_game_score;
+static m_can_rx_entry_t m_can_rx_queue[M_CAN_RX_QUEUE_SIZE];
+static volatile uint8_t m_can_rx_head;
+static volatile uint8_t m_can_rx_tail;
+static uint32_t m_can_rx_dropped;
+
+/* Right button press count from the last button frame */
+static uint8_t m_right_press_count;
+static bool m_buttons_synced;
+
+static joystick_direction_t m_joystick_x_dir;
+static uint32_t m_joystick_updated_ms;
+
+static uint8_t m_game_task_id;
+static uint8_t m_game_frame_sequence;
+static uint32_t m_game_frames_dropped;
 
 static void m_format_hex_byte(char * out, uint8_t value)
 {
@@ -83,25 +147,109 @@ static void m_print_can_msg(const can_id_t * id, const can_data_t * data)
 	}
 }
 
+/* Runs in interrupt context, so the solenoid fires without waiting for a task */
+static void m_handle_buttons_msg(const can_data_t *data, uint32_t rx_ticks)
+{
+	uint8_t right_press_count = data->data[1];
+
+	/* The first frame only tells where the count stands */
+	if (m_buttons_synced && right_press_count != m_right_press_count)
+	{
+		(void) solenoid_fire(rx_ticks);
+	}
+
+	m_right_press_count = right_press_count;
+	m_buttons_synced = true;
+}
+
+/* Runs in interrupt context: only queue the message for the drain task */
 static void m_handle_can_rx(uint8_t rx_buf_no, const can_msg_rx_t *msg)
 {
-	//uart_printf("RX: ");
-	m_print_can_msg(&msg->id, msg->type == CAN_MSG_TYPE_DATA ? (&msg->data) : NULL);
-	
-	if (msg->id.value == CAN_JOYSTICK_MSG_ID && msg->data.len == 2)
+	/* Trace point for the solenoid latency */
+	uint32_t rx_ticks = timer_ticks_get();
+
+	if (msg->type == CAN_MSG_TYPE_DATA && msg->id.value == CAN_BUTTON_MSG_ID && msg->data.len == 3)
+	{
+		m_handle_buttons_msg(&msg->data, rx_ticks);
+		return;
+	}
+
+	uint8_t next = (m_can_rx_tail + 1) & (M_CAN_RX_QUEUE_SIZE - 1);
+
+	if (next == m_can_rx_head)
+	{
+		m_can_rx_dropped++;
+		return;
+	}
+
+	m_can_rx_entry_t *p_entry = &m_can_rx_queue[m_can_rx_tail];
+	p_entry->type = msg->type;
+	p_entry->id = msg->id;
+	p_entry->len = msg->type == CAN_MSG_TYPE_DATA ? msg->data.len : 0;
+	for (uint8_t i = 0; i < p_entry->len; i++)
 	{
-		/* Use the joystick direction values to adjust the servo position */
-		joystick_direction_t x_dir = msg->data.data[0];
-		// TODO: should move gradually until stick is in neutral
-		if (x_dir == RIGHT)
+		p_entry->data[i] = msg->data.data[i];
+	}
+
+	m_can_rx_tail = next;
+}
+
+/* Answer a statistics query. Dropped if the mailbox is busy; the query can be repeated. */
+static void m_can_stats_reply(uint8_t index)
+{
+	uint8_t reply_data[CAN_STATS_REPLY_LEN];
+	const can_id_t id = { .value = CAN_STATS_REPLY_MSG_ID, .extended = false };
+	const can_data_t data = { .len = sizeof(reply_data), .data = reply_data };
+
+	if (can_stats_reply_encode(index, reply_data))
+	{
+		(void) can_data_send(M_CAN_STATS_TXBUF_NO, &id, &data);
+	}
+}
+
+static void m_process_can_msg(const m_can_rx_entry_t *p_entry)
+{
+	const can_data_t data = { .len = p_entry->len, .data = p_entry->data };
+
+	m_print_can_msg(&p_entry->id, p_entry->type == CAN_MSG_TYPE_DATA ? &data : NULL);
+
+	if (p_entry->id.value == CAN_JOYSTICK_MSG_ID && p_entry->len == 2)
+	{
+		/* Latch the joystick direction, the servo task acts on it */
+		m_joystick_x_dir = p_entry->data[0];
+		m_joystick_updated_ms = timer_ms_get();
+	}
+	else if (p_entry->id.value == CAN_SLIDER_MSG_ID && p_entry->len == 2)
+	{
+		/* Right slider positions the racket */
+		motor_setpoint_set(p_entry->data[0]);
+	}
+	else if (p_entry->id.value == CAN_MOTOR_GAINS_MSG_ID && p_entry->len == 6)
+	{
+		motor_gains_t gains = {
+			.kp = (int16_t) (p_entry->data[0] | (p_entry->data[1] << 8)),
+			.ki = (int16_t) (p_entry->data[2] | (p_entry->data[3] << 8)),
+			.kd = (int16_t) (p_entry->data[4] | (p_entry->data[5] << 8)),
+		};
+		motor_gains_set(&gains);
+		uart_printf("Motor gains: kp %d ki %d kd %d\n", gains.kp, gains.ki, gains.kd);
+	}
+	else if (p_entry->id.value == CAN_GAME_CMD_MSG_ID && p_entry->len == GAME_CMD_FRAME_LEN)
+	{
+		if (p_entry->data[0] == GAME_CMD_START)
 		{
-			servo_position_adjust(M_JOYSTICK_IMPACT_ON_SERVO);
+			game_start();
 		}
-		else if (x_dir == LEFT)
+		else if (p_entry->data[0] == GAME_CMD_ABORT)
 		{
-			servo_position_adjust(-1* (int16_t)M_JOYSTICK_IMPACT_ON_SERVO);
+			game_abort();
 		}
-	} 
+		sched_task_trigger(m_game_task_id);
+	}
+	else if (p_entry->id.value == CAN_STATS_QUERY_MSG_ID && p_entry->len == CAN_STATS_QUERY_LEN)
+	{
+		m_can_stats_reply(p_entry->data[0]);
+	}
 }
 
 static void m_handle_can_tx(uint8_t tx_buf_no)
@@ -109,31 +257,267 @@ static void m_handle_can_tx(uint8_t tx_buf_no)
 	uart_printf("TX complete.");
 }
 
+static void m_print_can_errors(const can_error_stats_t * stats)
+{
+	static const char * const state_names[] = {
+		[CAN_ERROR_STATE_ACTIVE]  = "active",
+		[CAN_ERROR_STATE_WARNING] = "warning",
+		[CAN_ERROR_STATE_PASSIVE] = "passive",
+		[CAN_ERROR_STATE_BUS_OFF] = "bus-off",
+	};
+
+	uart_printf("  can: %s, TEC %u REC %u, %u RX overflows, %u bus errors, bus-off %u (recovered %u, backoff %u ms)\n",
+				state_names[stats->state], stats->counters.tec, stats->counters.rec,
+				stats->rx_overflow_count, stats->bus_error_count,
+				stats->bus_off_count, stats->recovery_count, stats->backoff_ms);
+}
+
+static void m_handle_can_error(can_error_state_t state, const can_error_stats_t * stats)
+{
+	(void) state;
+	m_print_can_errors(stats);
+}
+
 static void m_can_init(void)
 {
 	can_init_t init = {
 		.rx_handler = m_handle_can_rx,
 		.tx_handler = m_handle_can_tx,
+		.error_handler = m_handle_can_error,
 		.buf = {
 			.rx_buf_count = 2,
 			.tx_buf_count = 1
-		},
-		// Same as the example in mcp2515 5.3, i.e. 125kHz CAN bus
-		.bit = {
-			.baudrate = 2000000,
-			.sync_jump_len = 1,
-			.prop_seg_len = 2,
-			.phase_1_len = 7,
-			.phase_2_len = 6
 		}
 	};
 
 	(void) can_init(&init);
 }
 
-static void m_score_reset(void)
+static void m_task_can_drain(void)
+{
+	uint32_t now = timer_ms_get();
+
+	can_error_poll(now);
+	can_stats_tick(now);
+
+	while (m_can_rx_head != m_can_rx_tail)
+	{
+		m_process_can_msg(&m_can_rx_queue[m_can_rx_head]);
+		m_can_rx_head = (m_can_rx_head + 1) & (M_CAN_RX_QUEUE_SIZE - 1);
+	}
+}
+
+/* Runs in interrupt context */
+static void m_handle_goal(void)
 {
-	m_current_game_score = 0;
+	sched_task_trigger(m_game_task_id);
+}
+
+static void m_task_game(void)
+{
+	ir_goal_event_t goal;
+
+	while (ir_goal_event_get(&goal))
+	{
+		uart_printf("Goal at %u ms (level %u)\n", goal.timestamp_ms, goal.level);
+		game_goal(goal.timestamp_ms);
+	}
+
+	game_update();
+
+	/* Goals release this task early; keep the broadcast at the fixed rate */
+	static uint32_t last_broadcast_ms;
+	uint32_t now = timer_ms_get();
+
+	if (now - last_broadcast_ms >= M_GAME_PERIOD_MS)
+	{
+		game_frame_t frame;
+		uint8_t frame_data[GAME_STATE_FRAME_LEN];
+
+		servo_status_t servo;
+
+		game_frame_get(&frame);
+		servo_status_get(&servo);
+		frame.sequence = m_game_frame_sequence++;
+		frame.servo_position = (uint8_t) servo.position;
+		game_frame_encode(&frame, frame_data);
+
+		const can_id_t id = { .value = CAN_GAME_STATE_MSG_ID, .extended = false };
+		const can_data_t data = { .len = sizeof(frame_data), .data = frame_data };
+
+		if (can_data_send(M_GAME_STATE_TXBUF_NO, &id, &data) != CAN_SUCCESS)
+		{
+			m_game_frames_dropped++;
+		}
+		last_broadcast_ms = now;
+	}
+}
+
+static void m_task_servo(void)
+{
+	/* Move gradually while the stick is held to one side */
+	if (timer_ms_get() - m_joystick_updated_ms > M_JOYSTICK_TIMEOUT_MS)
+	{
+		m_joystick_x_dir = NEUTRAL;
+	}
+
+	if (m_joystick_x_dir == RIGHT)
+	{
+		servo_target_adjust(M_JOYSTICK_IMPACT_ON_SERVO);
+	}
+	else if (m_joystick_x_dir == LEFT)
+	{
+		servo_target_adjust(-1* (int16_t)M_JOYSTICK_IMPACT_ON_SERVO);
+	}
+}
+
+static void m_print_can_ids(uint8_t first)
+{
+	can_stats_entry_t entry;
+
+	if (!can_stats_entry_get(first, &entry))
+	{
+		return;
+	}
+
+	uart_printf("  can ids %u..:", first);
+	for (uint8_t i = first; i < first + M_TELEMETRY_CAN_IDS_PER_LINE && can_stats_entry_get(i, &entry); i++)
+	{
+		uart_printf(" %x rx %u tx %u %uB %u..%ums", entry.id, entry.rx_count, entry.tx_count,
+					entry.byte_count, entry.rx_count + entry.tx_count > 1 ? entry.min_gap_ms : 0,
+					entry.max_gap_ms);
+	}
+	uart_printf("\n");
+}
+
+/* Prints one section of the report per run so that each run fits in the UART
+   transmit buffer and drains before the next one */
+static void m_task_telemetry(void)
+{
+	static m_telemetry_section_t section;
+
+	switch (section)
+	{
+		case M_TELEMETRY_SUMMARY:
+		{
+			cpu_load_stats_t load;
+			cpu_load_get(&load);
+
+			game_frame_t game;
+			game_frame_get(&game);
+
+			uart_printf("< Game state %u, score %u, lives %u, %u.%u s > load %u.%u%% (peak %u.%u%%), worst loop %u us, can drops %u/%u, uart drops %u\n",
+						game.state, game.score, game.lives, game.elapsed_ds / 10, game.elapsed_ds % 10,
+						load.load_permille / 10, load.load_permille % 10,
+						load.peak_load_permille / 10, load.peak_load_permille % 10,
+						load.worst_loop_period_us, m_can_rx_dropped, m_game_frames_dropped,
+						uart_tx_dropped_get());
+			break;
+		}
+
+		case M_TELEMETRY_TASKS:
+			/* Deadline misses and worst execution time per task */
+			uart_printf("  tasks:");
+			for (uint8_t i = 0; i < sched_task_count_get(); i++)
+			{
+				sched_task_stats_t stats;
+				(void) sched_task_stats_get(i, &stats);
+				uart_printf(" %s %u/%uus", sched_task_name_get(i), stats.deadline_miss_count, stats.worst_exec_us);
+			}
+			uart_printf("\n");
+			break;
+
+		case M_TELEMETRY_CAN_ERRORS:
+		{
+			can_error_stats_t can_errors;
+			can_error_stats_get(&can_errors);
+			m_print_can_errors(&can_errors);
+			break;
+		}
+
+		case M_TELEMETRY_CAN_BUS:
+		{
+			can_stats_summary_t can_stats;
+			can_stats_summary_get(&can_stats);
+
+			uart_printf("  can bus: load %u.%u%% (peak %u.%u%%), %u IDs, untracked %u\n",
+						can_stats.load_permille / 10, can_stats.load_permille % 10,
+						can_stats.peak_load_permille / 10, can_stats.peak_load_permille % 10,
+						can_stats.id_count, can_stats.untracked_count);
+			break;
+		}
+
+		case M_TELEMETRY_CAN_IDS_LOW:
+			m_print_can_ids(0);
+			break;
+
+		case M_TELEMETRY_CAN_IDS_HIGH:
+			m_print_can_ids(M_TELEMETRY_CAN_IDS_PER_LINE);
+			break;
+
+		case M_TELEMETRY_SERVO:
+		{
+			servo_status_t servo;
+			servo_status_get(&servo);
+
+			uart_printf("  servo: position %u target %u%s, last settle %u ms\n",
+						servo.position, servo.target, servo.moving ? " (moving)" : "", servo.last_settle_ms);
+
+			motor_status_t motor;
+			motor_status_get(&motor);
+
+			uart_printf("  motor: position %d setpoint %d output %d, saturated %u\n",
+						motor.position, motor.setpoint, motor.output, motor.saturated_count);
+			break;
+		}
+
+		case M_TELEMETRY_SOLENOID:
+		{
+			solenoid_stats_t solenoid;
+			solenoid_stats_get(&solenoid);
+
+			uart_printf("  solenoid: fired %u, rejected %u, worst latency %u us (budget %u us, missed %u)\n",
+						solenoid.fire_count, solenoid.reject_count, solenoid.worst_latency_us,
+						SOLENOID_LATENCY_BUDGET_US, solenoid.budget_miss_count);
+
+			ir_stats_t ir;
+			ir_stats_get(&ir);
+
+			uart_printf("  ir: min %u max %u mean %u, baseline %u, thresholds %u/%u\n",
+						ir.min, ir.max, ir.mean, ir.baseline, ir.low_threshold, ir.high_threshold);
+			break;
+		}
+
+		case M_TELEMETRY_POWER:
+		default:
+		{
+			power_stats_t power;
+			power_stats_get(&power);
+
+			uart_printf("  power: asleep %u.%u%%, wake-up latency %u ns (worst %u ns), energy %u mJ (polling %u mJ)\n",
+						power.sleep_permille / 10, power.sleep_permille % 10,
+						power.avg_wakeup_latency_ns, power.worst_wakeup_latency_ns,
+						power.energy_mj, power.polling_energy_mj);
+			break;
+		}
+	}
+
+	section = (section + 1) % M_TELEMETRY_SECTION_COUNT;
+}
+
+static void m_sched_init(void)
+{
+	sched_init();
+
+	/* Shortest period first: registration order is priority order */
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "can", .fn = m_task_can_drain, .period_ms = M_CAN_DRAIN_PERIOD_MS });
+	m_game_task_id = sched_task_add(&(sched_task_cfg_t){
+		.name = "game", .fn = m_task_game, .period_ms = M_GAME_PERIOD_MS, .offset_ms = 1 });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "servo", .fn = m_task_servo, .period_ms = M_SERVO_PERIOD_MS, .offset_ms = 2 });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "telem", .fn = m_task_telemetry, .period_ms = M_TELEMETRY_PERIOD_MS, .offset_ms = 3 });
 }
 
 static void debug_output_mck_on_pin(void)
@@ -152,29 +536,24 @@ int main(void)
 	
 	debug_output_mck_on_pin();
 
-	m_score_reset();
+	game_init();
 
 	// Disable watchdog timer (for now)
 	WDT->WDT_MR = WDT_MR_WDDIS;
 
 	uart_init();
-	ir_adc_init();
-	servo_init();
+	ir_adc_init(IR_MODE_STREAMING);
+	ir_goal_notify_set(m_handle_goal);
+	servo_init(M_SERVO_BACKEND);
+	motor_init();
+	solenoid_init();
+	timer_init();
 	m_can_init();
+	cpu_load_init(M_CPU_LOAD_WINDOW_MS);
 
-    /* Replace with your application code */
-    while (1)
-    {
-		/* Poll IR to get the user score. */
-		ir_state_t current_state = ir_state_get();
-
-		if (current_state == M_BLOCKED)
-		{
-			m_current_game_score++;
-			ir_blocked_count_reset();
-		}
+	timer_start();
+	power_init();
+	m_sched_init();
 
-		uart_printf("< Current score: %d >\n", m_current_game_score);
-		_delay_ms(500);
-    }
+	sched_run();
 }
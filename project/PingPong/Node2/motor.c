@@ -0,0 +1,236 @@
+#include "motor.h"
+
+#include <sam3x8e.h>
+
+// Motor box control pins on port D
+#define MOTOR_EN_PIN  PIO_PD9
+#define MOTOR_DIR_PIN PIO_PD10
+
+// The motor speed is set by DAC channel 1 (DAC1 pin), 12 bits
+#define MOTOR_DAC_CHANNEL 1
+#define MOTOR_OUTPUT_MAX 0xFFF
+
+// TC1 channel 0 (peripheral TC3) runs the control loop at MCK/2
+#define MOTOR_LOOP_RC ((84000000UL / 2) / MOTOR_LOOP_RATE_HZ)
+
+// Gains are in 1/256
+#define GAIN_SHIFT 8
+// The integral is summed once per loop iteration, so it is scaled down by
+// about the loop rate to keep ki in a usable range
+#define INTEGRAL_SHIFT 10
+
+static volatile int32_t m_setpoint;
+static volatile motor_gains_t m_gains;
+
+static int32_t m_integral;
+// Largest integral whose contribution alone still fits the output range
+static int32_t m_integral_max;
+static int32_t m_last_position;
+
+static volatile int32_t m_position;
+static volatile int16_t m_output;
+static volatile uint32_t m_saturated_count;
+
+static int32_t m_encoder_read(void)
+{
+    // The decoder counts up and down in TC2 channel 0
+    return (int32_t) TC2->TC_CHANNEL[0].TC_CV;
+}
+
+static void m_output_set(int32_t output)
+{
+    if (output < 0)
+    {
+        PIOD->PIO_CODR = MOTOR_DIR_PIN;
+        output = -output;
+    }
+    else
+    {
+        PIOD->PIO_SODR = MOTOR_DIR_PIN;
+    }
+
+    DACC->DACC_CDR = (uint32_t) output;
+}
+
+// One PID iteration
+void TC3_Handler(void)
+{
+    uint32_t status = TC1->TC_CHANNEL[0].TC_SR;
+
+    if (!(status & TC_SR_CPCS))
+    {
+        return;
+    }
+
+    int32_t position = m_encoder_read();
+    int32_t error = m_setpoint - position;
+
+    // Derivative on the measurement, so setpoint steps do not kick the output
+    int32_t derivative = m_last_position - position;
+    m_last_position = position;
+
+    int32_t output = (m_gains.kp * error +
+                      ((m_gains.ki * m_integral) >> INTEGRAL_SHIFT) +
+                      m_gains.kd * derivative) >> GAIN_SHIFT;
+
+    // Anti-windup: only integrate while the output is not clipped, or when
+    // the error pulls it back into range
+    if (output > MOTOR_OUTPUT_MAX)
+    {
+        output = MOTOR_OUTPUT_MAX;
+        m_saturated_count++;
+        if (error < 0)
+        {
+            m_integral += error;
+        }
+    }
+    else if (output < -MOTOR_OUTPUT_MAX)
+    {
+        output = -MOTOR_OUTPUT_MAX;
+        m_saturated_count++;
+        if (error > 0)
+        {
+            m_integral += error;
+        }
+    }
+    else
+    {
+        m_integral += error;
+    }
+
+    if (m_integral > m_integral_max)
+    {
+        m_integral = m_integral_max;
+    }
+    else if (m_integral < -m_integral_max)
+    {
+        m_integral = -m_integral_max;
+    }
+
+    m_output_set(output);
+
+    m_position = position;
+    m_output = (int16_t) output;
+}
+
+static void m_peripheral_enable(uint32_t id)
+{
+    PMC->PMC_PCR = PMC_PCR_PID(id) |
+                   PMC_PCR_CMD |
+                   PMC_PCR_DIV_PERIPH_DIV_MCK |
+                   PMC_PCR_EN;
+    if (id < 32)
+    {
+        PMC->PMC_PCER0 = 1 << id;
+    }
+    else
+    {
+        PMC->PMC_PCER1 = 1 << (id - 32);
+    }
+}
+
+static void m_pins_init(void)
+{
+    m_peripheral_enable(ID_PIOD);
+
+    PIOD->PIO_PER = MOTOR_EN_PIN | MOTOR_DIR_PIN;
+    PIOD->PIO_OER = MOTOR_EN_PIN | MOTOR_DIR_PIN;
+    PIOD->PIO_CODR = MOTOR_EN_PIN | MOTOR_DIR_PIN;
+}
+
+static void m_dac_init(void)
+{
+    m_peripheral_enable(ID_DACC);
+
+    DACC->DACC_CR = DACC_CR_SWRST;
+    DACC->DACC_WPMR = DACC_WPMR_WPKEY(0x444143);
+    // Free-running, conversion on every CDR write
+    DACC->DACC_MR = DACC_MR_TRGEN_DIS |
+                    DACC_MR_USER_SEL_CHANNEL1 |
+                    DACC_MR_STARTUP_8;
+    DACC->DACC_CHER = 1 << MOTOR_DAC_CHANNEL;
+    DACC->DACC_CDR = 0;
+}
+
+static void m_encoder_init(void)
+{
+    m_peripheral_enable(ID_TC6);
+
+    // Encoder phases A and B on TIOA6 (PC25) and TIOB6 (PC26), peripheral B
+    PIOC->PIO_PDR = PIO_PC25B_TIOA6 | PIO_PC26B_TIOB6;
+    PIOC->PIO_ABSR |= PIO_PC25B_TIOA6 | PIO_PC26B_TIOB6;
+
+    // Quadrature decoder in position mode, both edges of both phases
+    TC2->TC_BMR = TC_BMR_QDEN | TC_BMR_POSEN | TC_BMR_EDGPHA | TC_BMR_MAXFILT(1);
+    TC2->TC_CHANNEL[0].TC_CMR = TC_CMR_TCCLKS_XC0;
+    TC2->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+static void m_loop_timer_init(void)
+{
+    m_peripheral_enable(ID_TC3);
+
+    TC1->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKDIS;
+    TC1->TC_CHANNEL[0].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1 |
+                                TC_CMR_WAVE |
+                                TC_CMR_WAVSEL_UP_RC;
+    TC1->TC_CHANNEL[0].TC_RC = MOTOR_LOOP_RC;
+    TC1->TC_CHANNEL[0].TC_IDR = 0xFFFFFFFF;
+    TC1->TC_CHANNEL[0].TC_IER = TC_IER_CPCS;
+    TC1->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
+    NVIC_EnableIRQ(TC3_IRQn);
+}
+
+void motor_init(void)
+{
+    m_setpoint = 0;
+    m_integral = 0;
+    m_last_position = 0;
+    m_position = 0;
+    m_output = 0;
+    m_saturated_count = 0;
+
+    motor_gains_set(&(motor_gains_t) {
+        .kp = MOTOR_DEFAULT_KP, .ki = MOTOR_DEFAULT_KI, .kd = MOTOR_DEFAULT_KD });
+
+    m_pins_init();
+    m_dac_init();
+    m_encoder_init();
+
+    PIOD->PIO_SODR = MOTOR_EN_PIN;
+
+    m_loop_timer_init();
+}
+
+void motor_setpoint_set(uint8_t position)
+{
+    m_setpoint = ((int32_t) position * MOTOR_ENCODER_RANGE) / 0xFF;
+}
+
+void motor_gains_set(const motor_gains_t * p_gains)
+{
+    NVIC_DisableIRQ(TC3_IRQn);
+    m_gains = *p_gains;
+    m_integral_max = p_gains->ki > 0 ?
+        ((int32_t) MOTOR_OUTPUT_MAX << (GAIN_SHIFT + INTEGRAL_SHIFT)) / p_gains->ki : 0;
+    if (m_integral > m_integral_max)
+    {
+        m_integral = m_integral_max;
+    }
+    else if (m_integral < -m_integral_max)
+    {
+        m_integral = -m_integral_max;
+    }
+    NVIC_EnableIRQ(TC3_IRQn);
+}
+
+void motor_status_get(motor_status_t * p_status_out)
+{
+    NVIC_DisableIRQ(TC3_IRQn);
+    p_status_out->position = m_position;
+    p_status_out->setpoint = m_setpoint;
+    p_status_out->output = m_output;
+    p_status_out->saturated_count = m_saturated_count;
+    NVIC_EnableIRQ(TC3_IRQn);
+}
@@ -0,0 +1,42 @@
+#ifndef MOTOR_H__
+#define MOTOR_H__
+
+#include <stdint.h>
+
+// Encoder counts between the two end stops of the racket
+#define MOTOR_ENCODER_RANGE 8800
+
+// Default PID gains, in 1/256. The integral gain acts on the error summed
+// over 1024 loop iterations, about one second. Tuned on the host plant
+// model in tests/test_motor.c.
+#define MOTOR_DEFAULT_KP 1024
+#define MOTOR_DEFAULT_KI 512
+#define MOTOR_DEFAULT_KD 8192
+
+// Control loop rate
+#define MOTOR_LOOP_RATE_HZ 1000
+
+typedef struct
+{
+    int16_t kp;
+    int16_t ki;
+    int16_t kd;
+} motor_gains_t;
+
+typedef struct
+{
+    int32_t position;  // encoder counts from the left end stop
+    int32_t setpoint;  // encoder counts from the left end stop
+    int16_t output;    // last output, signed DAC counts
+    uint32_t saturated_count; // loop iterations with the output clipped
+} motor_status_t;
+
+// Initialize the motor driver and start the control loop. The racket must
+// rest against its left end stop, which becomes encoder position 0.
+void motor_init(void);
+// Set the target position as a fraction (0 = left, 255 = right) of the range
+void motor_setpoint_set(uint8_t position);
+void motor_gains_set(const motor_gains_t * p_gains);
+void motor_status_get(motor_status_t * p_status_out);
+
+#endif // MOTOR_H__
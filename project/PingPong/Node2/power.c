@@ -0,0 +1,93 @@
+#include "power.h"
+
+#include "sam.h"
+#include "timer.h"
+
+static uint32_t m_start_ms;
+static uint64_t m_sleep_ticks;
+static uint32_t m_sleep_count;
+
+static uint32_t m_wakeup_count;
+static uint64_t m_wakeup_latency_total;
+static uint32_t m_wakeup_latency_worst;
+
+static uint32_t m_ticks_to_ns(uint64_t ticks)
+{
+    return (uint32_t) ((ticks * 1000000UL) / TIMER_TICKS_PER_MS);
+}
+
+// Energy in mJ for `ms` milliseconds at `current_ua`
+static uint32_t m_energy_mj(uint64_t ms, uint32_t current_ua)
+{
+    return (uint32_t) ((ms * current_ua * POWER_SUPPLY_MV) / 1000000000ULL);
+}
+
+// Pick up the latency of the wake-up handled since the last sleep
+static void m_wakeup_latency_update(void)
+{
+    uint32_t latency;
+
+    if (timer_wakeup_latency_get(&latency))
+    {
+        m_wakeup_count++;
+        m_wakeup_latency_total += latency;
+        if (latency > m_wakeup_latency_worst)
+        {
+            m_wakeup_latency_worst = latency;
+        }
+    }
+}
+
+void power_init(void)
+{
+    // WFI enters sleep mode: no deep sleep, no wait mode
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    PMC->PMC_FSMR &= ~PMC_FSMR_LPM;
+
+    m_start_ms = timer_ms_get();
+    m_sleep_ticks = 0;
+    m_sleep_count = 0;
+    m_wakeup_count = 0;
+    m_wakeup_latency_total = 0;
+    m_wakeup_latency_worst = 0;
+}
+
+void power_sleep_until(uint32_t wake_ms)
+{
+    m_wakeup_latency_update();
+
+    if (!timer_wakeup_set(wake_ms))
+    {
+        return;
+    }
+
+    uint32_t start = timer_ticks_get();
+
+    // With PRIMASK set a pending interrupt still ends the WFI, the handler
+    // runs once the caller enables interrupts
+    __DSB();
+    __WFI();
+
+    m_sleep_ticks += timer_ticks_get() - start;
+    m_sleep_count++;
+}
+
+void power_stats_get(power_stats_t * p_stats_out)
+{
+    m_wakeup_latency_update();
+
+    uint64_t total_ms = timer_ms_get() - m_start_ms;
+    uint64_t sleep_ms = m_sleep_ticks / TIMER_TICKS_PER_MS;
+    if (sleep_ms > total_ms)
+    {
+        sleep_ms = total_ms;
+    }
+
+    p_stats_out->sleep_count = m_sleep_count;
+    p_stats_out->sleep_permille = total_ms ? (uint16_t) ((sleep_ms * 1000) / total_ms) : 0;
+    p_stats_out->worst_wakeup_latency_ns = m_ticks_to_ns(m_wakeup_latency_worst);
+    p_stats_out->avg_wakeup_latency_ns = m_wakeup_count ? m_ticks_to_ns(m_wakeup_latency_total / m_wakeup_count) : 0;
+    p_stats_out->energy_mj = m_energy_mj(total_ms - sleep_ms, POWER_ACTIVE_CURRENT_UA) +
+                             m_energy_mj(sleep_ms, POWER_SLEEP_CURRENT_UA);
+    p_stats_out->polling_energy_mj = m_energy_mj(total_ms, POWER_ACTIVE_CURRENT_UA);
+}
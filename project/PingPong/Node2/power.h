@@ -0,0 +1,39 @@
+#ifndef POWER_H__
+#define POWER_H__
+
+#include <stdint.h>
+
+// Supply voltage and currents used for the energy estimate. These are
+// datasheet ballpark figures for the SAM3X8E at 84 MHz with the peripherals
+// this node uses clocked, not measurements of the board.
+#define POWER_SUPPLY_MV          3300
+#define POWER_ACTIVE_CURRENT_UA  60000
+#define POWER_SLEEP_CURRENT_UA   25000
+
+typedef struct
+{
+    // Number of times the CPU went to sleep
+    uint32_t sleep_count;
+    // Share of time spent asleep since power_init(), in 1/1000
+    uint16_t sleep_permille;
+    // Time from the wake-up compare to its interrupt handler
+    uint32_t worst_wakeup_latency_ns;
+    uint32_t avg_wakeup_latency_ns;
+    // Estimated energy used since power_init()
+    uint32_t energy_mj;
+    // Estimated energy if the idle time had been spent polling instead
+    uint32_t polling_energy_mj;
+} power_stats_t;
+
+// Select sleep mode (not wait or backup) for WFI, so every peripheral keeps
+// its clock and any interrupt wakes the CPU. Requires the timer.
+void power_init(void);
+// Sleep until the start of the given millisecond or until any interrupt.
+// Must be called with interrupts disabled, so a wake-up condition checked
+// by the caller cannot slip in before the WFI. Pending interrupts are
+// handled once the caller enables interrupts again.
+void power_sleep_until(uint32_t wake_ms);
+// Fetch the current statistics
+void power_stats_get(power_stats_t * p_stats_out);
+
+#endif // POWER_H__
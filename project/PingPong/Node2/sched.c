@@ -0,0 +1,193 @@
+#include "sched.h"
+
+#include <stddef.h>
+#include "sam.h"
+#include "timer.h"
+#include "cpu_load.h"
+#include "power.h"
+
+typedef struct
+{
+    sched_task_cfg_t cfg;
+    uint32_t release_ms;
+    sched_task_stats_t stats;
+} m_task_t;
+
+static m_task_t m_tasks[SCHED_MAX_TASKS];
+static uint8_t m_task_count;
+
+// Set from interrupt context by sched_task_trigger()
+static volatile uint32_t m_triggered_mask;
+
+// First ready task in priority order, or NULL
+static m_task_t * m_ready_task_get(uint32_t now)
+{
+    if (m_triggered_mask)
+    {
+        // Move triggered releases to now
+        __disable_irq();
+        uint32_t triggered = m_triggered_mask;
+        m_triggered_mask = 0;
+        __enable_irq();
+
+        for (uint8_t i = 0; i < m_task_count; i++)
+        {
+            if ((triggered & (1 << i)) && (int32_t) (m_tasks[i].release_ms - now) > 0)
+            {
+                m_tasks[i].release_ms = now;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < m_task_count; i++)
+    {
+        if ((int32_t) (now - m_tasks[i].release_ms) >= 0)
+        {
+            return &m_tasks[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Earliest release among all tasks
+static uint32_t m_next_release_get(void)
+{
+    uint32_t next = m_tasks[0].release_ms;
+
+    for (uint8_t i = 1; i < m_task_count; i++)
+    {
+        if ((int32_t) (m_tasks[i].release_ms - next) < 0)
+        {
+            next = m_tasks[i].release_ms;
+        }
+    }
+
+    return next;
+}
+
+static void m_task_run(m_task_t * p_task, uint32_t now)
+{
+    uint32_t latency = now - p_task->release_ms;
+    uint32_t start_ticks = timer_ticks_get();
+
+    p_task->cfg.fn();
+
+    uint32_t exec_us = (timer_ticks_get() - start_ticks) / TIMER_TICKS_PER_US;
+    uint32_t finish = timer_ms_get();
+
+    p_task->stats.run_count++;
+    if (latency > p_task->stats.worst_latency_ms)
+    {
+        p_task->stats.worst_latency_ms = latency;
+    }
+    if (exec_us > p_task->stats.worst_exec_us)
+    {
+        p_task->stats.worst_exec_us = exec_us;
+    }
+    if (finish - p_task->release_ms > p_task->cfg.deadline_ms)
+    {
+        p_task->stats.deadline_miss_count++;
+    }
+
+    // Next release. Releases that have already passed are skipped, each
+    // one counting as a missed deadline.
+    p_task->release_ms += p_task->cfg.period_ms;
+    while ((int32_t) (finish - p_task->release_ms) >= (int32_t) p_task->cfg.period_ms)
+    {
+        p_task->release_ms += p_task->cfg.period_ms;
+        p_task->stats.deadline_miss_count++;
+    }
+}
+
+void sched_init(void)
+{
+    m_task_count = 0;
+    m_triggered_mask = 0;
+}
+
+uint8_t sched_task_add(const sched_task_cfg_t * cfg)
+{
+    if (!cfg || !cfg->fn || cfg->period_ms == 0 || m_task_count >= SCHED_MAX_TASKS)
+    {
+        return SCHED_TASK_INVALID;
+    }
+
+    m_task_t * p_task = &m_tasks[m_task_count];
+    p_task->cfg = *cfg;
+    if (p_task->cfg.deadline_ms == 0)
+    {
+        p_task->cfg.deadline_ms = cfg->period_ms;
+    }
+    p_task->release_ms = timer_ms_get() + cfg->offset_ms;
+    p_task->stats = (sched_task_stats_t) { 0 };
+
+    return m_task_count++;
+}
+
+void sched_task_trigger(uint8_t task_id)
+{
+    if (task_id < m_task_count)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        m_triggered_mask |= 1 << task_id;
+        __set_PRIMASK(primask);
+    }
+}
+
+uint8_t sched_task_count_get(void)
+{
+    return m_task_count;
+}
+
+const char * sched_task_name_get(uint8_t task_id)
+{
+    if (task_id >= m_task_count)
+    {
+        return NULL;
+    }
+
+    return m_tasks[task_id].cfg.name;
+}
+
+bool sched_task_stats_get(uint8_t task_id, sched_task_stats_t * p_stats_out)
+{
+    if (task_id >= m_task_count || !p_stats_out)
+    {
+        return false;
+    }
+
+    *p_stats_out = m_tasks[task_id].stats;
+    return true;
+}
+
+void sched_run(void)
+{
+    while (1)
+    {
+        uint32_t now = timer_ms_get();
+        m_task_t * p_task = m_ready_task_get(now);
+
+        if (p_task)
+        {
+            m_task_run(p_task, now);
+        }
+        else
+        {
+            // Nothing to do before the next release or trigger. Sleep with
+            // interrupts masked so a trigger cannot arrive between the check
+            // and the WFI.
+            uint32_t next = m_next_release_get();
+
+            cpu_load_idle_enter();
+            __disable_irq();
+            if (!m_triggered_mask)
+            {
+                power_sleep_until(next);
+            }
+            __enable_irq();
+            cpu_load_idle_exit();
+        }
+    }
+}
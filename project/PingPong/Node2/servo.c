@@ -10,54 +10,205 @@
 #define SERVO_NEUTRAL_STEPS ((SERVO_MAX_STEPS + SERVO_MIN_STEPS) / 2)
 // Number of servo positions
 #define SERVO_STEP_COUNT (SERVO_MAX_STEPS - SERVO_MIN_STEPS)
+_Static_assert(SERVO_POSITION_COUNT == SERVO_STEP_COUNT, "SERVO_POSITION_COUNT does not match the duty cycle limits");
 // Neutral servo position ("absolute")
 #define SERVO_NEUTRAL_POS (SERVO_NEUTRAL_STEPS - SERVO_MIN_STEPS)
 
-#define SERVO_TARGET_POS_INVALID INT16_MAX
-
 // Period for the PWM used for the servo
 #define SERVO_PWM_PERIOD 2000
+// PWM periods per second
+#define SERVO_PWM_RATE_HZ 50
+#define SERVO_PWM_PERIOD_MS (1000 / SERVO_PWM_RATE_HZ)
 
 #define MCK_8_FACTOR_FOR_TICK 105
 
 #define TC_RC_VALUE (SERVO_PWM_PERIOD * MCK_8_FACTOR_FOR_TICK)
 #define TC_RA_VALUE(_v) (TC_RC_VALUE - (((uint32_t) (_v)) * MCK_8_FACTOR_FOR_TICK))
 
-static volatile int16_t m_current_servo_position;
-static volatile int16_t m_target_servo_position = SERVO_TARGET_POS_INVALID;
+// PWM controller backend: channel 5 on PC22 (PWML5, peripheral B), clocked
+// by CLKA = MCK/32. One servo step (10 us) is 26.25 PWM counts, so
+// fractional profile positions reach the output.
+#define PWM_SERVO_CHANNEL 5
+#define PWM_CPRD_VALUE 52500 // 20 ms
+#define PWM_COUNTS_PER_STEP_X100 2625
+#define PWM_CDTY_VALUE(_steps_fp) ((uint32_t) (((_steps_fp) * PWM_COUNTS_PER_STEP_X100) / (100 * FP_ONE)))
 
-void TC0_Handler(void)
+// Motion profile state is kept in 1/256 positions
+#define FP_SHIFT 8
+#define FP_ONE (1 << FP_SHIFT)
+
+// Position, velocity (per PWM period) and acceleration (per PWM period
+// squared) of the profile
+static volatile int32_t m_position_fp;
+static volatile int32_t m_velocity_fp;
+static volatile int32_t m_target_fp;
+static int32_t m_max_velocity_fp;
+static int32_t m_acceleration_fp;
+
+static servo_backend_t m_backend;
+// Interrupt that advances the profile, masked to access its state
+static IRQn_Type m_irq;
+
+static volatile bool m_moving;
+static volatile uint32_t m_period_count;
+static volatile uint32_t m_move_start_period;
+static volatile uint32_t m_last_settle_periods;
+
+static int32_t m_abs(int32_t value)
 {
-    uint32_t status = TC0->TC_CHANNEL[0].TC_SR;
-    if (status & TC_SR_CPCS &&
-        m_target_servo_position != SERVO_TARGET_POS_INVALID)
+    return value < 0 ? -value : value;
+}
+
+// Distance covered when braking from `speed` to a stop, one period at a time
+static int32_t m_stop_distance(int32_t speed)
+{
+    int32_t periods = speed / m_acceleration_fp;
+
+    return periods * speed - m_acceleration_fp * periods * (periods + 1) / 2;
+}
+
+// Advance the trapezoidal profile by one PWM period
+static void m_profile_step(void)
+{
+    int32_t error = m_target_fp - m_position_fp;
+    int32_t dir = error >= 0 ? 1 : -1;
+    int32_t distance = m_abs(error);
+    // Speed towards the target, negative when moving away from it
+    int32_t speed = m_velocity_fp * dir;
+
+    if (distance <= m_acceleration_fp && m_abs(m_velocity_fp) <= m_acceleration_fp)
+    {
+        m_position_fp = m_target_fp;
+        m_velocity_fp = 0;
+        m_moving = false;
+        m_last_settle_periods = m_period_count - m_move_start_period;
+        return;
+    }
+
+    if (speed < 0)
     {
-        if (m_current_servo_position < m_target_servo_position)
+        // Brake before turning towards the target
+        speed += m_acceleration_fp;
+    }
+    else
+    {
+        // Accelerate, hold or brake: the fastest that can still stop at the target
+        int32_t faster = speed + m_acceleration_fp;
+        if (faster > m_max_velocity_fp)
         {
-            m_current_servo_position++;
-            TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE(m_current_servo_position);
+            faster = m_max_velocity_fp;
         }
-        else if (m_current_servo_position > m_target_servo_position)
+
+        if (faster + m_stop_distance(faster) <= distance)
         {
-            m_current_servo_position--;
-            TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE(m_current_servo_position);
+            speed = faster;
         }
-        else
+        else if (speed + m_stop_distance(speed) > distance)
         {
-            m_target_servo_position = SERVO_TARGET_POS_INVALID;
-            TC0->TC_CHANNEL[0].TC_IDR = TC_IDR_CPCS;
+            speed = speed > m_acceleration_fp ? speed - m_acceleration_fp : 0;
         }
     }
+
+    // Never step past the target
+    if (speed > distance)
+    {
+        speed = distance;
+    }
+
+    m_velocity_fp = speed * dir;
+    m_position_fp += m_velocity_fp;
+}
+
+static void m_output_write(void)
+{
+    int32_t steps_fp = m_position_fp + (SERVO_MIN_STEPS << FP_SHIFT);
+
+    if (m_backend == SERVO_BACKEND_PWM)
+    {
+        // Latched by the controller at the start of the next period
+        PWM->PWM_CH_NUM[PWM_SERVO_CHANNEL].PWM_CDTYUPD = PWM_CDTY_VALUE(steps_fp);
+    }
+    else
+    {
+        uint16_t steps = (uint16_t) ((steps_fp + FP_ONE / 2) >> FP_SHIFT);
+        TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE(steps);
+    }
+}
+
+static void m_period_elapsed(void)
+{
+    m_period_count++;
+
+    if (m_moving)
+    {
+        m_profile_step();
+        m_output_write();
+    }
+}
+
+void TC0_Handler(void)
+{
+    uint32_t status = TC0->TC_CHANNEL[0].TC_SR;
+
+    // RC compare starts a new PWM period, RA is not reached for at least
+    // 0.9 ms so updating it here takes effect in this period
+    if (status & TC_SR_CPCS)
+    {
+        m_period_elapsed();
+    }
 }
 
-void servo_init(void)
+void PWM_Handler(void)
+{
+    uint32_t status = PWM->PWM_ISR1;
+
+    // Channel counter event: a new period has started
+    if (status & (PWM_ISR1_CHID0 << PWM_SERVO_CHANNEL))
+    {
+        m_period_elapsed();
+    }
+}
+
+static void m_pwm_init(void)
+{
+    PMC->PMC_PCR = PMC_PCR_PID(ID_PWM) |
+                   PMC_PCR_CMD |
+                   PMC_PCR_DIV_PERIPH_DIV_MCK |
+                   PMC_PCR_EN;
+    PMC->PMC_PCER1 = 1 << (ID_PWM - 32);
+
+    PWM->PWM_DIS = 1 << PWM_SERVO_CHANNEL;
+
+    // Configure output pin for PWML5
+    PIOC->PIO_IDR = PIO_PC22B_PWML5;
+    PIOC->PIO_ABSR |= PIO_PC22B_PWML5;
+    PIOC->PIO_PDR = PIO_PC22B_PWML5;
+
+    PWM->PWM_CLK = PWM_CLK_PREA(5) | PWM_CLK_DIVA(1); // CLKA = MCK/32
+
+    // PWML is the complement of PWMH: with CPOL clear PWMH is low for the
+    // first CDTY counts of each period, so that is the servo pulse on PWML
+    PWM->PWM_CH_NUM[PWM_SERVO_CHANNEL].PWM_CMR = PWM_CMR_CPRE_CLKA;
+    PWM->PWM_CH_NUM[PWM_SERVO_CHANNEL].PWM_CPRD = PWM_CPRD_VALUE;
+    PWM->PWM_CH_NUM[PWM_SERVO_CHANNEL].PWM_CDTY = PWM_CDTY_VALUE(SERVO_NEUTRAL_STEPS << FP_SHIFT);
+
+    // The profile is advanced once per PWM period
+    PWM->PWM_IDR1 = 0xFFFFFFFF;
+    PWM->PWM_IER1 = PWM_IER1_CHID0 << PWM_SERVO_CHANNEL;
+
+    PWM->PWM_ENA = 1 << PWM_SERVO_CHANNEL;
+
+    NVIC_EnableIRQ(PWM_IRQn);
+}
+
+static void m_tc_init(void)
 {
     // Enable clock
     PMC->PMC_PCR = PMC_PCR_PID(ID_TC0) |
                    PMC_PCR_CMD |
                    PMC_PCR_DIV_PERIPH_DIV_MCK |
                    PMC_PCR_EN;
-    PMC->PMC_PCER0 |= ID_TC0;
+    PMC->PMC_PCER0 = 1 << ID_TC0;
 
 	TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKDIS;
 
@@ -73,54 +224,107 @@ void servo_init(void)
                    TC_CMR_ACPC_CLEAR;
 
     // Reset counter on this value
-    TC0->TC_CHANNEL[0].TC_RC = SERVO_PWM_PERIOD * MCK_8_FACTOR_FOR_TICK;
+    TC0->TC_CHANNEL[0].TC_RC = TC_RC_VALUE;
     // Set neutral position
     TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE(SERVO_NEUTRAL_STEPS);
 
+    // The profile is advanced once per PWM period
+    TC0->TC_CHANNEL[0].TC_IER = TC_IER_CPCS;
+
     TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
 
     NVIC_EnableIRQ(TC0_IRQn);
+}
+
+void servo_init(servo_backend_t backend)
+{
+    m_backend = backend;
+    m_irq = backend == SERVO_BACKEND_PWM ? PWM_IRQn : TC0_IRQn;
+
+    m_position_fp = SERVO_NEUTRAL_POS << FP_SHIFT;
+    m_velocity_fp = 0;
+    m_target_fp = m_position_fp;
+    m_moving = false;
+    m_period_count = 0;
+    m_last_settle_periods = 0;
+    servo_limits_set(SERVO_DEFAULT_MAX_VELOCITY, SERVO_DEFAULT_ACCELERATION);
 
-    m_current_servo_position = SERVO_NEUTRAL_POS;
+    if (backend == SERVO_BACKEND_PWM)
+    {
+        m_pwm_init();
+    }
+    else
+    {
+        m_tc_init();
+    }
 }
 
-void servo_position_adjust(int16_t delta)
+void servo_limits_set(uint16_t max_velocity, uint16_t acceleration)
 {
-    if ((m_current_servo_position + SERVO_MIN_STEPS + delta >= SERVO_MIN_STEPS)
-        && ( m_current_servo_position + SERVO_MIN_STEPS + delta <= SERVO_MAX_STEPS))
+    if (max_velocity == 0 || acceleration == 0)
     {
-        m_current_servo_position += delta;
-        TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE((uint16_t)m_current_servo_position + SERVO_MIN_STEPS);
+        return;
     }
+
+    int32_t acceleration_fp = ((int32_t) acceleration << FP_SHIFT) / (SERVO_PWM_RATE_HZ * SERVO_PWM_RATE_HZ);
+
+    NVIC_DisableIRQ(m_irq);
+    m_max_velocity_fp = ((int32_t) max_velocity << FP_SHIFT) / SERVO_PWM_RATE_HZ;
+    m_acceleration_fp = acceleration_fp > 0 ? acceleration_fp : 1;
+    NVIC_EnableIRQ(m_irq);
 }
 
-void servo_position_goto(uint16_t position)
+void servo_target_set(uint16_t position)
 {
     if (position >= SERVO_STEP_COUNT)
     {
-        return;
+        position = SERVO_STEP_COUNT - 1;
     }
 
-    NVIC_DisableIRQ(TC0_IRQn);
-    m_target_servo_position = position;
-    TC0->TC_CHANNEL[0].TC_IER = TC_IER_CPCS;
-    NVIC_EnableIRQ(TC0_IRQn);
+    NVIC_DisableIRQ(m_irq);
+    if (!m_moving)
+    {
+        m_move_start_period = m_period_count;
+    }
+    m_target_fp = (int32_t) position << FP_SHIFT;
+    m_moving = m_target_fp != m_position_fp || m_velocity_fp != 0;
+    NVIC_EnableIRQ(m_irq);
 }
 
-void servo_position_stop(void)
+void servo_target_adjust(int16_t delta)
 {
-    NVIC_DisableIRQ(TC0_IRQn);
-    m_target_servo_position = SERVO_TARGET_POS_INVALID;
-    TC0->TC_CHANNEL[0].TC_IDR = TC_IDR_CPCS;
-    NVIC_EnableIRQ(TC0_IRQn);
+    int32_t target = (m_target_fp >> FP_SHIFT) + delta;
+
+    if (target < 0)
+    {
+        target = 0;
+    }
+
+    servo_target_set((uint16_t) target);
 }
 
-void servo_position_set(uint16_t position)
+void servo_stop(void)
 {
-    if (position >= SERVO_STEP_COUNT)
+    NVIC_DisableIRQ(m_irq);
+    // Closest whole position the servo can still stop at
+    int32_t stop_distance = m_stop_distance(m_abs(m_velocity_fp));
+    if (m_velocity_fp < 0)
     {
-        return;
+        m_target_fp = (m_position_fp - stop_distance) & ~(FP_ONE - 1);
+    }
+    else
+    {
+        m_target_fp = (m_position_fp + stop_distance + FP_ONE - 1) & ~(FP_ONE - 1);
     }
+    NVIC_EnableIRQ(m_irq);
+}
 
-    TC0->TC_CHANNEL[0].TC_RA = TC_RA_VALUE(position + SERVO_MIN_STEPS);
-}
\ No newline at end of file
+void servo_status_get(servo_status_t * p_status_out)
+{
+    NVIC_DisableIRQ(m_irq);
+    p_status_out->position = (uint16_t) ((m_position_fp + FP_ONE / 2) >> FP_SHIFT);
+    p_status_out->target = (uint16_t) (m_target_fp >> FP_SHIFT);
+    p_status_out->moving = m_moving;
+    p_status_out->last_settle_ms = m_last_settle_periods * SERVO_PWM_PERIOD_MS;
+    NVIC_EnableIRQ(m_irq);
+}
@@ -2,14 +2,46 @@
 #define SERVO_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 
-// Initialize the servo
-void servo_init(void);
-// Adjust the servo by a certain delta
-void servo_position_adjust(int16_t delta);
-// Set the servo position in the allowed range [0, 120)
-void servo_position_set(uint16_t position);
-void servo_position_goto(uint16_t position);
-void servo_position_stop(void);
+// Number of servo positions, the allowed range is [0, SERVO_POSITION_COUNT)
+#define SERVO_POSITION_COUNT 120
+
+// Default motion limits, in positions per second (squared)
+#define SERVO_DEFAULT_MAX_VELOCITY     240
+#define SERVO_DEFAULT_ACCELERATION     1200
+
+typedef enum
+{
+    // TC0 channel 0 waveform on PB25 (TIOA0), 10 us resolution
+    SERVO_BACKEND_TC = 0,
+    // PWM controller channel 5 on PC22 (PWML5), ~0.4 us resolution with
+    // double-buffered duty updates. Leaves TC0 channel 0 free.
+    SERVO_BACKEND_PWM,
+} servo_backend_t;
+
+typedef struct
+{
+    // Position currently output to the servo
+    uint16_t position;
+    // Position the servo is moving to
+    uint16_t target;
+    bool moving;
+    // Time from setting a target until the servo reached it, for the last
+    // completed move
+    uint32_t last_settle_ms;
+} servo_status_t;
+
+// Initialize the servo in the neutral position, driven by the given backend
+void servo_init(servo_backend_t backend);
+// Limit the velocity and acceleration of every move. Both must be non-zero.
+void servo_limits_set(uint16_t max_velocity, uint16_t acceleration);
+// Move to the given position, clamped to the allowed range
+void servo_target_set(uint16_t position);
+// Move the target by a certain delta, clamped to the allowed range
+void servo_target_adjust(int16_t delta);
+// Decelerate and stop as soon as possible
+void servo_stop(void);
+void servo_status_get(servo_status_t * p_status_out);
 
 #endif // SERVO_H__
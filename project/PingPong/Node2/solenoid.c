@@ -0,0 +1,127 @@
+#include "solenoid.h"
+
+#include <sam3x8e.h>
+#include "timer.h"
+
+// Solenoid driver input on PC12 (Due pin 51), active high
+#define SOLENOID_PIN PIO_PC12
+
+// TC1 channel 1 (peripheral TC4) times the pulse at MCK/128
+#define SOLENOID_TICKS_PER_MS ((84000000UL / 128) / 1000)
+
+static volatile bool m_active;
+static bool m_fired_once;
+static uint32_t m_last_fire_ticks;
+static uint32_t m_min_interval_ticks;
+
+static volatile solenoid_stats_t m_stats;
+
+// End of the pulse
+void TC4_Handler(void)
+{
+    uint32_t status = TC1->TC_CHANNEL[1].TC_SR;
+
+    if (status & TC_SR_CPCS)
+    {
+        PIOC->PIO_CODR = SOLENOID_PIN;
+        m_active = false;
+    }
+}
+
+void solenoid_init(void)
+{
+    PMC->PMC_PCR = PMC_PCR_PID(ID_TC4) |
+                   PMC_PCR_CMD |
+                   PMC_PCR_DIV_PERIPH_DIV_MCK |
+                   PMC_PCR_EN;
+    PMC->PMC_PCER0 = 1 << ID_TC4;
+
+    PIOC->PIO_PER = SOLENOID_PIN;
+    PIOC->PIO_OER = SOLENOID_PIN;
+    PIOC->PIO_CODR = SOLENOID_PIN;
+
+    // One-shot: the counter stops when it reaches RC
+    TC1->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKDIS;
+    TC1->TC_CHANNEL[1].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK4 |
+                                TC_CMR_WAVE |
+                                TC_CMR_WAVSEL_UP_RC |
+                                TC_CMR_CPCSTOP;
+    TC1->TC_CHANNEL[1].TC_IDR = 0xFFFFFFFF;
+    TC1->TC_CHANNEL[1].TC_IER = TC_IER_CPCS;
+
+    m_active = false;
+    m_fired_once = false;
+    m_stats = (solenoid_stats_t) { 0 };
+    solenoid_config_set(SOLENOID_DEFAULT_PULSE_MS, SOLENOID_DEFAULT_MIN_INTERVAL_MS);
+
+    NVIC_EnableIRQ(TC4_IRQn);
+}
+
+void solenoid_config_set(uint16_t pulse_ms, uint16_t min_interval_ms)
+{
+    if (pulse_ms == 0)
+    {
+        return;
+    }
+    if (min_interval_ms < pulse_ms)
+    {
+        min_interval_ms = pulse_ms;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    TC1->TC_CHANNEL[1].TC_RC = pulse_ms * SOLENOID_TICKS_PER_MS;
+    m_min_interval_ticks = (uint32_t) min_interval_ms * TIMER_TICKS_PER_MS;
+    __set_PRIMASK(primask);
+}
+
+bool solenoid_fire(uint32_t event_ticks)
+{
+    bool fired = false;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = timer_ticks_get();
+
+    if (!m_active && (!m_fired_once || now - m_last_fire_ticks >= m_min_interval_ticks))
+    {
+        PIOC->PIO_SODR = SOLENOID_PIN;
+        TC1->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+        m_active = true;
+        m_fired_once = true;
+        m_last_fire_ticks = now;
+
+        // Trace point: triggering event to coil on. TIMER_TICKS_PER_US is
+        // rounded, so convert through milliseconds.
+        uint32_t latency_ticks = now - event_ticks;
+        uint32_t latency_us = (latency_ticks / TIMER_TICKS_PER_MS) * 1000 +
+                              ((latency_ticks % TIMER_TICKS_PER_MS) * 1000) / TIMER_TICKS_PER_MS;
+        m_stats.fire_count++;
+        if (latency_us > m_stats.worst_latency_us)
+        {
+            m_stats.worst_latency_us = latency_us;
+        }
+        if (latency_us > SOLENOID_LATENCY_BUDGET_US)
+        {
+            m_stats.budget_miss_count++;
+        }
+        fired = true;
+    }
+    else
+    {
+        m_stats.reject_count++;
+    }
+
+    __set_PRIMASK(primask);
+
+    return fired;
+}
+
+void solenoid_stats_get(solenoid_stats_t * p_stats_out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *p_stats_out = m_stats;
+    __set_PRIMASK(primask);
+}
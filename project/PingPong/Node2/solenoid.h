@@ -0,0 +1,37 @@
+#ifndef SOLENOID_H__
+#define SOLENOID_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Node2 part of the button edge to coil latency budget, from CAN reception
+ * to the coil being energized. See CAN_BUTTON_LATENCY_BUDGET_US in CAN.h for
+ * the whole path.
+ */
+#define SOLENOID_LATENCY_BUDGET_US 100
+
+#define SOLENOID_DEFAULT_PULSE_MS        30
+#define SOLENOID_DEFAULT_MIN_INTERVAL_MS 250
+
+typedef struct
+{
+    uint32_t fire_count;
+    // Requests refused because the coil was still within its re-trigger interval
+    uint32_t reject_count;
+    // Longest time from the triggering event to the coil being energized
+    uint32_t worst_latency_us;
+    uint32_t budget_miss_count;
+} solenoid_stats_t;
+
+void solenoid_init(void);
+// Set the pulse width and the minimum time between the start of two pulses.
+// The interval is raised to the pulse width if shorter.
+void solenoid_config_set(uint16_t pulse_ms, uint16_t min_interval_ms);
+// Fire one pulse. `event_ticks` is the timer_ticks_get() value of the event
+// that caused it, for latency tracing. Safe to call from interrupt context.
+// Returns false if the request was rate limited.
+bool solenoid_fire(uint32_t event_ticks);
+void solenoid_stats_get(solenoid_stats_t * p_stats_out);
+
+#endif // SOLENOID_H__
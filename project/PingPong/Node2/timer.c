@@ -2,17 +2,78 @@
 
 #include <sam3x8e.h>
 
-#define MCK_8_FACTOR_MS 10500
+// Counter overflows (every 2^32 ticks, ~409 s) extend the time base
+static volatile uint32_t m_overflow_count;
+
+static volatile bool m_wakeup_fired;
+static volatile uint32_t m_wakeup_latency_ticks;
+
+void TC1_Handler(void)
+{
+    uint32_t status = TC0->TC_CHANNEL[1].TC_SR;
+
+    if (status & TC_SR_COVFS)
+    {
+        m_overflow_count++;
+    }
+
+    if ((status & TC_SR_CPCS) && (TC0->TC_CHANNEL[1].TC_IMR & TC_IMR_CPCS))
+    {
+        uint32_t latency = TC0->TC_CHANNEL[1].TC_CV - TC0->TC_CHANNEL[1].TC_RC;
+
+        // A flag left over from a match while masked shows up as a compare
+        // point that is still ahead; ignore it and keep waiting
+        if ((int32_t) latency >= 0)
+        {
+            // One-shot: the scheduler programs the next wake-up itself
+            m_wakeup_latency_ticks = latency;
+            m_wakeup_fired = true;
+            TC0->TC_CHANNEL[1].TC_IDR = TC_IDR_CPCS;
+        }
+    }
+}
+
+// 64-bit tick count, safe against an overflow between the two reads.
+// Relies on the overflow interrupt being able to run, so an overflow that
+// is pending while interrupts are masked is only seen once it is handled.
+static uint64_t m_ticks64_get(void)
+{
+    uint32_t high;
+    uint32_t low;
+
+    do
+    {
+        high = m_overflow_count;
+        low = TC0->TC_CHANNEL[1].TC_CV;
+    } while (high != m_overflow_count);
+
+    return ((uint64_t) high << 32) | low;
+}
 
 void timer_init(void)
 {
-    // Assumes that servo initialized TC0
-	TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKDIS;
+    // TC0 channel 1 is a separate peripheral (TC1) with its own clock and IRQ
+    PMC->PMC_PCR = PMC_PCR_PID(ID_TC1) |
+                   PMC_PCR_CMD |
+                   PMC_PCR_DIV_PERIPH_DIV_MCK |
+                   PMC_PCR_EN;
+    PMC->PMC_PCER0 = 1 << ID_TC1;
+
+    TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKDIS;
+    // Capture mode, free-running; RC compare only raises the wake-up interrupt
     TC0->TC_CHANNEL[1].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK2;
+    TC0->TC_CHANNEL[1].TC_IDR = 0xFFFFFFFF;
+    TC0->TC_CHANNEL[1].TC_IER = TC_IER_COVFS;
+
+    m_overflow_count = 0;
+    m_wakeup_fired = false;
+
+    NVIC_EnableIRQ(TC1_IRQn);
 }
 
 void timer_start(void)
 {
+    m_overflow_count = 0;
     TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
 }
 
@@ -23,5 +84,40 @@ void timer_stop(void)
 
 uint32_t timer_ms_get(void)
 {
-    return TC0->TC_CHANNEL[1].TC_CV / (uint32_t) MCK_8_FACTOR_MS;
+    return (uint32_t) (m_ticks64_get() / TIMER_TICKS_PER_MS);
+}
+
+uint32_t timer_ticks_get(void)
+{
+    return TC0->TC_CHANNEL[1].TC_CV;
+}
+
+bool timer_wakeup_set(uint32_t ms)
+{
+    uint32_t compare = (uint32_t) ((uint64_t) ms * TIMER_TICKS_PER_MS);
+
+    TC0->TC_CHANNEL[1].TC_IDR = TC_IDR_CPCS;
+    TC0->TC_CHANNEL[1].TC_RC = compare;
+    TC0->TC_CHANNEL[1].TC_IER = TC_IER_CPCS;
+
+    // The compare only fires on an exact match, so check it is still ahead
+    if ((int32_t) (compare - TC0->TC_CHANNEL[1].TC_CV) <= 0)
+    {
+        TC0->TC_CHANNEL[1].TC_IDR = TC_IDR_CPCS;
+        return false;
+    }
+
+    return true;
+}
+
+bool timer_wakeup_latency_get(uint32_t * p_ticks_out)
+{
+    if (!m_wakeup_fired)
+    {
+        return false;
+    }
+
+    *p_ticks_out = m_wakeup_latency_ticks;
+    m_wakeup_fired = false;
+    return true;
 }
@@ -2,10 +2,24 @@
 #define RTC_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+// TC0 channel 1 counts at MCK/8
+#define TIMER_TICKS_PER_MS 10500
+#define TIMER_TICKS_PER_US 10
 
 void timer_init(void);
 void timer_start(void);
 void timer_stop(void);
+// Milliseconds since timer_start()
 uint32_t timer_ms_get(void);
+// Raw free-running counter value, for sub-millisecond timestamps
+uint32_t timer_ticks_get(void);
+// Raise the timer interrupt at the start of the given millisecond.
+// Returns false if that time has already passed.
+bool timer_wakeup_set(uint32_t ms);
+// Ticks between the last wake-up compare and its interrupt handler.
+// Returns false if no wake-up has fired since the last call.
+bool timer_wakeup_latency_get(uint32_t * p_ticks_out);
 
-#endif // RTC_H__
\ No newline at end of file
+#endif // RTC_H__
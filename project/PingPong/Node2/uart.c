@@ -15,6 +15,12 @@
 //Ringbuffer for receiving multiple characters
 uart_ringbuffer rx_buffer;
 
+//Ringbuffer for transmitting without waiting on the line
+static uart_tx_ringbuffer tx_buffer;
+
+//Characters dropped because the transmit ring buffer was full
+static volatile uint32_t tx_dropped_count;
+
 
 /**
  * \brief Configure UART.
@@ -32,6 +38,9 @@ void uart_init(void)
 	*/
 	rx_buffer.head=0;
 	rx_buffer.tail=0;
+	tx_buffer.head=0;
+	tx_buffer.tail=0;
+	tx_dropped_count=0;
 
 	/*
 	Initialize UART communication
@@ -99,7 +108,11 @@ int uart_getchar(uint8_t *c)
 }
 
 /*
- * \brief Sends a character through the UART interface
+ * \brief Queues a character for transmission through the UART interface
+ *
+ * Never waits for the line: at 9600 baud a full buffer takes over a quarter
+ * of a second to drain, which would stall every scheduled task. If the
+ * transmit buffer is full the character is dropped and counted instead.
  *
  * \param c Character to be sent
  *
@@ -107,16 +120,37 @@ int uart_getchar(uint8_t *c)
  */
 int uart_putchar(const uint8_t c)
 {
-	// Check if the transmitter is ready
-	if((UART->UART_SR & UART_SR_TXRDY) != UART_SR_TXRDY)
-	return 1;
+	// Both thread and interrupt context may print, keep the enqueue atomic
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint16_t next = (tx_buffer.tail + 1) % UART_TX_RINGBUFFER_SIZE;
+	if(next == tx_buffer.head)
+	{
+		tx_dropped_count++;
+		__set_PRIMASK(primask);
+		return 1;
+	}
+	tx_buffer.data[tx_buffer.tail] = c;
+	tx_buffer.tail = next;
+	__set_PRIMASK(primask);
 
-	// Send the character
-	UART->UART_THR = c;
-	while(!((UART->UART_SR) & UART_SR_TXEMPTY)); // Wait for the character to be sent, can implement ring buffer to remove the wait
+	// Let the interrupt handler feed the transmitter
+	UART->UART_IER = UART_IER_TXRDY;
 	return 0;
 }
 
+/**
+ * \brief Get the number of characters dropped on a full transmit buffer
+ *
+ * \param void
+ *
+ * \retval Characters dropped since uart_init()
+ */
+uint32_t uart_tx_dropped_get(void)
+{
+	return tx_dropped_count;
+}
+
 void UART_Handler(void)
 {
 	uint32_t status = UART->UART_SR;
@@ -135,12 +169,27 @@ void UART_Handler(void)
 		{
 			// printf("ERR: UART RX buffer is full\n\r");
 			rx_buffer.data[rx_buffer.tail] = UART->UART_RHR; //Throw away message
-			return;
 		}
-		rx_buffer.data[rx_buffer.tail] = UART->UART_RHR;
-		rx_buffer.tail = (rx_buffer.tail + 1) % UART_RINGBUFFER_SIZE;
-		
+		else
+		{
+			rx_buffer.data[rx_buffer.tail] = UART->UART_RHR;
+			rx_buffer.tail = (rx_buffer.tail + 1) % UART_RINGBUFFER_SIZE;
+		}
 	}
-	
+
+	//Feed the transmitter from the transmit ring buffer
+	if((status & UART_SR_TXRDY) && (UART->UART_IMR & UART_IMR_TXRDY))
+	{
+		if(tx_buffer.head != tx_buffer.tail)
+		{
+			UART->UART_THR = tx_buffer.data[tx_buffer.head];
+			tx_buffer.head = (tx_buffer.head + 1) % UART_TX_RINGBUFFER_SIZE;
+		}
+		else
+		{
+			UART->UART_IDR = UART_IDR_TXRDY;
+		}
+	}
+
 	
 }
\ No newline at end of file
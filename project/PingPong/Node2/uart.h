@@ -15,6 +15,7 @@
 
 #include <stdint.h>
 #define UART_RINGBUFFER_SIZE 64
+#define UART_TX_RINGBUFFER_SIZE 256
 /*
  * Ringbuffer for receiving characters from  
  */
@@ -24,11 +25,21 @@ typedef struct uart_ringbuffer_t
 	char data[UART_RINGBUFFER_SIZE];
 } uart_ringbuffer;
 
+/*
+ * Ringbuffer for characters waiting to be transmitted
+ */
+typedef struct uart_tx_ringbuffer_t
+{
+	volatile uint16_t head, tail;
+	char data[UART_TX_RINGBUFFER_SIZE];
+} uart_tx_ringbuffer;
+
 
 void uart_init(void);
 
 int uart_getchar(uint8_t *c);
 int uart_putchar(const uint8_t c);
+uint32_t uart_tx_dropped_get(void);
 
 void UART_Handler(void);
 
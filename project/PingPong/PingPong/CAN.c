@@ -7,6 +7,7 @@
 #include <avr/interrupt.h>
 #include <avr/sfr_defs.h>
 #include "CAN.h"
+#include "can_stats.h"
 #include "mcp2515.h"
 #include "ping_pong.h"
 
@@ -20,17 +21,34 @@
 
 #define F_MCP_CPU (16000000) // 16MHz
 
-// Information processing time in TQ, starting at ps2
-#define IPT_TQ (2)
+// Bit timing, solved at compile time; TQ = 2 * (BRP + 1) / F_MCP_CPU
+#define M_SP CAN_SAMPLE_POINT_PERMILLE
+enum { M_TQ_PER_BIT = CAN_BT_TQ(F_MCP_CPU / 2, 0, 0x3F, CAN_BITRATE, M_SP) };
+_Static_assert(M_TQ_PER_BIT != 0, "no MCP2515 bit timing for CAN_BITRATE and CAN_SAMPLE_POINT_PERMILLE");
+_Static_assert(CAN_BT_SAMPLE_POINT_OK(M_TQ_PER_BIT, M_SP), "MCP2515 sample point out of tolerance");
 
-// Calculate BRP based on baudrate and CPU frequency
-#define BRP_CALCULATE(baudrate) ((uint8_t) ((((uint32_t)(F_MCP_CPU / 2)  / (baudrate)) - 1) & 0x3F))
+#define M_CNF1 MCP_CNF1_ENCODE(CAN_BT_SJW(M_TQ_PER_BIT, M_SP) - 1, \
+                               CAN_BT_BRP(F_MCP_CPU / 2, CAN_BITRATE, M_TQ_PER_BIT))
+#define M_CNF2 MCP_CNF2_ENCODE(1, 0, CAN_BT_PHASE1(M_TQ_PER_BIT, M_SP) - 1, \
+                               CAN_BT_PROP(M_TQ_PER_BIT, M_SP) - 1)
+#define M_CNF3 MCP_CNF3_ENCODE(1, 0, CAN_BT_PHASE2(M_TQ_PER_BIT, M_SP) - 1)
 
 static can_rx_handler_t m_rx_handler;
 static can_tx_handler_t m_tx_handler;
+static can_error_handler_t m_error_handler;
 
 static volatile uint8_t m_tx_buf_avail;
 
+// Shared with the interrupt handler
+static can_error_stats_t m_error_stats;
+static bool m_bus_off_pending;
+
+// Held in configuration mode until the bus-off backoff has passed
+static bool m_recovering;
+static uint32_t m_recover_at_ms;
+static uint32_t m_last_recovery_ms;
+static can_error_state_t m_reported_state;
+
 
 // Allocate and take the buffer with number buf_no
 static bool m_tx_buf_take(uint8_t buf_no)
@@ -124,7 +142,12 @@ static void m_rx_parse(uint8_t buf_no, can_msg_rx_t * msg, uint8_t * data_buf)
                         (((uint32_t) buf[MCP_RXBnEID0_OFFSET]) & 0x000FF);
     }
 
+    // DLC values 9 to 15 still mean 8 data bytes
     msg->data.len = buf[MCP_RXBnDLC_OFFSET] & 0x0F;
+    if (msg->data.len > MCP_DLC_MAX)
+    {
+        msg->data.len = MCP_DLC_MAX;
+    }
 
     // If data present, read it
     if (!remote && msg->data.len > 0)
@@ -151,6 +174,7 @@ static uint8_t m_send(uint8_t tx_buf_no, const can_id_t *id, const can_data_t *d
         uint8_t txbctrl_addr = MCP_TXBCTRL_ADDR(tx_buf_no);
         // Tell the controller to send the message. Use fixed priority for now
         mcp2515_write(txbctrl_addr, MCP_TXBnCTRL_ENCODE(1, MCP_TX_PRIORITY_LOWEST));
+        can_stats_tx((uint16_t) id->value, data ? data->len : 0);
 
         return CAN_SUCCESS;
     }
@@ -165,6 +189,7 @@ static void m_rx_evt_handle(uint8_t buf)
     static uint8_t rx_data_buf[MCP_DLC_MAX];
 
     m_rx_parse(buf, &rx_msg, &rx_data_buf[0]);
+    can_stats_rx((uint16_t) rx_msg.id.value, rx_msg.type == CAN_MSG_TYPE_DATA ? rx_msg.data.len : 0);
     m_rx_handler(buf, &rx_msg);
 }
 
@@ -175,6 +200,69 @@ static void m_tx_evt_handle(uint8_t buf)
     m_tx_handler(buf);
 }
 
+static void m_count(uint16_t * p_count)
+{
+    if (*p_count < UINT16_MAX)
+    {
+        (*p_count)++;
+    }
+}
+
+// Update the error state from EFLG. Call with interrupts disabled.
+static void m_error_state_update(uint8_t eflg)
+{
+    can_error_state_t state;
+
+    if (eflg & MCP_EFLG_TXBO)
+    {
+        state = CAN_ERROR_STATE_BUS_OFF;
+    }
+    else if (eflg & (MCP_EFLG_TXEP | MCP_EFLG_RXEP))
+    {
+        state = CAN_ERROR_STATE_PASSIVE;
+    }
+    else if (eflg & MCP_EFLG_EWARN)
+    {
+        state = CAN_ERROR_STATE_WARNING;
+    }
+    else
+    {
+        state = CAN_ERROR_STATE_ACTIVE;
+    }
+
+    if (state == CAN_ERROR_STATE_BUS_OFF && m_error_stats.state != CAN_ERROR_STATE_BUS_OFF)
+    {
+        m_count(&m_error_stats.bus_off_count);
+        m_bus_off_pending = true;
+    }
+    m_error_stats.state = state;
+}
+
+// Handle an EFLG change
+static void m_error_evt_handle(void)
+{
+    uint8_t eflg = mcp2515_read(MCP_EFLG);
+
+    if (eflg & MCP_EFLG_RX0OVR)
+    {
+        m_count(&m_error_stats.rx_overflow_count);
+    }
+    if (eflg & MCP_EFLG_RX1OVR)
+    {
+        m_count(&m_error_stats.rx_overflow_count);
+    }
+    // The overflow flags are the only ones cleared by software
+    if (eflg & (MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR))
+    {
+        mcp2515_bit_modify(MCP_EFLG, MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR, 0);
+    }
+
+    if (!m_recovering)
+    {
+        m_error_state_update(eflg);
+    }
+}
+
 // Handle interrupts from the MCP2515
 static void m_mcp2515_evt_handler(uint8_t int_flags)
 {
@@ -206,7 +294,7 @@ static void m_mcp2515_evt_handler(uint8_t int_flags)
     if (int_flags & MCP_CANINTF_ERRIF)
     {
         // An error occurred. EFLG can be checked for further information.
-        // May need some additional handling here to clear the EFLG bits.
+        m_error_evt_handle();
     }
     if (int_flags & MCP_CANINTF_WAKIF)
     {
@@ -215,10 +303,11 @@ static void m_mcp2515_evt_handler(uint8_t int_flags)
     if (int_flags & MCP_CANINTF_MERRF)
     {
         // A message error occurred on transmission or reception.
+        m_count(&m_error_stats.bus_error_count);
     }
 
-    // For now, clear all interrupts unconditionally
-    mcp2515_write(MCP_CANINTF, 0);
+    // Clear only the handled interrupts, so none raised meanwhile is lost
+    mcp2515_bit_modify(MCP_CANINTF, int_flags, 0);
 }
 
 uint8_t can_init(const can_init_t * init_params)
@@ -227,21 +316,17 @@ uint8_t can_init(const can_init_t * init_params)
     assert(init_params->rx_handler);
     assert(init_params->tx_handler);
 
-    const can_bit_timing_t * bit_cfg = &init_params->bit;
-
-    /// Check bit timing allowed values
-    assert(1 <= bit_cfg->sync_jump_len && bit_cfg->sync_jump_len <= 4);
-    assert(1 <= bit_cfg->prop_seg_len && bit_cfg->prop_seg_len <= 8);
-    assert(1 <= bit_cfg->phase_1_len && bit_cfg->phase_1_len <= 8);
-    assert(IPT_TQ <= bit_cfg->phase_2_len && bit_cfg->phase_2_len <= 8);
-
-    // Check bit timing requirements; see mcp2515 sec. 5.3
-    assert(bit_cfg->prop_seg_len + bit_cfg->phase_1_len >= bit_cfg->phase_2_len);
-    assert(bit_cfg->phase_2_len > bit_cfg->sync_jump_len);
-
 
     m_rx_handler = init_params->rx_handler;
     m_tx_handler = init_params->tx_handler;
+    m_error_handler = init_params->error_handler;
+
+    memset(&m_error_stats, 0, sizeof(m_error_stats));
+    m_error_stats.backoff_ms = CAN_BUS_OFF_BACKOFF_MIN_MS;
+    m_bus_off_pending = false;
+    m_recovering = false;
+    m_reported_state = CAN_ERROR_STATE_ACTIVE;
+    can_stats_init();
 
     // Initialize TX buffer availability bitfield to all ones
     m_tx_buf_avail = (1 << MCP_TX_BUF_COUNT) - 1;
@@ -255,20 +340,14 @@ uint8_t can_init(const can_init_t * init_params)
     mcp2515_bit_modify(MCP_CANCTRL, MCP_CANCTRL_MODE_MASK, MCP_CANCTRL_MODE_CONFIG);
 
 	// Configure bit timing configuration
-    uint8_t brp = BRP_CALCULATE(init_params->bit.baudrate);
-    uint8_t cnf1 = MCP_CNF1_ENCODE(init_params->bit.sync_jump_len - 1, brp);
-    uint8_t cnf2 = MCP_CNF2_ENCODE(1, 0, init_params->bit.phase_1_len - 1,
-                                   init_params->bit.prop_seg_len - 1);
-    uint8_t cnf3 = MCP_CNF3_ENCODE(1, 0, init_params->bit.phase_2_len - 1);
-
-	mcp2515_write(MCP_CNF1, cnf1); // BRP = 2*TQ
-	mcp2515_write(MCP_CNF2, cnf2);
-	mcp2515_write(MCP_CNF3, cnf3);
+	mcp2515_write(MCP_CNF1, M_CNF1);
+	mcp2515_write(MCP_CNF2, M_CNF2);
+	mcp2515_write(MCP_CNF3, M_CNF3);
 
 	// Verify configuration (validate write order)
-	assert(cnf1 == mcp2515_read(MCP_CNF1));
-	assert(cnf2 == mcp2515_read(MCP_CNF2));
-	assert(cnf3 == mcp2515_read(MCP_CNF3));
+	assert(M_CNF1 == mcp2515_read(MCP_CNF1));
+	assert(M_CNF2 == mcp2515_read(MCP_CNF2));
+	assert(M_CNF3 == mcp2515_read(MCP_CNF3));
 
     // Set normal mode
     uint8_t canctrl = MCP_CANCTRL_MODE_NORMAL |
@@ -316,3 +395,72 @@ uint8_t can_get_error_counters(can_error_counter_t * counts)
 
     return CAN_SUCCESS;
 }
+
+void can_error_poll(uint32_t now_ms)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    if (!m_recovering)
+    {
+        // ERRIF is not raised when the state improves, so read EFLG here too
+        m_error_state_update(mcp2515_read(MCP_EFLG));
+    }
+
+    uint8_t buf[2];
+    mcp2515_read_multiple(MCP_TEC, &buf[0], 2);
+    m_error_stats.counters.tec = buf[0];
+    m_error_stats.counters.rec = buf[1];
+
+    if (m_bus_off_pending)
+    {
+        // Stay off the bus for the backoff time. Pending transmissions are
+        // dropped; the application resends periodically anyway.
+        m_bus_off_pending = false;
+        mcp2515_bit_modify(MCP_CANCTRL, MCP_CANCTRL_ABORT_TX, MCP_CANCTRL_ABORT_TX);
+        mcp2515_bit_modify(MCP_CANCTRL, MCP_CANCTRL_MODE_MASK, MCP_CANCTRL_MODE_CONFIG);
+        m_tx_buf_avail = (1 << MCP_TX_BUF_COUNT) - 1;
+        m_recovering = true;
+        m_recover_at_ms = now_ms + m_error_stats.backoff_ms;
+    }
+    else if (m_recovering && (int32_t) (now_ms - m_recover_at_ms) >= 0)
+    {
+        // The controller rejoins after 128 x 11 recessive bits
+        mcp2515_bit_modify(MCP_CANCTRL, MCP_CANCTRL_MODE_MASK | MCP_CANCTRL_ABORT_TX,
+                           MCP_CANCTRL_MODE_NORMAL);
+        m_recovering = false;
+        m_last_recovery_ms = now_ms;
+        m_count(&m_error_stats.recovery_count);
+        m_error_stats.backoff_ms = m_error_stats.backoff_ms * 2 < CAN_BUS_OFF_BACKOFF_MAX_MS ?
+                                   m_error_stats.backoff_ms * 2 : CAN_BUS_OFF_BACKOFF_MAX_MS;
+    }
+    else if (!m_recovering &&
+             m_error_stats.state != CAN_ERROR_STATE_BUS_OFF &&
+             now_ms - m_last_recovery_ms >= CAN_BUS_OFF_STABLE_MS)
+    {
+        m_error_stats.backoff_ms = CAN_BUS_OFF_BACKOFF_MIN_MS;
+    }
+
+    can_error_stats_t stats = m_error_stats;
+
+    SREG = sreg;
+
+    if (stats.state != m_reported_state)
+    {
+        m_reported_state = stats.state;
+        if (m_error_handler)
+        {
+            m_error_handler(stats.state, &stats);
+        }
+    }
+}
+
+void can_error_stats_get(can_error_stats_t * stats)
+{
+    assert(stats);
+
+    uint8_t sreg = SREG;
+    cli();
+    *stats = m_error_stats;
+    SREG = sreg;
+}
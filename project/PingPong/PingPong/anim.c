@@ -0,0 +1,281 @@
+/*
+ * Frame-paced animation on the OLED, double buffered in external SRAM.
+ */
+
+#include "anim.h"
+#include "oled.h"
+#include "ping_pong.h"
+#include "profiler.h"
+#include "timer.h"
+#include "xmem.h"
+
+// Sprite positions and velocities are in 1/16 pixels
+#define M_POS_SHIFT (4)
+
+#define M_STATS_WINDOW_MS (1000)
+#define M_STATUS_PAGE     (ANIM_HEIGHT / 8 + 1)
+#define M_HINT_PAGE       (7)
+
+// After a long stall the sprites are moved on by at most this many frames
+#define M_MAX_CATCHUP_STEPS (ANIM_TARGET_FPS)
+
+#define M_FB_SIZE GFX_FB_SIZE(ANIM_WIDTH, ANIM_HEIGHT)
+
+#define M_CYCLES_TO_US(cycles) ((uint32_t) (((uint64_t) (cycles) * 1000000UL) / F_CPU))
+
+typedef struct
+{
+    const gfx_bitmap_t * p_bitmap;
+    int16_t x;
+    int16_t y;
+    int8_t vx;
+    int8_t vy;
+} m_sprite_t;
+
+// 8x8 ball
+static const uint8_t m_ball_data[8] = { 0x3C, 0x7E, 0xFF, 0xFF, 0xFF, 0xFF, 0x7E, 0x3C };
+static const gfx_bitmap_t m_ball = { .p_data = m_ball_data, .width = 8, .height = 8 };
+
+// The back buffer is drawn, the front buffer mirrors the display. Both are
+// taken from the external SRAM heap while the animation runs.
+static gfx_fb_t m_back;
+static gfx_fb_t m_front;
+static uint16_t m_heap_mark;
+
+static m_sprite_t m_sprites[ANIM_MAX_SPRITES];
+static uint8_t m_sprite_count;
+
+static bool m_running;
+static uint32_t m_frame_ms;
+
+static anim_stats_t m_stats;
+static uint32_t m_window_start_ms;
+static uint16_t m_window_frames;
+static uint32_t m_window_flush_bytes;
+
+static void m_sprite_move(m_sprite_t * p_sprite)
+{
+    int16_t max_x = (int16_t) (ANIM_WIDTH - p_sprite->p_bitmap->width) << M_POS_SHIFT;
+    int16_t max_y = (int16_t) (ANIM_HEIGHT - p_sprite->p_bitmap->height) << M_POS_SHIFT;
+
+    p_sprite->x += p_sprite->vx;
+    p_sprite->y += p_sprite->vy;
+
+    // Bounce off the edges of the playfield
+    if (p_sprite->x < 0 || p_sprite->x > max_x)
+    {
+        p_sprite->vx = -p_sprite->vx;
+        p_sprite->x = p_sprite->x < 0 ? -p_sprite->x : 2 * max_x - p_sprite->x;
+    }
+    if (p_sprite->y < 0 || p_sprite->y > max_y)
+    {
+        p_sprite->vy = -p_sprite->vy;
+        p_sprite->y = p_sprite->y < 0 ? -p_sprite->y : 2 * max_y - p_sprite->y;
+    }
+}
+
+static void m_render(void)
+{
+    gfx_clear(&m_back, GFX_COLOR_OFF);
+    gfx_rect(&m_back, 0, 0, ANIM_WIDTH, ANIM_HEIGHT, GFX_COLOR_ON);
+
+    for (uint8_t i = 0; i < m_sprite_count; i++)
+    {
+        const m_sprite_t *p_sprite = &m_sprites[i];
+        gfx_blit(&m_back, p_sprite->x >> M_POS_SHIFT, p_sprite->y >> M_POS_SHIFT,
+                 p_sprite->p_bitmap, GFX_COLOR_INVERT);
+    }
+}
+
+// Send the changed span of every page and bring the front buffer up to date.
+// Returns the number of bytes sent.
+static uint16_t m_flush(void)
+{
+    uint16_t sent = 0;
+
+    for (uint8_t page = 0; page < m_back.pages; page++)
+    {
+        uint8_t *p_back = &m_back.p_buf[(uint16_t) page * ANIM_WIDTH];
+        uint8_t *p_front = &m_front.p_buf[(uint16_t) page * ANIM_WIDTH];
+        uint8_t first = 0;
+        uint8_t last = ANIM_WIDTH - 1;
+
+        while (first < ANIM_WIDTH && p_back[first] == p_front[first])
+        {
+            first++;
+        }
+        if (first == ANIM_WIDTH)
+        {
+            continue;
+        }
+        while (p_back[last] == p_front[last])
+        {
+            last--;
+        }
+
+        uint8_t len = last - first + 1;
+        oled_page_write(page, first, &p_back[first], len);
+        memcpy(&p_front[first], &p_back[first], len);
+        sent += len;
+    }
+
+    return sent;
+}
+
+static void m_status_draw(void)
+{
+    oled_pos(M_STATUS_PAGE, 0);
+    oled_printf_P(PSTR("FPS %2u.%u DROP %5lu"), false,
+                m_stats.fps_x10 / 10, m_stats.fps_x10 % 10,
+                (unsigned long) m_stats.dropped_count);
+}
+
+static void m_window_update(uint32_t now, uint16_t flush_bytes)
+{
+    m_window_frames++;
+    m_window_flush_bytes += flush_bytes;
+
+    uint32_t elapsed = now - m_window_start_ms;
+    if (elapsed < M_STATS_WINDOW_MS)
+    {
+        return;
+    }
+
+    m_stats.fps_x10 = (uint16_t) (((uint32_t) m_window_frames * 10000UL) / elapsed);
+    m_stats.flush_bytes_avg = (uint16_t) (m_window_flush_bytes / m_window_frames);
+    m_window_start_ms = now;
+    m_window_frames = 0;
+    m_window_flush_bytes = 0;
+
+    m_status_draw();
+}
+
+bool anim_init(void)
+{
+    m_running = false;
+    m_sprite_count = 0;
+
+    return true;
+}
+
+bool anim_sprite_add(const gfx_bitmap_t * p_bitmap, int16_t x, int16_t y, int8_t vx, int8_t vy)
+{
+    assert(p_bitmap);
+
+    if (m_sprite_count >= ANIM_MAX_SPRITES)
+    {
+        return false;
+    }
+
+    m_sprites[m_sprite_count++] = (m_sprite_t) {
+        .p_bitmap = p_bitmap,
+        .x = x << M_POS_SHIFT,
+        .y = y << M_POS_SHIFT,
+        .vx = vx,
+        .vy = vy,
+    };
+
+    return true;
+}
+
+bool anim_start(void)
+{
+    m_heap_mark = xmem_mark();
+
+    uint8_t *p_mem = xmem_alloc(2 * M_FB_SIZE, 1);
+    if (!p_mem ||
+        !gfx_fb_init(&m_back, p_mem, ANIM_WIDTH, ANIM_HEIGHT) ||
+        !gfx_fb_init(&m_front, p_mem + M_FB_SIZE, ANIM_WIDTH, ANIM_HEIGHT))
+    {
+        xmem_release(m_heap_mark);
+        return false;
+    }
+
+    // The display is blank after the reset, and so is the front buffer
+    oled_reset();
+    gfx_clear(&m_front, GFX_COLOR_OFF);
+
+    m_sprite_count = 0;
+    (void) anim_sprite_add(&m_ball, 10, 4, 37, 21);
+    (void) anim_sprite_add(&m_ball, 60, 20, -29, 13);
+    (void) anim_sprite_add(&m_ball, 100, 10, 17, -31);
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_frame_ms = timer_ms_get();
+    m_window_start_ms = m_frame_ms;
+    m_window_frames = 0;
+    m_window_flush_bytes = 0;
+    m_running = true;
+
+    m_render();
+    (void) m_flush();
+    m_status_draw();
+    oled_pos(M_HINT_PAGE, 0);
+    oled_printf_P(PSTR("< TO EXIT"), false);
+
+    return true;
+}
+
+void anim_stop(void)
+{
+    if (m_running)
+    {
+        m_running = false;
+        xmem_release(m_heap_mark);
+    }
+}
+
+bool anim_running(void)
+{
+    return m_running;
+}
+
+void anim_frame(void)
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    uint32_t probe_start = profiler_probe_begin();
+    uint32_t now = timer_ms_get();
+
+    // Frame slots elapsed since the last frame, rounded so that jitter in
+    // the task release does not count as a drop
+    uint32_t steps = (now - m_frame_ms + ANIM_FRAME_MS / 2) / ANIM_FRAME_MS;
+    if (steps == 0)
+    {
+        return;
+    }
+    m_frame_ms += steps * ANIM_FRAME_MS;
+    m_stats.dropped_count += steps - 1;
+
+    uint8_t moves = steps > M_MAX_CATCHUP_STEPS ? M_MAX_CATCHUP_STEPS : (uint8_t) steps;
+    for (uint8_t i = 0; i < m_sprite_count; i++)
+    {
+        for (uint8_t step = 0; step < moves; step++)
+        {
+            m_sprite_move(&m_sprites[i]);
+        }
+    }
+
+    m_render();
+    uint16_t flush_bytes = m_flush();
+
+    m_stats.frame_count++;
+    m_window_update(now, flush_bytes);
+
+    uint32_t cycles = profiler_cycles_get() - probe_start;
+    if (M_CYCLES_TO_US(cycles) > m_stats.worst_frame_us)
+    {
+        m_stats.worst_frame_us = M_CYCLES_TO_US(cycles);
+    }
+    profiler_probe_end(PROFILER_PROBE_ANIM_FRAME, probe_start);
+}
+
+void anim_stats_get(anim_stats_t * p_stats_out)
+{
+    assert(p_stats_out);
+
+    *p_stats_out = m_stats;
+}
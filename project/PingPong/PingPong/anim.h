@@ -0,0 +1,51 @@
+/*
+ * Frame-paced animation on the OLED.
+ *
+ * Frames are drawn into a back buffer in external SRAM. A front buffer holds
+ * a copy of what the display shows, and only the bytes that differ are sent
+ * over the bus. The playfield covers the top ANIM_HEIGHT pixels; the page
+ * below it shows the achieved frame rate.
+ *
+ * anim_frame() is called from a periodic task. Frames that could not be
+ * drawn in time are counted as dropped and the sprites are moved on, so the
+ * motion keeps its speed when the frame rate falls behind.
+ */
+#ifndef ANIM_H__
+#define ANIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gfx.h"
+
+#define ANIM_TARGET_FPS (30)
+#define ANIM_FRAME_MS   (1000 / ANIM_TARGET_FPS)
+
+#define ANIM_WIDTH       (128)
+#define ANIM_HEIGHT      (40)
+#define ANIM_MAX_SPRITES (4)
+
+typedef struct
+{
+    // Frame rate over the last second, in 1/10 frames per second
+    uint16_t fps_x10;
+    uint32_t frame_count;
+    uint32_t dropped_count;
+    // Average bytes sent to the display per frame over the last second
+    uint16_t flush_bytes_avg;
+    uint32_t worst_frame_us;
+} anim_stats_t;
+
+bool anim_init(void);
+// Clear the display and start the bouncing ball scene. Returns false if
+// the framebuffers do not fit in the external SRAM heap.
+bool anim_start(void);
+void anim_stop(void);
+bool anim_running(void);
+// Add a sprite moving at (vx, vy) pixels per frame, in 1/16 pixel units.
+// Returns false if the sprite table is full.
+bool anim_sprite_add(const gfx_bitmap_t * p_bitmap, int16_t x, int16_t y, int8_t vx, int8_t vy);
+// Draw the next frame if one is due. Does nothing while stopped.
+void anim_frame(void);
+void anim_stats_get(anim_stats_t * p_stats_out);
+
+#endif /* ANIM_H__ */
@@ -0,0 +1,26 @@
+/*
+ * Node1 side of the shared CAN statistics (common/src/can_stats.c).
+ */
+#ifndef CAN_STATS_PORT_H__
+#define CAN_STATS_PORT_H__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef uint8_t can_stats_lock_t;
+
+// Disable interrupts, returning the state to restore
+static inline can_stats_lock_t can_stats_lock(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    return sreg;
+}
+
+static inline void can_stats_unlock(can_stats_lock_t sreg)
+{
+    SREG = sreg;
+}
+
+#endif /* CAN_STATS_PORT_H__ */
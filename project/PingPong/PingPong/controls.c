@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <util/delay.h>
 #include "ext_peripherals.h"
+#include "profiler.h"
 
 #define M_ADC_ADDRESS     (0x1400)
 #define M_MCU_RC_OSC_FREQ (8000000)
@@ -41,6 +42,8 @@
 
 static void m_run_sampling(uint8_t *p_channel_data_buffer)
 {
+	uint32_t probe_start = profiler_probe_begin();
+
 	// toggle WR by writing to the ADC's address space
 	*EXT_ADC = 0;
 
@@ -54,6 +57,8 @@ static void m_run_sampling(uint8_t *p_channel_data_buffer)
 		// The first RAM location read out is CH0, then CH1, and so on
 		p_channel_data_buffer[i] = *EXT_ADC;
 	}
+
+	profiler_probe_end(PROFILER_PROBE_ADC_SAMPLE, probe_start);
 }
 
 static uint8_t m_convert_voltage_to_angle(uint8_t adc_sample)
@@ -140,4 +145,13 @@ void get_sliders_pos(sliders_position_t *p_slider_position_out)
 	
 	p_slider_position_out->right_slider_pos = adc_channels[2];
 	p_slider_position_out->left_slider_pos  = adc_channels[3];
+}
+
+void get_buttons_state(buttons_state_t *p_buttons_out)
+{
+	/* The touch-buttons drive their pin high while touched */
+	uint8_t pins = PINB;
+
+	p_buttons_out->right_pressed = (pins & M_R_BUTTON_PIN) != 0;
+	p_buttons_out->left_pressed  = (pins & M_L_BUTTON_PIN) != 0;
 }
\ No newline at end of file
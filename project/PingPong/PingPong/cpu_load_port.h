@@ -0,0 +1,29 @@
+/*
+ * Node1 side of the shared CPU load accounting (common/src/cpu_load.c),
+ * counting with the profiler's Timer1 at F_CPU.
+ */
+#ifndef CPU_LOAD_PORT_H__
+#define CPU_LOAD_PORT_H__
+
+#include <stdint.h>
+#include "ping_pong.h"
+#include "profiler.h"
+
+#define CPU_LOAD_CYCLES_PER_MS (F_CPU / 1000UL)
+
+// Timer1 is started by profiler_init()
+static inline void cpu_load_cycles_init(void)
+{
+}
+
+static inline uint32_t cpu_load_cycles_get(void)
+{
+    return profiler_cycles_get();
+}
+
+static inline uint32_t cpu_load_cycles_to_us(uint32_t cycles)
+{
+    return (uint32_t) (((uint64_t) cycles * 1000000UL) / F_CPU);
+}
+
+#endif /* CPU_LOAD_PORT_H__ */
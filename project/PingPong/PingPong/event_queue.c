@@ -0,0 +1,67 @@
+/*
+ * Queue of input events.
+ */
+
+#include <avr/interrupt.h>
+#include "ping_pong.h"
+#include "event_queue.h"
+
+static event_t m_events[EVENT_QUEUE_SIZE];
+static volatile uint8_t m_head;
+static volatile uint8_t m_tail;
+static volatile uint16_t m_dropped;
+
+void event_queue_init(void)
+{
+    m_head = 0;
+    m_tail = 0;
+    m_dropped = 0;
+}
+
+bool event_queue_put(const event_t * p_event)
+{
+    bool success = false;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    uint8_t next = (m_tail + 1) & (EVENT_QUEUE_SIZE - 1);
+    if (next != m_head)
+    {
+        m_events[m_tail] = *p_event;
+        m_tail = next;
+        success = true;
+    }
+    else
+    {
+        m_dropped++;
+    }
+
+    SREG = sreg;
+
+    return success;
+}
+
+bool event_queue_get(event_t * p_event_out)
+{
+    // Single consumer: only the producer side needs protection
+    if (m_head == m_tail)
+    {
+        return false;
+    }
+
+    *p_event_out = m_events[m_head];
+    m_head = (m_head + 1) & (EVENT_QUEUE_SIZE - 1);
+
+    return true;
+}
+
+uint16_t event_queue_dropped_get(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t dropped = m_dropped;
+    SREG = sreg;
+
+    return dropped;
+}
@@ -0,0 +1,49 @@
+/*
+ * Queue of input events, filled from interrupt handlers and sampling tasks
+ * and consumed by the user interface task.
+ */
+#ifndef EVENT_QUEUE_H__
+#define EVENT_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENT_QUEUE_SIZE (8) // must be a power of two
+
+typedef enum
+{
+    EVENT_JOYSTICK,  // joystick direction changed or auto-repeat
+    EVENT_CAN_RX,    // CAN data frame received
+    EVENT_UART_RX,   // character received on the UART
+} event_type_t;
+
+typedef struct
+{
+    uint8_t type;
+    union
+    {
+        struct
+        {
+            uint8_t x_dir;
+            uint8_t y_dir;
+        } joystick;
+        struct
+        {
+            uint16_t id;
+            uint8_t len;
+            uint8_t data[8];
+        } can;
+        char uart_char;
+    };
+} event_t;
+
+// Initialize an empty queue
+void event_queue_init(void);
+// Add an event. Interrupt safe. Returns false if the queue is full.
+bool event_queue_put(const event_t * p_event);
+// Take the oldest event. Returns false if the queue is empty.
+bool event_queue_get(event_t * p_event_out);
+// Number of events dropped because the queue was full
+uint16_t event_queue_dropped_get(void);
+
+#endif /* EVENT_QUEUE_H__ */
@@ -18,6 +18,8 @@
 #define EXT_SRAM_MEM_START 0x1800
 #define EXT_SRAM_MEM_SIZE 2048
 
+/* External SRAM is laid out by the linker (.xmem) and allocated through xmem.h */
+
 typedef struct __attribute__((packed,aligned(1))) {
   uint8_t CMD;
   uint8_t _unused_cmd[EXT_OLED_CMD_MEM_SIZE - sizeof(uint8_t)];
@@ -0,0 +1,310 @@
+/*
+ * Drawing primitives on a page-organized 1-bit framebuffer.
+ *
+ * Everything is reduced to applying a bit mask to one framebuffer byte, so
+ * a vertical span costs one operation per page instead of one per pixel.
+ */
+
+#include "gfx.h"
+#include "ping_pong.h"
+
+// Rows [first, last] of a page (0-7) as a bit mask
+#define M_ROW_MASK(first, last) ((uint8_t) ((0xFF << (first)) & (0xFF >> (7 - (last)))))
+
+static inline void m_apply(uint8_t * p_byte, uint8_t mask, gfx_color_t color)
+{
+    switch (color)
+    {
+        case GFX_COLOR_ON:
+            *p_byte |= mask;
+            break;
+        case GFX_COLOR_OFF:
+            *p_byte &= ~mask;
+            break;
+        default:
+            *p_byte ^= mask;
+            break;
+    }
+}
+
+static inline uint8_t * m_byte_get(const gfx_fb_t * p_fb, uint8_t page, uint8_t x)
+{
+    return &p_fb->p_buf[(uint16_t) page * p_fb->width + x];
+}
+
+// Clip [*p_start, *p_start + *p_len) to [0, limit). Returns false if nothing is left.
+static bool m_clip(int16_t * p_start, int16_t * p_len, int16_t limit)
+{
+    if (*p_start < 0)
+    {
+        *p_len += *p_start;
+        *p_start = 0;
+    }
+    if (*p_start + *p_len > limit)
+    {
+        *p_len = limit - *p_start;
+    }
+
+    return *p_len > 0;
+}
+
+bool gfx_fb_init(gfx_fb_t * p_fb, uint8_t * p_buf, uint8_t width, uint8_t height)
+{
+    if (!p_fb || !p_buf || width == 0 || height == 0 || (height % 8) != 0)
+    {
+        return false;
+    }
+
+    p_fb->p_buf = p_buf;
+    p_fb->width = width;
+    p_fb->pages = height / 8;
+
+    return true;
+}
+
+void gfx_clear(const gfx_fb_t * p_fb, gfx_color_t color)
+{
+    uint16_t size = (uint16_t) p_fb->pages * p_fb->width;
+
+    if (color == GFX_COLOR_INVERT)
+    {
+        for (uint16_t i = 0; i < size; i++)
+        {
+            p_fb->p_buf[i] ^= 0xFF;
+        }
+    }
+    else
+    {
+        memset(p_fb->p_buf, color == GFX_COLOR_ON ? 0xFF : 0x00, size);
+    }
+}
+
+void gfx_pixel(const gfx_fb_t * p_fb, int16_t x, int16_t y, gfx_color_t color)
+{
+    if (x < 0 || x >= p_fb->width || y < 0 || y >= GFX_FB_HEIGHT(p_fb))
+    {
+        return;
+    }
+
+    m_apply(m_byte_get(p_fb, y >> 3, x), 1 << (y & 7), color);
+}
+
+bool gfx_pixel_get(const gfx_fb_t * p_fb, int16_t x, int16_t y)
+{
+    if (x < 0 || x >= p_fb->width || y < 0 || y >= GFX_FB_HEIGHT(p_fb))
+    {
+        return false;
+    }
+
+    return (*m_byte_get(p_fb, y >> 3, x) >> (y & 7)) & 1;
+}
+
+void gfx_fill_rect(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, int16_t h, gfx_color_t color)
+{
+    if (!m_clip(&x, &w, p_fb->width) || !m_clip(&y, &h, GFX_FB_HEIGHT(p_fb)))
+    {
+        return;
+    }
+
+    uint8_t first_page = y >> 3;
+    uint8_t last_page = (y + h - 1) >> 3;
+
+    for (uint8_t page = first_page; page <= last_page; page++)
+    {
+        uint8_t first_row = page == first_page ? (y & 7) : 0;
+        uint8_t last_row = page == last_page ? ((y + h - 1) & 7) : 7;
+        uint8_t mask = M_ROW_MASK(first_row, last_row);
+        uint8_t * p_byte = m_byte_get(p_fb, page, x);
+
+        // Span over the columns of this page with a constant mask
+        for (int16_t i = 0; i < w; i++)
+        {
+            m_apply(p_byte++, mask, color);
+        }
+    }
+}
+
+void gfx_hline(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, gfx_color_t color)
+{
+    gfx_fill_rect(p_fb, x, y, w, 1, color);
+}
+
+void gfx_vline(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t h, gfx_color_t color)
+{
+    gfx_fill_rect(p_fb, x, y, 1, h, color);
+}
+
+void gfx_line(const gfx_fb_t * p_fb, int16_t x0, int16_t y0, int16_t x1, int16_t y1, gfx_color_t color)
+{
+    if (y0 == y1)
+    {
+        gfx_hline(p_fb, x0 < x1 ? x0 : x1, y0, (x0 < x1 ? x1 - x0 : x0 - x1) + 1, color);
+        return;
+    }
+    if (x0 == x1)
+    {
+        gfx_vline(p_fb, x0, y0 < y1 ? y0 : y1, (y0 < y1 ? y1 - y0 : y0 - y1) + 1, color);
+        return;
+    }
+
+    // Bresenham
+    int16_t dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int16_t dy = y1 > y0 ? y0 - y1 : y1 - y0;
+    int8_t sx = x0 < x1 ? 1 : -1;
+    int8_t sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+
+    while (1)
+    {
+        gfx_pixel(p_fb, x0, y0, color);
+        if (x0 == x1 && y0 == y1)
+        {
+            break;
+        }
+
+        int16_t err2 = 2 * err;
+        if (err2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (err2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void gfx_rect(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, int16_t h, gfx_color_t color)
+{
+    if (w <= 0 || h <= 0)
+    {
+        return;
+    }
+
+    gfx_hline(p_fb, x, y, w, color);
+    if (h > 1)
+    {
+        gfx_hline(p_fb, x, y + h - 1, w, color);
+    }
+    // The sides leave out the corners so inverting draws every pixel once
+    if (h > 2)
+    {
+        gfx_vline(p_fb, x, y + 1, h - 2, color);
+        if (w > 1)
+        {
+            gfx_vline(p_fb, x + w - 1, y + 1, h - 2, color);
+        }
+    }
+}
+
+void gfx_circle(const gfx_fb_t * p_fb, int16_t cx, int16_t cy, int16_t r, gfx_color_t color)
+{
+    // Midpoint circle, one octant mirrored eight ways
+    int16_t x = r;
+    int16_t y = 0;
+    int16_t err = 1 - r;
+
+    while (x >= y)
+    {
+        gfx_pixel(p_fb, cx + x, cy + y, color);
+        gfx_pixel(p_fb, cx - x, cy + y, color);
+        gfx_pixel(p_fb, cx + x, cy - y, color);
+        gfx_pixel(p_fb, cx - x, cy - y, color);
+        gfx_pixel(p_fb, cx + y, cy + x, color);
+        gfx_pixel(p_fb, cx - y, cy + x, color);
+        gfx_pixel(p_fb, cx + y, cy - x, color);
+        gfx_pixel(p_fb, cx - y, cy - x, color);
+
+        y++;
+        if (err < 0)
+        {
+            err += 2 * y + 1;
+        }
+        else
+        {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+void gfx_fill_circle(const gfx_fb_t * p_fb, int16_t cx, int16_t cy, int16_t r, gfx_color_t color)
+{
+    if (r < 0)
+    {
+        return;
+    }
+
+    // One vertical span per column: the columns are what the framebuffer
+    // stores contiguously. Half height shrinks as |dx| grows.
+    int32_t r2 = (int32_t) r * r;
+    int16_t half = r;
+
+    for (int16_t dx = 0; dx <= r; dx++)
+    {
+        while ((int32_t) dx * dx + (int32_t) half * half > r2)
+        {
+            half--;
+        }
+
+        gfx_vline(p_fb, cx + dx, cy - half, 2 * half + 1, color);
+        if (dx != 0)
+        {
+            gfx_vline(p_fb, cx - dx, cy - half, 2 * half + 1, color);
+        }
+    }
+}
+
+void gfx_blit(const gfx_fb_t * p_fb, int16_t x, int16_t y, const gfx_bitmap_t * p_bitmap, gfx_color_t color)
+{
+    uint8_t src_pages = (p_bitmap->height + 7) / 8;
+    uint8_t shift = y & 7;
+    int16_t dst_page = y >> 3; // rounds towards minus infinity
+
+    int16_t col_start = x < 0 ? -x : 0;
+    int16_t col_end = p_bitmap->width;
+    if (x + col_end > p_fb->width)
+    {
+        col_end = p_fb->width - x;
+    }
+    if (col_start >= col_end)
+    {
+        return;
+    }
+
+    for (uint8_t src_page = 0; src_page < src_pages; src_page++, dst_page++)
+    {
+        // Bitmap rows below its height are not part of it
+        uint8_t valid = 0xFF;
+        if (src_page == src_pages - 1 && (p_bitmap->height & 7))
+        {
+            valid = 0xFF >> (8 - (p_bitmap->height & 7));
+        }
+
+        bool upper_visible = dst_page >= 0 && dst_page < p_fb->pages;
+        bool lower_visible = shift != 0 && dst_page + 1 >= 0 && dst_page + 1 < p_fb->pages;
+        if (!upper_visible && !lower_visible)
+        {
+            continue;
+        }
+
+        const uint8_t * p_src = &p_bitmap->p_data[(uint16_t) src_page * p_bitmap->width];
+
+        // A source page straddles two destination pages unless aligned
+        for (int16_t col = col_start; col < col_end; col++)
+        {
+            uint8_t bits = p_src[col] & valid;
+
+            if (upper_visible)
+            {
+                m_apply(m_byte_get(p_fb, dst_page, x + col), bits << shift, color);
+            }
+            if (lower_visible)
+            {
+                m_apply(m_byte_get(p_fb, dst_page + 1, x + col), bits >> (8 - shift), color);
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Drawing primitives on a 1-bit framebuffer organized like the OLED memory.
+ *
+ * The buffer holds `pages` rows of `width` bytes. Each byte is a column of
+ * 8 pixels, the least significant bit on top. The caller owns and sizes the
+ * buffer, so framebuffers may live in internal or external SRAM.
+ *
+ * Coordinates are signed; anything outside the framebuffer is clipped.
+ */
+#ifndef GFX_H__
+#define GFX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    uint8_t * p_buf;
+    uint8_t width;
+    uint8_t pages;
+} gfx_fb_t;
+
+typedef enum
+{
+    GFX_COLOR_OFF = 0,
+    GFX_COLOR_ON,
+    GFX_COLOR_INVERT,
+} gfx_color_t;
+
+// Page-organized bitmap, same layout as a framebuffer
+typedef struct
+{
+    const uint8_t * p_data;
+    uint8_t width;
+    uint8_t height;
+} gfx_bitmap_t;
+
+// Height in pixels of a framebuffer
+#define GFX_FB_HEIGHT(p_fb) ((int16_t) (p_fb)->pages * 8)
+// Bytes needed for a framebuffer of the given size
+#define GFX_FB_SIZE(width, height) ((uint16_t) (width) * (((height) + 7) / 8))
+
+// Set up a framebuffer over `p_buf`, which must hold GFX_FB_SIZE bytes
+bool gfx_fb_init(gfx_fb_t * p_fb, uint8_t * p_buf, uint8_t width, uint8_t height);
+void gfx_clear(const gfx_fb_t * p_fb, gfx_color_t color);
+
+void gfx_pixel(const gfx_fb_t * p_fb, int16_t x, int16_t y, gfx_color_t color);
+bool gfx_pixel_get(const gfx_fb_t * p_fb, int16_t x, int16_t y);
+void gfx_hline(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, gfx_color_t color);
+void gfx_vline(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t h, gfx_color_t color);
+void gfx_line(const gfx_fb_t * p_fb, int16_t x0, int16_t y0, int16_t x1, int16_t y1, gfx_color_t color);
+void gfx_rect(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, int16_t h, gfx_color_t color);
+void gfx_fill_rect(const gfx_fb_t * p_fb, int16_t x, int16_t y, int16_t w, int16_t h, gfx_color_t color);
+// Outline only. With GFX_COLOR_INVERT the few pixels where octants meet
+// are drawn twice and cancel out.
+void gfx_circle(const gfx_fb_t * p_fb, int16_t cx, int16_t cy, int16_t r, gfx_color_t color);
+void gfx_fill_circle(const gfx_fb_t * p_fb, int16_t cx, int16_t cy, int16_t r, gfx_color_t color);
+// Draw the set pixels of a bitmap with the given color; clear pixels are
+// left untouched
+void gfx_blit(const gfx_fb_t * p_fb, int16_t x, int16_t y, const gfx_bitmap_t * p_bitmap, gfx_color_t color);
+
+#endif /* GFX_H__ */
@@ -0,0 +1,214 @@
+/*
+ * On-target benchmark of the drawing primitives.
+ *
+ * Results are in primitives per second at F_CPU, drawing into external
+ * SRAM, so they include the XMEM access cost the animations will pay.
+ */
+
+#include "gfx_bench.h"
+#include "gfx.h"
+#include "oled.h"
+#include "oled_console.h"
+#include "text.h"
+#include "ping_pong.h"
+#include "profiler.h"
+#include "xmem.h"
+
+#define M_BENCH_WIDTH  (128)
+#define M_BENCH_HEIGHT (40)
+#define M_BENCH_RUNS   (32)
+
+#define M_CONSOLE_BENCH_LINES (200)
+
+#define M_TEXT_BENCH_PAGE (7)
+// Long enough to be clipped at the right edge with every font
+static const char m_text_bench_str[] PROGMEM = "The quick brown fox jumps";
+
+typedef enum
+{
+    M_OP_CLEAR = 0,
+    M_OP_PIXEL,
+    M_OP_HLINE,
+    M_OP_VLINE,
+    M_OP_LINE,
+    M_OP_RECT,
+    M_OP_FILL_RECT,
+    M_OP_CIRCLE,
+    M_OP_FILL_CIRCLE,
+    M_OP_BLIT,
+    M_OP_COUNT
+} m_op_t;
+
+static const char m_op_names[M_OP_COUNT][16] PROGMEM = {
+    [M_OP_CLEAR]       = "clear",
+    [M_OP_PIXEL]       = "pixel",
+    [M_OP_HLINE]       = "hline 100",
+    [M_OP_VLINE]       = "vline 30",
+    [M_OP_LINE]        = "line 100x30",
+    [M_OP_RECT]        = "rect 60x30",
+    [M_OP_FILL_RECT]   = "fill_rect 60x30",
+    [M_OP_CIRCLE]      = "circle r15",
+    [M_OP_FILL_CIRCLE] = "fill_circle r15",
+    [M_OP_BLIT]        = "blit 16x16",
+};
+
+// 16x16 ball sprite, page-organized
+static const uint8_t m_ball_data[32] = {
+    0xE0, 0xF8, 0xFC, 0xFE, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFE, 0xFC, 0xF8, 0xE0,
+    0x07, 0x1F, 0x3F, 0x7F, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x7F, 0x3F, 0x1F, 0x07,
+};
+static const gfx_bitmap_t m_ball = { .p_data = m_ball_data, .width = 16, .height = 16 };
+
+static void m_op_run(const gfx_fb_t * p_fb, m_op_t op, uint8_t i)
+{
+    // Vary the position so unaligned page offsets are covered
+    int16_t x = i & 0x1F;
+    int16_t y = i & 0x07;
+
+    switch (op)
+    {
+        case M_OP_CLEAR:
+            gfx_clear(p_fb, GFX_COLOR_OFF);
+            break;
+        case M_OP_PIXEL:
+            gfx_pixel(p_fb, x, y, GFX_COLOR_INVERT);
+            break;
+        case M_OP_HLINE:
+            gfx_hline(p_fb, x, y, 100, GFX_COLOR_INVERT);
+            break;
+        case M_OP_VLINE:
+            gfx_vline(p_fb, x, y, 30, GFX_COLOR_INVERT);
+            break;
+        case M_OP_LINE:
+            gfx_line(p_fb, x, y, x + 99, y + 29, GFX_COLOR_INVERT);
+            break;
+        case M_OP_RECT:
+            gfx_rect(p_fb, x, y, 60, 30, GFX_COLOR_INVERT);
+            break;
+        case M_OP_FILL_RECT:
+            gfx_fill_rect(p_fb, x, y, 60, 30, GFX_COLOR_INVERT);
+            break;
+        case M_OP_CIRCLE:
+            gfx_circle(p_fb, x + 20, y + 16, 15, GFX_COLOR_INVERT);
+            break;
+        case M_OP_FILL_CIRCLE:
+            gfx_fill_circle(p_fb, x + 20, y + 16, 15, GFX_COLOR_INVERT);
+            break;
+        case M_OP_BLIT:
+            gfx_blit(p_fb, x, y, &m_ball, GFX_COLOR_INVERT);
+            break;
+        default:
+            break;
+    }
+}
+
+// Borrow a framebuffer from the external SRAM heap, freed with xmem_release()
+static bool m_bench_fb_alloc(gfx_fb_t * p_fb)
+{
+    uint8_t * p_buf = xmem_alloc(GFX_FB_SIZE(M_BENCH_WIDTH, M_BENCH_HEIGHT), 1);
+
+    if (!p_buf)
+    {
+        printf_P(PSTR("bench: no room for a framebuffer in external SRAM\n"));
+        return false;
+    }
+
+    return gfx_fb_init(p_fb, p_buf, M_BENCH_WIDTH, M_BENCH_HEIGHT);
+}
+
+void gfx_bench_run(void)
+{
+    gfx_fb_t fb;
+    uint16_t mark = xmem_mark();
+
+    if (!m_bench_fb_alloc(&fb))
+    {
+        return;
+    }
+
+    printf_P(PSTR("gfx bench, %ux%u framebuffer in external SRAM\n"), M_BENCH_WIDTH, M_BENCH_HEIGHT);
+
+    for (uint8_t op = 0; op < M_OP_COUNT; op++)
+    {
+        gfx_clear(&fb, GFX_COLOR_OFF);
+
+        uint32_t start = profiler_cycles_get();
+        for (uint8_t i = 0; i < M_BENCH_RUNS; i++)
+        {
+            m_op_run(&fb, op, i);
+        }
+        uint32_t cycles = (profiler_cycles_get() - start) / M_BENCH_RUNS;
+
+        printf_P(PSTR("  %-16S %7lu cycles %7lu /s\n"), m_op_names[op],
+               (unsigned long) cycles,
+               (unsigned long) (cycles ? F_CPU / cycles : 0));
+    }
+
+    xmem_release(mark);
+}
+
+// `p_name_P` is in program memory
+static void m_text_result_print(const char * p_name_P, uint8_t font, uint32_t cycles)
+{
+    uint32_t glyphs = (uint32_t) M_BENCH_RUNS * (sizeof(m_text_bench_str) - 1);
+
+    printf_P(PSTR("  %-6S font %u %7lu glyphs/s\n"), p_name_P, font,
+           (unsigned long) (cycles ? (F_CPU * glyphs) / cycles : 0));
+}
+
+void gfx_bench_text_run(void)
+{
+    gfx_fb_t fb;
+    char str[sizeof(m_text_bench_str)];
+    uint16_t mark = xmem_mark();
+
+    if (!m_bench_fb_alloc(&fb))
+    {
+        return;
+    }
+    strcpy_P(str, m_text_bench_str);
+
+    printf_P(PSTR("text bench, %u glyphs per run\n"), (unsigned) (sizeof(m_text_bench_str) - 1));
+
+    for (uint8_t font = 0; font < TEXT_FONT_COUNT; font++)
+    {
+        gfx_clear(&fb, GFX_COLOR_OFF);
+
+        uint32_t start = profiler_cycles_get();
+        for (uint8_t i = 0; i < M_BENCH_RUNS; i++)
+        {
+            (void) text_fb_draw(&fb, NULL, i & 0x07, i & 0x07, font, str, GFX_COLOR_INVERT);
+        }
+        m_text_result_print(PSTR("fb"), font, profiler_cycles_get() - start);
+
+        start = profiler_cycles_get();
+        for (uint8_t i = 0; i < M_BENCH_RUNS; i++)
+        {
+            (void) text_oled_draw(M_TEXT_BENCH_PAGE, 0, 0, 128, font, str, i & 1);
+        }
+        m_text_result_print(PSTR("oled"), font, profiler_cycles_get() - start);
+    }
+
+    oled_clear_line(M_TEXT_BENCH_PAGE);
+    xmem_release(mark);
+}
+
+void gfx_bench_console_run(void)
+{
+    if (!oled_console_shown())
+    {
+        printf_P(PSTR("console bench: open the console screen first\n"));
+        return;
+    }
+
+    uint32_t start = profiler_cycles_get();
+    for (uint16_t i = 0; i < M_CONSOLE_BENCH_LINES; i++)
+    {
+        // Full-width lines, the worst case
+        oled_console_write("console bench 0123456789 ABCDEF\n");
+    }
+    uint32_t cycles = profiler_cycles_get() - start;
+
+    printf_P(PSTR("console bench: %lu lines/s\n"),
+           (unsigned long) (cycles ? (F_CPU * M_CONSOLE_BENCH_LINES) / cycles : 0));
+}
@@ -0,0 +1,16 @@
+/*
+ * On-target benchmark of the drawing primitives.
+ */
+#ifndef GFX_BENCH_H__
+#define GFX_BENCH_H__
+
+// Time every primitive on a framebuffer in external SRAM and print the
+// results to stdout. Overwrites the framebuffer area.
+void gfx_bench_run(void);
+// Glyphs per second of every font, into the framebuffer and straight to the
+// display. Draws over the bottom page of the display and clears it after.
+void gfx_bench_text_run(void);
+// Lines per second of the OLED console. Needs the console screen open.
+void gfx_bench_console_run(void);
+
+#endif /* GFX_BENCH_H__ */
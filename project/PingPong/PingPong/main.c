@@ -6,20 +6,51 @@
 
 #include "ping_pong.h"
 #include "rs232.h"
+#include "ext_peripherals.h"
 #include "sram_test.h"
 #include "controls.h"
 #include "ui.h"
 #include "CAN.h"
-#include <util/delay.h>
+#include "can_stats.h"
+#include "profiler.h"
+#include "cpu_load.h"
+#include "timer.h"
+#include "sched.h"
+#include "event_queue.h"
+#include "gfx_bench.h"
+#include "anim.h"
+#include "oled_console.h"
+#include "xmem.h"
+#include "xmem_timing.h"
+#include <avr/interrupt.h>
 
 #define M_JOYSTICK_DATA_TXBUF_NO (0)
 #define M_SLIDERS_DATA_TXBUF_NO  (1)
+#define M_BUTTONS_DATA_TXBUF_NO  (2)
+#define M_GAME_CMD_TXBUF_NO      (1) // shared with the sliders, which are resent anyway
+#define M_CAN_STATS_TXBUF_NO     (1) // likewise
 
 // initialize external memory mapping
 // Sets the SRAM enable bit in the MCU control register
 // and masks the top 4 bits of the addressing (reserved for JTAG)
 #define ENABLE_SRAM() {MCUCR |= _BV(SRE); SFIOR |= _BV(XMM2);}
 
+#define M_CPU_LOAD_WINDOW_MS (1000)
+
+// Task periods
+#define M_UART_DRAIN_PERIOD_MS (2)   // 9600 baud moves about two characters per 2 ms
+#define M_ADC_SAMPLE_PERIOD_MS (20)
+#define M_CAN_TX_PERIOD_MS     (50)
+#define M_UI_PERIOD_MS         (50)  // also released by every event; paces the game screen
+#define M_SRAM_TEST_PERIOD_MS  (100)
+
+// Background SRAM test: one block per run, the whole 2 KB every 12.8 s
+#define M_SRAM_TEST_STEP_BYTES (SRAM_TEST_BLOCK_MAX)
+
+// Holding the joystick repeats the menu command after a delay
+#define M_JOYSTICK_REPEAT_DELAY_MS (450)
+#define M_JOYSTICK_REPEAT_MS       (150)
+
 #define M_JOYSTICK_DATA (true)
 #define M_SLIDERS_DATA  (false)
 
@@ -27,6 +58,36 @@ static joystick_direction_t m_x_dir;
 static joystick_direction_t m_y_dir;
 static sliders_position_t m_sliders;
 
+static uint32_t m_joystick_repeat_ms;
+
+// Button state and press counts as last sent. A press that could not be
+// sent yet stays pending and is retried on the next poll.
+static uint8_t m_buttons_mask;
+static uint8_t m_right_press_count;
+static uint8_t m_left_press_count;
+static bool m_buttons_pending;
+static uint32_t m_buttons_edge_cycles;
+
+static uint8_t m_ui_task_id;
+
+// Latest game state frame from Node2, overwritten by every new frame
+static game_frame_t m_game_frame_rx;
+static volatile bool m_game_frame_pending;
+
+// Game command waiting for a free TX buffer
+static game_cmd_t m_game_cmd;
+static bool m_game_cmd_pending;
+
+// Statistics query to Node2 waiting for a free TX buffer
+static uint8_t m_can_stats_query_index;
+static bool m_can_stats_query_pending;
+static uint8_t m_can_stats_remote_id_count;
+
+// Background test of the external SRAM, one block per task run
+static sram_test_t m_sram_test;
+static uint16_t m_sram_faults_reported;
+static uint16_t m_sram_address_faults_reported;
+
 static void m_print_can_msg(const can_id_t * id, const can_data_t * data)
 {
 	assert(id);
@@ -39,24 +100,40 @@ static void m_print_can_msg(const can_id_t * id, const can_data_t * data)
 			for (uint8_t i = 0; i < data->len; i++)
 			{
 				char *data_str_start = &data_str[2 * i + i];
-				snprintf(data_str_start, 3, "%02X", data->data[i]);
+				snprintf_P(data_str_start, 3, PSTR("%02X"), data->data[i]);
 				data_str_start[2] = ' ';
 			}
 			data_str[3 * data->len - 1] = '\0';
 		}
 		// For some reason printing the whole thing in one does not work
 		// (maybe printf buffer size or something)
-		printf("[D] {ext: %u, id: %d, len: %u, data: [", (int)id->extended, (int)id->value, (int)data->len);
-		printf("%s", &data_str[0]);
-		printf("] }\n");
+		printf_P(PSTR("[D] {ext: %u, id: %d, len: %u, data: ["), (int)id->extended, (int)id->value, (int)data->len);
+		printf_P(PSTR("%s"), &data_str[0]);
+		printf_P(PSTR("] }\n"));
 	}
 	else
 	{
-		printf("[R] {ext: %u, id: %d }\n", (int)id->extended, (int)id->value);
+		printf_P(PSTR("[R] {ext: %u, id: %d }\n"), (int)id->extended, (int)id->value);
 	}
 }
 
-// Fetch current joystick information and send it as as can message
+// Log a received message on the OLED console, one line per message
+static void m_console_log_can_msg(const can_id_t * id, const can_data_t * data)
+{
+	char line[OLED_CONSOLE_LINE_LEN + 2];
+	uint8_t len = snprintf_P(line, sizeof(line), PSTR("RX %03X"), (unsigned)id->value);
+
+	for (uint8_t i = 0; i < data->len && len + 3 < OLED_CONSOLE_LINE_LEN; i++)
+	{
+		len += snprintf_P(&line[len], sizeof(line) - len, PSTR(" %02X"), data->data[i]);
+	}
+	line[len++] = '\n';
+	line[len] = '\0';
+
+	oled_console_write(line);
+}
+
+// Send the latest sampled joystick or slider information as a can message
 static void m_send_controls_can_msg(bool data_type)
 {
 	if (data_type == M_JOYSTICK_DATA)
@@ -65,7 +142,6 @@ static void m_send_controls_can_msg(bool data_type)
 		can_id_t joystick_data_id;
 		uint8_t joystick_msg_data[2]; // one byte per direction
 
-		get_joystick_dir(&m_x_dir, &m_y_dir);
 		joystick_msg_data[0] = (uint8_t)m_x_dir;
 		joystick_msg_data[1] = (uint8_t)m_y_dir;
 		joystick_data.len = sizeof(joystick_msg_data);
@@ -82,7 +158,6 @@ static void m_send_controls_can_msg(bool data_type)
 		can_id_t sliders_data_id;
 		uint8_t sliders_msg_data[2]; // one byte per slider
 
-		get_sliders_pos(&m_sliders);
 		sliders_msg_data[0]  = (uint8_t)m_sliders.right_slider_pos;
 		sliders_msg_data[1]  = (uint8_t)m_sliders.left_slider_pos;
 		sliders_data.len = sizeof(sliders_msg_data);
@@ -99,25 +174,514 @@ static void m_send_controls_can_msg(bool data_type)
 	}
 }
 
-// Handle received CAN messages
+// Send the button state and press counts. Returns false if the TX buffer is busy.
+static bool m_send_buttons_can_msg(void)
+{
+	uint8_t buttons_msg_data[3] = { m_buttons_mask, m_right_press_count, m_left_press_count };
+	can_data_t buttons_data = { .len = sizeof(buttons_msg_data), .data = buttons_msg_data };
+	can_id_t buttons_data_id = { .value = CAN_BUTTON_MSG_ID, .extended = false };
+
+	// Use TX buffer 2 to send button information
+	return can_data_send(M_BUTTONS_DATA_TXBUF_NO, &buttons_data_id, &buttons_data) == CAN_SUCCESS;
+}
+
+// Handle received CAN messages. Runs in interrupt context, so only queue them.
 static void m_handle_can_rx(uint8_t rx_buf_no, const can_msg_rx_t *msg)
 {
-	printf("RX: ");
-	m_print_can_msg(&msg->id, msg->type == CAN_MSG_TYPE_DATA ? &msg->data : NULL);
+	event_t event = { .type = EVENT_CAN_RX };
+
+	if (msg->type != CAN_MSG_TYPE_DATA || msg->id.extended)
+	{
+		return;
+	}
+
+	// Game state arrives at 50 Hz; keep only the latest instead of queueing
+	if (msg->id.value == CAN_GAME_STATE_MSG_ID)
+	{
+		if (game_frame_decode(msg->data.data, msg->data.len, &m_game_frame_rx))
+		{
+			m_game_frame_pending = true;
+		}
+		return;
+	}
+
+	// The DLC field reaches 15, but a frame never carries more than 8 bytes
+	event.can.id = (uint16_t)msg->id.value;
+	event.can.len = msg->data.len < sizeof(event.can.data) ? msg->data.len : sizeof(event.can.data);
+	if (msg->data.data != NULL)
+	{
+		memcpy(event.can.data, msg->data.data, event.can.len);
+	}
+	else
+	{
+		event.can.len = 0;
+	}
+
+	if (event_queue_put(&event))
+	{
+		sched_task_trigger(m_ui_task_id);
+	}
 }
 
 static void m_handle_can_tx(uint8_t tx_buf_no)
 {
-	_delay_ms(50);
+	// Transmission is paced by the CAN TX task
+}
+
+static const char m_can_state_names[][8] PROGMEM = {
+	[CAN_ERROR_STATE_ACTIVE]  = "active",
+	[CAN_ERROR_STATE_WARNING] = "warning",
+	[CAN_ERROR_STATE_PASSIVE] = "passive",
+	[CAN_ERROR_STATE_BUS_OFF] = "bus-off",
+};
+
+static void m_print_can_errors(const can_error_stats_t * stats)
+{
+	printf_P(PSTR("CAN %S: TEC %u REC %u, %u RX overflows, %u bus errors, bus-off %u (recovered %u, backoff %u ms)\n"),
+	         m_can_state_names[stats->state], stats->counters.tec, stats->counters.rec,
+	         stats->rx_overflow_count, stats->bus_error_count,
+	         stats->bus_off_count, stats->recovery_count, stats->backoff_ms);
+}
+
+static void m_print_can_stats(void)
+{
+	can_stats_summary_t summary;
+	can_stats_summary_get(&summary);
+
+	printf_P(PSTR("CAN bus load %u.%u%% (peak %u.%u%%), %u IDs, %u untracked frames\n"),
+	         summary.load_permille / 10, summary.load_permille % 10,
+	         summary.peak_load_permille / 10, summary.peak_load_permille % 10,
+	         summary.id_count, summary.untracked_count);
+
+	can_stats_entry_t entry;
+	for (uint8_t i = 0; can_stats_entry_get(i, &entry); i++)
+	{
+		printf_P(PSTR("  0x%03X: rx %u tx %u, %lu bytes, gap %u..%u ms\n"),
+		         entry.id, entry.rx_count, entry.tx_count, (unsigned long) entry.byte_count,
+		         entry.rx_count + entry.tx_count > 1 ? entry.min_gap_ms : 0, entry.max_gap_ms);
+	}
+}
+
+// Answer a statistics query from Node2
+static void m_can_stats_reply(const uint8_t * query)
+{
+	uint8_t reply_data[CAN_STATS_REPLY_LEN];
+	can_data_t reply = { .len = sizeof(reply_data), .data = reply_data };
+	can_id_t reply_id = { .value = CAN_STATS_REPLY_MSG_ID, .extended = false };
+
+	if (can_stats_reply_encode(query[0], reply_data))
+	{
+		(void) can_data_send(M_CAN_STATS_TXBUF_NO, &reply_id, &reply);
+	}
+}
+
+// Print a statistics reply from Node2 and query the next entry
+static void m_can_stats_reply_handle(const uint8_t * data)
+{
+	if (data[0] == CAN_STATS_INDEX_SUMMARY)
+	{
+		printf_P(PSTR("Node2 CAN bus load %u.%u%% (peak %u.%u%%), %u IDs, %u untracked frames\n"),
+		         (data[2] | (data[3] << 8)) / 10, (data[2] | (data[3] << 8)) % 10,
+		         (data[4] | (data[5] << 8)) / 10, (data[4] | (data[5] << 8)) % 10,
+		         data[1], data[6] | (data[7] << 8));
+		m_can_stats_remote_id_count = data[1];
+		m_can_stats_query_index = 0;
+		m_can_stats_query_pending = m_can_stats_remote_id_count > 0;
+	}
+	else
+	{
+		printf_P(PSTR("  0x%03X: %u frames, gap %u..%u ms\n"),
+		         data[1] | (data[2] << 8), data[3] | (data[4] << 8),
+		         data[7], data[5] | (data[6] << 8));
+		m_can_stats_query_index = data[0] + 1;
+		m_can_stats_query_pending = m_can_stats_query_index < m_can_stats_remote_id_count;
+	}
+}
+
+static void m_handle_can_error(can_error_state_t state, const can_error_stats_t * stats)
+{
+	(void) state;
+	m_print_can_errors(stats);
+}
+
+static void m_handle_uart_rx(char received)
+{
+	event_t event = { .type = EVENT_UART_RX, .uart_char = received };
+
+	if (event_queue_put(&event))
+	{
+		sched_task_trigger(m_ui_task_id);
+	}
+}
+
+static void m_print_anim_stats(void)
+{
+	anim_stats_t stats;
+	anim_stats_get(&stats);
+
+	printf_P(PSTR("Animation: %u.%u fps, %lu frames, %lu dropped, %u bytes/frame, worst frame %lu us\n"),
+	       stats.fps_x10 / 10, stats.fps_x10 % 10,
+	       (unsigned long) stats.frame_count,
+	       (unsigned long) stats.dropped_count,
+	       stats.flush_bytes_avg,
+	       (unsigned long) stats.worst_frame_us);
+}
+
+static void m_print_xmem_stats(void)
+{
+	xmem_stats_t stats;
+	xmem_arena_stats_get(xmem_heap_get(), &stats);
+
+	printf_P(PSTR("XMEM heap: %u/%u bytes used, peak %u, %u failed allocations\n"),
+	         stats.used, stats.capacity, stats.peak, stats.fail_count);
+}
+
+static void m_print_sram_test(void)
+{
+	const sram_test_result_t *p_result = &m_sram_test.result;
+
+	printf_P(PSTR("SRAM test: %u passes, %lu bytes at %lu bytes/s, %u faults"),
+	         p_result->pass_count, (unsigned long) p_result->bytes_tested,
+	         (unsigned long) p_result->bytes_per_s, p_result->fault_count);
+	for (uint8_t i = 0; i < p_result->fault_count && i < SRAM_TEST_MAX_FAULTS; i++)
+	{
+		printf_P(PSTR(" 0x%04X"), p_result->fault_addr[i]);
+	}
+	printf_P(PSTR(", %u address faults"), p_result->address_fault_count);
+	if (p_result->address_fault_count)
+	{
+		printf_P(PSTR(", last at 0x%04X"), p_result->address_fault_addr);
+	}
+	printf_P(PSTR("\n"));
+}
+
+static void m_print_cpu_load(void)
+{
+	cpu_load_stats_t stats;
+	cpu_load_get(&stats);
+
+	printf_P(PSTR("CPU load: %u.%u%% (peak %u.%u%%), worst loop %lu us, worst busy %lu us\n"),
+	       stats.load_permille / 10, stats.load_permille % 10,
+	       stats.peak_load_permille / 10, stats.peak_load_permille % 10,
+	       (unsigned long) stats.worst_loop_period_us,
+	       (unsigned long) stats.worst_busy_us);
+}
+
+// Handle single-character commands received over the UART
+static void m_handle_uart_cmd(char cmd)
+{
+	switch (cmd)
+	{
+		case 'p':
+			profiler_export();
+			break;
+		case 'r':
+			profiler_reset();
+			break;
+		case 'l':
+			m_print_cpu_load();
+			break;
+		case 'g':
+			gfx_bench_run();
+			break;
+		case 't':
+			gfx_bench_text_run();
+			break;
+		case 'o':
+			gfx_bench_console_run();
+			break;
+		case 'm':
+			m_print_xmem_stats();
+			break;
+		case 'w':
+			xmem_timing_report();
+			break;
+		case 'a':
+			m_print_anim_stats();
+			break;
+		case 's':
+			m_print_sram_test();
+			break;
+		case 'b':
+			m_print_can_stats();
+			break;
+		case 'q':
+			m_can_stats_query_index = CAN_STATS_INDEX_SUMMARY;
+			m_can_stats_query_pending = true;
+			break;
+		case 'e':
+		{
+			can_error_stats_t stats;
+			can_error_stats_get(&stats);
+			m_print_can_errors(&stats);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+static ui_cmd_t m_joystick_to_ui_cmd(joystick_direction_t x_dir, joystick_direction_t y_dir)
+{
+	if (x_dir == NEUTRAL && y_dir == UP)
+	{
+		return UI_SELECT_DOWN;
+	}
+	else if (x_dir == NEUTRAL && y_dir == DOWN)
+	{
+		return UI_SELECT_UP;
+	}
+	else if (x_dir == RIGHT && y_dir == NEUTRAL)
+	{
+		return UI_ENTER_SUBMENU;
+	}
+	else if (x_dir == LEFT && y_dir == NEUTRAL)
+	{
+		return UI_EXIT;
+	}
+
+	return UI_DO_NOTHING;
+}
+
+static void m_task_uart_drain(void)
+{
+	uart_drain();
+}
+
+// Poll the buttons and send a frame as soon as one is pressed or released
+static void m_task_buttons(void)
+{
+	buttons_state_t buttons;
+	get_buttons_state(&buttons);
+
+	uint8_t mask = (buttons.right_pressed ? CAN_BUTTON_RIGHT_MASK : 0) |
+	               (buttons.left_pressed ? CAN_BUTTON_LEFT_MASK : 0);
+	uint8_t pressed = mask & ~m_buttons_mask;
+
+	if (mask != m_buttons_mask)
+	{
+		if (pressed & CAN_BUTTON_RIGHT_MASK)
+		{
+			m_right_press_count++;
+		}
+		if (pressed & CAN_BUTTON_LEFT_MASK)
+		{
+			m_left_press_count++;
+		}
+		if (!m_buttons_pending)
+		{
+			m_buttons_edge_cycles = profiler_cycles_get();
+		}
+		m_buttons_mask = mask;
+		m_buttons_pending = true;
+	}
+
+	if (m_buttons_pending && m_send_buttons_can_msg())
+	{
+		// Trace point: edge seen to frame queued in the CAN controller
+		profiler_record(PROFILER_PROBE_BUTTON_TX, profiler_cycles_get() - m_buttons_edge_cycles);
+		m_buttons_pending = false;
+	}
+}
+
+// Sample the controls and post an event when the joystick moves
+static void m_task_adc_sample(void)
+{
+	joystick_direction_t x_dir;
+	joystick_direction_t y_dir;
+	uint32_t now = timer_ms_get();
+	bool post = false;
+
+	get_joystick_dir(&x_dir, &y_dir);
+	get_sliders_pos(&m_sliders);
+
+	if (x_dir != m_x_dir || y_dir != m_y_dir)
+	{
+		m_x_dir = x_dir;
+		m_y_dir = y_dir;
+		m_joystick_repeat_ms = now + M_JOYSTICK_REPEAT_DELAY_MS;
+		post = true;
+	}
+	else if ((x_dir != NEUTRAL || y_dir != NEUTRAL) &&
+	         (int32_t)(now - m_joystick_repeat_ms) >= 0)
+	{
+		m_joystick_repeat_ms += M_JOYSTICK_REPEAT_MS;
+		post = true;
+	}
+
+	if (post)
+	{
+		event_t event = {
+			.type = EVENT_JOYSTICK,
+			.joystick = { .x_dir = x_dir, .y_dir = y_dir }
+		};
+
+		if (event_queue_put(&event))
+		{
+			sched_task_trigger(m_ui_task_id);
+		}
+	}
+}
+
+// The user started or left the game screen
+static void m_handle_game_cmd(game_cmd_t cmd)
+{
+	m_game_cmd = cmd;
+	m_game_cmd_pending = true;
+}
+
+static void m_send_game_cmd(void)
+{
+	uint8_t cmd_msg_data[GAME_CMD_FRAME_LEN] = { (uint8_t) m_game_cmd };
+	can_data_t cmd_data = { .len = sizeof(cmd_msg_data), .data = cmd_msg_data };
+	can_id_t cmd_id = { .value = CAN_GAME_CMD_MSG_ID, .extended = false };
+
+	if (can_data_send(M_GAME_CMD_TXBUF_NO, &cmd_id, &cmd_data) == CAN_SUCCESS)
+	{
+		m_game_cmd_pending = false;
+	}
+}
+
+static void m_send_can_stats_query(void)
+{
+	uint8_t query_data[CAN_STATS_QUERY_LEN] = { m_can_stats_query_index };
+	can_data_t query = { .len = sizeof(query_data), .data = query_data };
+	can_id_t query_id = { .value = CAN_STATS_QUERY_MSG_ID, .extended = false };
+
+	if (can_data_send(M_CAN_STATS_TXBUF_NO, &query_id, &query) == CAN_SUCCESS)
+	{
+		m_can_stats_query_pending = false;
+	}
+}
+
+static void m_task_can_tx(void)
+{
+	uint32_t now = timer_ms_get();
+
+	can_error_poll(now);
+	can_stats_tick(now);
+
+	if (m_game_cmd_pending)
+	{
+		m_send_game_cmd();
+	}
+	else if (m_can_stats_query_pending)
+	{
+		m_send_can_stats_query();
+	}
+
+	m_send_controls_can_msg(M_JOYSTICK_DATA);
+	m_send_controls_can_msg(M_SLIDERS_DATA);
 
-	if (tx_buf_no == M_JOYSTICK_DATA_TXBUF_NO)
+	// Repeat the button state so the receiver catches up on lost frames
+	if (!m_buttons_pending)
 	{
-		m_send_controls_can_msg(M_SLIDERS_DATA);
+		(void) m_send_buttons_can_msg();
+	}
+}
+
+static void m_task_sram_test(void)
+{
+	if (!sram_test_step(&m_sram_test, M_SRAM_TEST_STEP_BYTES))
+	{
+		return;
+	}
+	if (m_sram_test.result.fault_count > m_sram_faults_reported)
+	{
+		m_sram_faults_reported = m_sram_test.result.fault_count;
+		printf_P(PSTR("SRAM: %u faulty blocks, first at 0x%04X\n"),
+		         m_sram_test.result.fault_count, m_sram_test.result.fault_addr[0]);
+	}
+	if (m_sram_test.result.address_fault_count > m_sram_address_faults_reported)
+	{
+		m_sram_address_faults_reported = m_sram_test.result.address_fault_count;
+		printf_P(PSTR("SRAM: address fault at 0x%04X\n"), m_sram_test.result.address_fault_addr);
+	}
+}
+
+// Dispatch queued events to the user interface
+static void m_task_ui(void)
+{
+	event_t event;
+
+	while (event_queue_get(&event))
+	{
+		switch (event.type)
+		{
+			case EVENT_JOYSTICK:
+			{
+				ui_cmd_t ui_cmd = m_joystick_to_ui_cmd(event.joystick.x_dir, event.joystick.y_dir);
+				if (ui_cmd != UI_DO_NOTHING)
+				{
+					ui_issue_cmd(ui_cmd);
+				}
+				break;
+			}
+			case EVENT_CAN_RX:
+			{
+				if (event.can.id == CAN_STATS_QUERY_MSG_ID && event.can.len == CAN_STATS_QUERY_LEN)
+				{
+					m_can_stats_reply(event.can.data);
+					break;
+				}
+				if (event.can.id == CAN_STATS_REPLY_MSG_ID && event.can.len == CAN_STATS_REPLY_LEN)
+				{
+					m_can_stats_reply_handle(event.can.data);
+					break;
+				}
+
+				can_id_t id = { .value = event.can.id, .extended = false };
+				can_data_t data = { .len = event.can.len, .data = event.can.data };
+				printf_P(PSTR("RX: "));
+				m_print_can_msg(&id, &data);
+				m_console_log_can_msg(&id, &data);
+				break;
+			}
+			case EVENT_UART_RX:
+				m_handle_uart_cmd(event.uart_char);
+				break;
+			default:
+				break;
+		}
 	}
-	else if (tx_buf_no == M_SLIDERS_DATA_TXBUF_NO)
+
+	if (m_game_frame_pending)
 	{
-		m_send_controls_can_msg(M_JOYSTICK_DATA);
+		game_frame_t frame;
+
+		cli();
+		frame = m_game_frame_rx;
+		m_game_frame_pending = false;
+		sei();
+
+		ui_game_frame_set(&frame);
 	}
+
+	// Redraw rate is capped by the UI itself
+	ui_game_refresh();
+}
+
+static void m_init_sched(void)
+{
+	sched_init();
+
+	// Shortest period first: registration order is priority order
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "uart", .fn = m_task_uart_drain, .period_ms = M_UART_DRAIN_PERIOD_MS });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "buttons", .fn = m_task_buttons, .period_ms = CAN_BUTTON_POLL_PERIOD_MS,
+		.deadline_ms = CAN_BUTTON_TASK_DEADLINE_MS, .offset_ms = 1 });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "adc", .fn = m_task_adc_sample, .period_ms = M_ADC_SAMPLE_PERIOD_MS, .offset_ms = 2 });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "anim", .fn = anim_frame, .period_ms = ANIM_FRAME_MS, .offset_ms = 4 });
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "can_tx", .fn = m_task_can_tx, .period_ms = M_CAN_TX_PERIOD_MS, .offset_ms = 3 });
+	m_ui_task_id = sched_task_add(&(sched_task_cfg_t){
+		.name = "ui", .fn = m_task_ui, .period_ms = M_UI_PERIOD_MS, .offset_ms = 5 });
+	assert(m_ui_task_id != SCHED_TASK_INVALID);
+	(void) sched_task_add(&(sched_task_cfg_t){
+		.name = "sram_test", .fn = m_task_sram_test, .period_ms = M_SRAM_TEST_PERIOD_MS, .offset_ms = 7 });
 }
 
 static uint8_t m_init_can()
@@ -125,17 +689,10 @@ static uint8_t m_init_can()
 	can_init_t init = {
 		.rx_handler = m_handle_can_rx,
 		.tx_handler = m_handle_can_tx,
+		.error_handler = m_handle_can_error,
 		.buf = {
 			.rx_buf_count = 1,
-			.tx_buf_count = 2
-		},
-		// Same as the example in mcp2515 5.3, i.e. 125kHz CAN bus
-		.bit = {
-			.baudrate = 2000000,
-			.sync_jump_len = 1,
-			.prop_seg_len = 2,
-			.phase_1_len = 7,
-			.phase_2_len = 6
+			.tx_buf_count = 3
 		}
 	};
 	return can_init(&init);
@@ -143,47 +700,44 @@ static uint8_t m_init_can()
 
 int main(void)
 {
-	ENABLE_SRAM();
-	assert(uart_init());
-	assert(joystick_init());
-	assert(ui_init());
-	assert(m_init_can() == CAN_SUCCESS);
+	// Init results are kept out of assert(), which NDEBUG compiles out
+	bool ok;
 
-	m_send_controls_can_msg(M_JOYSTICK_DATA);
+	ENABLE_SRAM();
+	// Before anything is stored in external memory, although tuning keeps the contents
+	(void) xmem_timing_tune();
+	ok = xmem_init();
+	assert(ok);
+	ok = sram_test_init(&m_sram_test, 0, EXT_SRAM_MEM_SIZE);
+	assert(ok);
+	ok = profiler_init();
+	assert(ok);
+	ok = timer_init();
+	assert(ok);
+	ok = uart_init();
+	assert(ok);
+	ok = joystick_init();
+	assert(ok);
+	ok = ui_init();
+	assert(ok);
+	event_queue_init();
+	ok = m_init_can() == CAN_SUCCESS;
+	assert(ok);
 
 	// direct printf to the uart
 	uart_config_streams();
+	uart_rx_handler_set(m_handle_uart_rx);
+	ui_game_cmd_handler_set(m_handle_game_cmd);
 
-	// Navigate user interface
-	ui_cmd_t ui_cmd;
+	// Draw the initial menu
+	ui_issue_cmd(UI_DO_NOTHING);
 
+	cpu_load_init(M_CPU_LOAD_WINDOW_MS);
+	m_init_sched();
 
-	while(1)
-	{
-		get_joystick_dir(&m_x_dir, &m_y_dir);
-		//printf("Joystick: x-axis dir=%s, y-axis dir=%s\n", joystick_dir_to_str(m_x_dir), joystick_dir_to_str(m_y_dir));
-
-		get_sliders_pos(&m_sliders);
-		//printf("left slider=%d%%, right slider=%d%%\n", (m_sliders.left_slider_pos*100)/0xFF, (m_sliders.right_slider_pos*100)/0xFF);
-		//printf("\n");
+	sei();
 
-		_delay_ms(150); // the CPU is too fast
+	(void) ok;
 
-		ui_cmd = UI_DO_NOTHING;
-
-		if (m_x_dir == NEUTRAL && m_y_dir == UP)
-		{
-			ui_cmd = UI_SELECT_DOWN;
-		}
-		else if (m_x_dir == NEUTRAL && m_y_dir == DOWN)
-		{
-			ui_cmd = UI_SELECT_UP;
-		}
-		else if (m_x_dir == RIGHT && m_y_dir == NEUTRAL)
-		{
-			ui_cmd = UI_ENTER_SUBMENU;
-		}
-
-		ui_issue_cmd(ui_cmd);
-	}
+	sched_run();
 }
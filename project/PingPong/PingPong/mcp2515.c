@@ -1,6 +1,7 @@
 #include "mcp2515_defs.h"
 #include "mcp2515.h"
 #include "spi.h"
+#include "profiler.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
@@ -10,9 +11,13 @@ static mcp2515_evt_handler_t m_evt_handler = NULL;
 
 ISR(INT1_vect)
 {
+    uint32_t probe_start = profiler_probe_begin();
+
     // TODO: should this handler do more/less ?
     uint8_t code = mcp2515_read(MCP_CANINTF);
     m_evt_handler(code);
+
+    profiler_probe_end(PROFILER_PROBE_CAN_ISR, probe_start);
 }
 
 bool mcp2515_init(const mcp2515_init_t * init_params)
@@ -47,7 +52,8 @@ bool mcp2515_init(const mcp2515_init_t * init_params)
     // Enable interrupt generation on the MCP2515
     mcp2515_write(MCP_CANINTE,
                   MCP_CANINTE_RX0IE | MCP_CANINTE_RX1IE |
-                  MCP_CANINTE_TX0IE | MCP_CANINTE_TX1IE | MCP_CANINTE_TX2IE);
+                  MCP_CANINTE_TX0IE | MCP_CANINTE_TX1IE | MCP_CANINTE_TX2IE |
+                  MCP_CANINTE_ERRIE | MCP_CANINTE_MERRE);
 
     return true; 
 }
@@ -231,6 +231,16 @@ typedef enum
 #define MCP_CANINTF_WAKIF		0x40
 #define MCP_CANINTF_MERRF		0x80
 
+// EFLG Register Bits
+#define MCP_EFLG_EWARN			0x01
+#define MCP_EFLG_RXWAR			0x02
+#define MCP_EFLG_TXWAR			0x04
+#define MCP_EFLG_RXEP			0x08
+#define MCP_EFLG_TXEP			0x10
+#define MCP_EFLG_TXBO			0x20
+#define MCP_EFLG_RX0OVR			0x40
+#define MCP_EFLG_RX1OVR			0x80
+
 /* Encode register value for TXBnCTRL */
 #define MCP_TXBnCTRL_ENCODE(txreq, priority) \
     _FORCE_UINT8((((txreq) << 3) & 0x08) | ((priority)&0x03))
@@ -0,0 +1,102 @@
+/*
+ * Menu strings pre-rendered with font4.
+ *
+ * Generated by tools/menugen.py from ui.c and fonts.h, do not edit.
+ */
+#ifndef MENU_BITMAPS_H__
+#define MENU_BITMAPS_H__
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+typedef struct
+{
+    const char * p_text;
+    const uint8_t * p_bitmap;
+    uint8_t width;
+} menu_bitmap_t;
+
+// (1) :(
+static const char m_menu_text_0[] PROGMEM = "(1) :(";
+static const uint8_t m_menu_bitmap_0[24] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x48, 0x7C, 0x40, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x48, 0x00, 0x00, 0x00, 0x78, 0x84, 0x00,
+};
+
+// (1) WELCOME TO THE SUBMENU
+static const char m_menu_text_1[] PROGMEM = "(1) WELCOME TO THE SUBMENU";
+static const uint8_t m_menu_bitmap_1[104] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x48, 0x7C, 0x40, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x30, 0x7C, 0x00, 0x7C, 0x54, 0x44, 0x00, 0x7C, 0x40, 0x40, 0x00, 0x38, 0x44, 0x28, 0x00,
+    0x38, 0x44, 0x38, 0x00, 0x7C, 0x18, 0x7C, 0x00, 0x7C, 0x54, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x04, 0x7C, 0x04, 0x00, 0x38, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x7C, 0x04, 0x00,
+    0x7C, 0x10, 0x7C, 0x00, 0x7C, 0x54, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x54, 0x24, 0x00,
+    0x7C, 0x40, 0x7C, 0x00, 0x7C, 0x54, 0x28, 0x00, 0x7C, 0x18, 0x7C, 0x00, 0x7C, 0x54, 0x44, 0x00,
+    0x78, 0x10, 0x3C, 0x00, 0x7C, 0x40, 0x7C, 0x00,
+};
+
+// (2) EXIT
+static const char m_menu_text_2[] PROGMEM = "(2) EXIT";
+static const uint8_t m_menu_bitmap_2[32] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x48, 0x64, 0x58, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x54, 0x44, 0x00, 0x6C, 0x10, 0x6C, 0x00, 0x44, 0x7C, 0x44, 0x00, 0x04, 0x7C, 0x04, 0x00,
+};
+
+// (1) PLAY GAME
+static const char m_menu_text_3[] PROGMEM = "(1) PLAY GAME";
+static const uint8_t m_menu_bitmap_3[52] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x48, 0x7C, 0x40, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x14, 0x08, 0x00, 0x7C, 0x40, 0x40, 0x00, 0x78, 0x14, 0x78, 0x00, 0x0C, 0x70, 0x0C, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x74, 0x00, 0x78, 0x14, 0x78, 0x00, 0x7C, 0x18, 0x7C, 0x00,
+    0x7C, 0x54, 0x44, 0x00,
+};
+
+// (2) RUN ANIMATION
+static const char m_menu_text_4[] PROGMEM = "(2) RUN ANIMATION";
+static const uint8_t m_menu_bitmap_4[68] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x48, 0x64, 0x58, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x14, 0x68, 0x00, 0x7C, 0x40, 0x7C, 0x00, 0x78, 0x10, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x78, 0x14, 0x78, 0x00, 0x78, 0x10, 0x3C, 0x00, 0x44, 0x7C, 0x44, 0x00, 0x7C, 0x18, 0x7C, 0x00,
+    0x78, 0x14, 0x78, 0x00, 0x04, 0x7C, 0x04, 0x00, 0x44, 0x7C, 0x44, 0x00, 0x38, 0x44, 0x38, 0x00,
+    0x78, 0x10, 0x3C, 0x00,
+};
+
+// (3) CONSOLE
+static const char m_menu_text_5[] PROGMEM = "(3) CONSOLE";
+static const uint8_t m_menu_bitmap_5[44] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x44, 0x54, 0x2C, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x38, 0x44, 0x28, 0x00, 0x38, 0x44, 0x38, 0x00, 0x78, 0x10, 0x3C, 0x00, 0x48, 0x54, 0x24, 0x00,
+    0x38, 0x44, 0x38, 0x00, 0x7C, 0x40, 0x40, 0x00, 0x7C, 0x54, 0x44, 0x00,
+};
+
+// (4) LAUNCH THE NUKES
+static const char m_menu_text_6[] PROGMEM = "(4) LAUNCH THE NUKES";
+static const uint8_t m_menu_bitmap_6[80] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x1C, 0x10, 0x7C, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x40, 0x40, 0x00, 0x78, 0x14, 0x78, 0x00, 0x7C, 0x40, 0x7C, 0x00, 0x78, 0x10, 0x3C, 0x00,
+    0x38, 0x44, 0x28, 0x00, 0x7C, 0x10, 0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x7C, 0x04, 0x00,
+    0x7C, 0x10, 0x7C, 0x00, 0x7C, 0x54, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x10, 0x3C, 0x00,
+    0x7C, 0x40, 0x7C, 0x00, 0x7C, 0x10, 0x6C, 0x00, 0x7C, 0x54, 0x44, 0x00, 0x48, 0x54, 0x24, 0x00,
+};
+
+// (5) EXIT
+static const char m_menu_text_7[] PROGMEM = "(5) EXIT";
+static const uint8_t m_menu_bitmap_7[32] PROGMEM = {
+    0x00, 0x78, 0x84, 0x00, 0x5C, 0x54, 0x24, 0x00, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7C, 0x54, 0x44, 0x00, 0x6C, 0x10, 0x6C, 0x00, 0x44, 0x7C, 0x44, 0x00, 0x04, 0x7C, 0x04, 0x00,
+};
+
+#define MENU_BITMAP_COUNT (8)
+
+static const menu_bitmap_t menu_bitmaps[MENU_BITMAP_COUNT] PROGMEM = {
+    { m_menu_text_0, m_menu_bitmap_0, 24 },
+    { m_menu_text_1, m_menu_bitmap_1, 104 },
+    { m_menu_text_2, m_menu_bitmap_2, 32 },
+    { m_menu_text_3, m_menu_bitmap_3, 52 },
+    { m_menu_text_4, m_menu_bitmap_4, 68 },
+    { m_menu_text_5, m_menu_bitmap_5, 44 },
+    { m_menu_text_6, m_menu_bitmap_6, 80 },
+    { m_menu_text_7, m_menu_bitmap_7, 32 },
+};
+
+#endif /* MENU_BITMAPS_H__ */
@@ -3,11 +3,12 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <avr/pgmspace.h>
 #include "ext_peripherals.h"
 #include "oled.h"
 #include "oled_types.h"
-#include "fonts.h"
 #include "ping_pong.h"
+#include "profiler.h"
 
 
 /*
@@ -38,7 +39,7 @@ static char oled_init_routine[] =
 };
 */
 
-static char m_oled_init_routine[] =
+static const uint8_t m_oled_init_routine[] PROGMEM =
 {
     OLEDC_SET_DISPLAY_ON_OFF(0x0), // Turn display off
     OLEDC_SET_SEGMENT_REMAP(0x1), // Map column addr 127 to SEG0
@@ -65,38 +66,44 @@ static char m_oled_init_routine[] =
 };
 
 static uint8_t m_current_row;
+/* Next column to write, 128 once the end of the page is reached */
 static uint8_t m_current_col;
+static text_font_t m_font = TEXT_FONT_SMALL;
 
-static int m_oled_printchar(char char_to_print, FILE *stream)
+/* Write a glyph at the current position, dropping whatever does not fit on the page */
+static void m_oled_putglyph(char char_to_print, uint8_t mask)
 {
-    assert((uint8_t)char_to_print <= NUM_LETTERS_IN_FONT);
+    uint8_t glyph[TEXT_GLYPH_MAX_WIDTH];
+    uint8_t width = text_glyph_get(m_font, char_to_print, glyph);
 
-	const uint8_t font_size = NUMELTS(font4[0]);
+    if (width > 128 - m_current_col)
+    {
+        width = 128 - m_current_col;
+    }
 
-    for (uint8_t i = 0; i < font_size; i++)
+    for (uint8_t i = 0; i < width; i++)
     {
-		volatile uint8_t char_to_write = pgm_read_word(&font4[(uint8_t)char_to_print-32][i]);
-        EXT_OLED->DATA = char_to_write;
-		m_current_col = (m_current_col + font_size) % 128;
+        EXT_OLED->DATA = glyph[i] ^ mask;
     }
+    m_current_col += width;
+}
+
+static int m_oled_printchar(char char_to_print, FILE *stream)
+{
+    uint32_t probe_start = profiler_probe_begin();
+
+    m_oled_putglyph(char_to_print, 0x00);
+
+    profiler_probe_end(PROFILER_PROBE_OLED_PRINTCHAR, probe_start);
 
     return 0;
 }
 
 static int m_oled_inv_printchar(char char_to_print, FILE *stream)
 {
-	assert((uint8_t)char_to_print <= NUM_LETTERS_IN_FONT);
-
-	const uint8_t font_size = NUMELTS(font4[0]);
+    m_oled_putglyph(char_to_print, 0xFF);
 
-	for (uint8_t i = 0; i < font_size; i++)
-	{
-		volatile uint8_t char_to_write = ~pgm_read_word(&font4[(uint8_t)char_to_print-32][i]);
-		EXT_OLED->DATA = char_to_write;
-		m_current_col = (m_current_col + font_size) % 128;
-	}
-
-	return 0;
+    return 0;
 }
 
 /* Oled output streams */
@@ -120,13 +127,30 @@ void oled_printf(const char *string, bool inv, ...)
 	va_end(args);
 }
 
+void oled_printf_P(const char *string, bool inv, ...)
+{
+	va_list args;
+	va_start(args, inv);
+
+	if (inv)
+	{
+		vfprintf_P(&m_oled_inv_stream, string, args);
+	}
+	else
+	{
+		vfprintf_P(&m_oled_stream, string, args);
+	}
+
+	va_end(args);
+}
+
 
 
 bool oled_init(void)
 {
     for (uint8_t i = 0; i < NUMELTS(m_oled_init_routine); i++)
     {
-        EXT_OLED->CMD = m_oled_init_routine[i];
+        EXT_OLED->CMD = pgm_read_byte(&m_oled_init_routine[i]);
     }
 
     for (uint8_t line = 0; line < 8; line++)
@@ -196,3 +220,59 @@ void oled_pos(uint8_t row, uint8_t column)
     /* Column selection */
     oled_goto_column(column);
 }
+
+void oled_page_write(uint8_t page, uint8_t column, const uint8_t *p_data, uint8_t len)
+{
+    assert(column + len <= 128);
+
+    oled_pos(page, column);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        EXT_OLED->DATA = p_data[i];
+    }
+
+    m_current_col = column + len;
+}
+
+void oled_blit_P(uint8_t page, uint8_t column, const uint8_t *p_data_P, uint8_t len, bool inv)
+{
+    assert(column + len <= 128);
+
+    const uint8_t mask = inv ? 0xFF : 0x00;
+
+    oled_pos(page, column);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        EXT_OLED->DATA = pgm_read_byte(&p_data_P[i]) ^ mask;
+    }
+
+    m_current_col = column + len;
+}
+
+void oled_data_write(const uint8_t *p_data, uint8_t len)
+{
+    assert(m_current_col + len <= 128);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        EXT_OLED->DATA = p_data[i];
+    }
+
+    m_current_col += len;
+}
+
+void oled_font_set(text_font_t font)
+{
+    assert(font < TEXT_FONT_COUNT);
+
+    m_font = font;
+}
+
+void oled_start_line_set(uint8_t line)
+{
+    assert(line < 64);
+
+    EXT_OLED->CMD = OLEDC_SET_DISPLAY_START_LINE(line);
+}
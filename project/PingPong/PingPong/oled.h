@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "text.h"
 
 bool oled_init(void);
 void oled_reset(void);
@@ -20,5 +21,17 @@ void oled_goto_column(uint8_t column);
 void oled_clear_line(uint8_t line);
 void oled_pos(uint8_t row, uint8_t column);
 void oled_printf(const char *string, bool inv, ...);
+// Same with the format string in program memory
+void oled_printf_P(const char *string, bool inv, ...);
+// Copy `len` bytes of page-organized pixel data to the given page and column
+void oled_page_write(uint8_t page, uint8_t column, const uint8_t *p_data, uint8_t len);
+// Same from program memory, inverting every byte if `inv` is set
+void oled_blit_P(uint8_t page, uint8_t column, const uint8_t *p_data_P, uint8_t len, bool inv);
+// Write `len` bytes at the current position, which advances with them
+void oled_data_write(const uint8_t *p_data, uint8_t len);
+// Display RAM row (0-63) shown at the top of the screen
+void oled_start_line_set(uint8_t line);
+// Font used by oled_printf(), TEXT_FONT_SMALL by default
+void oled_font_set(text_font_t font);
 
 #endif /* OLED_H_ */
\ No newline at end of file
@@ -0,0 +1,129 @@
+/*
+ * Scrolling text console on the OLED, using the display start line.
+ */
+
+#include "oled_console.h"
+#include "oled.h"
+#include "ping_pong.h"
+#include "xmem.h"
+
+typedef struct
+{
+    char text[OLED_CONSOLE_LINES][OLED_CONSOLE_LINE_LEN];
+    uint8_t len[OLED_CONSOLE_LINES];
+} m_ring_t;
+
+static m_ring_t m_ring_mem XMEM;
+static m_ring_t * const m_ring = &m_ring_mem;
+
+// Ring slot n is drawn on display page n. The slot of the line being
+// written is shown at the bottom, the oldest line is the next slot.
+static uint8_t m_current;
+static uint32_t m_line_count;
+static bool m_shown;
+
+// Page shown at the top of the display, i.e. the one of the oldest line
+static uint8_t m_top_page_get(void)
+{
+    return (m_current + 1) % OLED_CONSOLE_LINES;
+}
+
+// Draw characters [from, len) of a line at their place on its page
+static void m_line_draw(uint8_t slot, uint8_t from)
+{
+    char text[OLED_CONSOLE_LINE_LEN + 1];
+    uint8_t len = m_ring->len[slot];
+
+    memcpy(text, &m_ring->text[slot][from], len - from);
+    text[len - from] = '\0';
+
+    uint8_t width = text_font_width(TEXT_FONT_SMALL);
+    (void) text_oled_draw(slot, from * width, 0, 128, TEXT_FONT_SMALL, text, false);
+}
+
+static void m_newline(void)
+{
+    m_current = (m_current + 1) % OLED_CONSOLE_LINES;
+    m_ring->len[m_current] = 0;
+    m_line_count++;
+
+    if (m_shown)
+    {
+        // The page of the oldest line becomes the new bottom line
+        oled_clear_line(m_current);
+        oled_start_line_set(m_top_page_get() * 8);
+    }
+}
+
+bool oled_console_init(void)
+{
+    memset(m_ring, 0, sizeof(m_ring_t));
+    m_current = 0;
+    m_line_count = 0;
+    m_shown = false;
+
+    return true;
+}
+
+void oled_console_write(const char *s)
+{
+    assert(s);
+
+    uint8_t from = m_ring->len[m_current];
+
+    for (; *s; s++)
+    {
+        if (*s == '\n' || m_ring->len[m_current] == OLED_CONSOLE_LINE_LEN)
+        {
+            if (m_shown && m_ring->len[m_current] > from)
+            {
+                m_line_draw(m_current, from);
+            }
+            m_newline();
+            from = 0;
+
+            if (*s == '\n')
+            {
+                continue;
+            }
+        }
+
+        m_ring->text[m_current][m_ring->len[m_current]++] = *s;
+    }
+
+    if (m_shown && m_ring->len[m_current] > from)
+    {
+        m_line_draw(m_current, from);
+    }
+}
+
+void oled_console_show(bool show)
+{
+    m_shown = show;
+
+    if (!show)
+    {
+        oled_start_line_set(0);
+        return;
+    }
+
+    for (uint8_t slot = 0; slot < OLED_CONSOLE_LINES; slot++)
+    {
+        oled_clear_line(slot);
+        if (m_ring->len[slot] > 0)
+        {
+            m_line_draw(slot, 0);
+        }
+    }
+    oled_start_line_set(m_top_page_get() * 8);
+}
+
+bool oled_console_shown(void)
+{
+    return m_shown;
+}
+
+uint32_t oled_console_line_count_get(void)
+{
+    return m_line_count;
+}
@@ -0,0 +1,30 @@
+/*
+ * Scrolling text console on the OLED.
+ *
+ * The last OLED_CONSOLE_LINES lines are kept in a ring in external SRAM.
+ * While the console is shown, every display page holds one line and a new
+ * line is written into the page of the oldest one, after which the display
+ * start line is moved down by one page. Scrolling therefore costs one page
+ * write instead of redrawing the whole display.
+ */
+#ifndef OLED_CONSOLE_H__
+#define OLED_CONSOLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define OLED_CONSOLE_LINES     (8)
+#define OLED_CONSOLE_LINE_LEN  (32) /* 128 columns in the small font */
+
+bool oled_console_init(void);
+// Append text. '\n' ends a line and lines longer than OLED_CONSOLE_LINE_LEN
+// wrap. Only stored while the console is hidden.
+void oled_console_write(const char *s);
+// Take over the display and draw the stored lines, or give it back with the
+// start line reset. The caller redraws the display after hiding.
+void oled_console_show(bool show);
+bool oled_console_shown(void);
+// Number of lines completed since oled_console_init()
+uint32_t oled_console_line_count_get(void);
+
+#endif /* OLED_CONSOLE_H__ */
@@ -100,7 +100,7 @@ Display start line register is reset to 000000b
 during RESET.
 */
 #define OLEDC_SET_DISPLAY_START_LINE(line_reg) \
-    _OLEDC(0x40 | ((addr) & 0x3F))
+    _OLEDC(0x40 | ((line_reg) & 0x3F))
 
 /*
 Set Contrast Control
@@ -232,7 +232,7 @@ The value is reset to 00h after RESET.
     _OLEDC(0xD3)
 
 #define OLEDC_SET_DISPLAY_OFFSET_1(offset) \
-    _OLEDC((addr) & 0x3F)
+    _OLEDC((offset) & 0x3F)
 
 
 /*
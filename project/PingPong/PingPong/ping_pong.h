@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 
 #define F_CPU 4915200  /* Clock speed */
 
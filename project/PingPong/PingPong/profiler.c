@@ -0,0 +1,168 @@
+/*
+ * Cycle profiling probes using a free-running Timer1.
+ */
+
+#include <avr/interrupt.h>
+#include "ping_pong.h"
+#include "profiler.h"
+#include "xmem.h"
+
+static volatile uint16_t m_overflow_count;
+
+// Cost of an empty begin/end pair, subtracted from every sample
+static uint16_t m_probe_overhead;
+
+// Empty begin/end pairs timed to find m_probe_overhead
+#define M_CALIBRATION_RUNS (8)
+
+static profiler_probe_stats_t m_stats[PROFILER_PROBE_COUNT] XMEM;
+
+static const char m_probe_names[PROFILER_PROBE_COUNT][16] PROGMEM = {
+    [PROFILER_PROBE_CAN_ISR]        = "can_isr",
+    [PROFILER_PROBE_OLED_PRINTCHAR] = "oled_printchar",
+    [PROFILER_PROBE_ADC_SAMPLE]     = "adc_sample",
+    [PROFILER_PROBE_UI_UPDATE]      = "ui_update",
+    [PROFILER_PROBE_SCHED_TASK]     = "sched_task",
+    [PROFILER_PROBE_BUTTON_TX]      = "button_tx",
+    [PROFILER_PROBE_ANIM_FRAME]     = "anim_frame",
+};
+
+ISR(TIMER1_OVF_vect)
+{
+    m_overflow_count++;
+}
+
+static uint8_t m_hist_bin(uint32_t cycles)
+{
+    uint8_t bin = 0;
+
+    while (cycles >= 4 && bin < (PROFILER_HIST_BINS - 1))
+    {
+        cycles >>= 2;
+        bin++;
+    }
+
+    return bin;
+}
+
+uint32_t profiler_cycles_get(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    uint16_t low = TCNT1;
+    uint16_t high = m_overflow_count;
+
+    // Account for an overflow that happened while interrupts were disabled
+    if ((TIFR & _BV(TOV1)) && low < 0x8000)
+    {
+        high++;
+    }
+
+    SREG = sreg;
+
+    return ((uint32_t) high << 16) | low;
+}
+
+void profiler_record(profiler_probe_t probe, uint32_t cycles)
+{
+    assert(probe < PROFILER_PROBE_COUNT);
+
+    cycles = cycles > m_probe_overhead ? cycles - m_probe_overhead : 0;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    profiler_probe_stats_t *p_stats = &m_stats[probe];
+    p_stats->count++;
+    p_stats->total_cycles += cycles;
+    if (cycles < p_stats->min_cycles)
+    {
+        p_stats->min_cycles = cycles;
+    }
+    if (cycles > p_stats->max_cycles)
+    {
+        p_stats->max_cycles = cycles;
+    }
+
+    uint16_t *p_bin = &p_stats->hist[m_hist_bin(cycles)];
+    if (*p_bin < UINT16_MAX)
+    {
+        (*p_bin)++;
+    }
+
+    SREG = sreg;
+}
+
+void profiler_reset(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    for (uint8_t i = 0; i < PROFILER_PROBE_COUNT; i++)
+    {
+        memset(&m_stats[i], 0, sizeof(m_stats[i]));
+        m_stats[i].min_cycles = UINT32_MAX;
+    }
+
+    SREG = sreg;
+}
+
+bool profiler_init(void)
+{
+    // Normal mode, clk/1, interrupt on overflow
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+    TCNT1 = 0;
+    m_overflow_count = 0;
+    TIFR = _BV(TOV1);
+    TIMSK |= _BV(TOIE1);
+
+    // Calibrate with empty begin/end pairs through the same path as the
+    // probes, keeping the cheapest in case an interrupt hit one of them
+    m_probe_overhead = 0;
+    profiler_reset();
+    for (uint8_t i = 0; i < M_CALIBRATION_RUNS; i++)
+    {
+        profiler_probe_end(PROFILER_PROBE_CAN_ISR, profiler_probe_begin());
+    }
+    // Nothing is recorded with the probes compiled out
+    if (m_stats[PROFILER_PROBE_CAN_ISR].count)
+    {
+        m_probe_overhead = (uint16_t) m_stats[PROFILER_PROBE_CAN_ISR].min_cycles;
+    }
+
+    profiler_reset();
+
+    return true;
+}
+
+void profiler_export(void)
+{
+    // One line per probe so the host side can pick the dump out of a log.
+    // Format: #PROF <name> <count> <total> <min> <max> <hist0> ... <histN-1>
+    printf_P(PSTR("#PROF begin %lu %u\n"), (unsigned long) F_CPU, PROFILER_HIST_BINS);
+
+    for (uint8_t i = 0; i < PROFILER_PROBE_COUNT; i++)
+    {
+        profiler_probe_stats_t stats;
+
+        uint8_t sreg = SREG;
+        cli();
+        memcpy(&stats, &m_stats[i], sizeof(stats));
+        SREG = sreg;
+
+        printf_P(PSTR("#PROF %S %lu %lu %lu %lu"), m_probe_names[i],
+               (unsigned long) stats.count,
+               (unsigned long) stats.total_cycles,
+               (unsigned long) (stats.count ? stats.min_cycles : 0),
+               (unsigned long) stats.max_cycles);
+        for (uint8_t bin = 0; bin < PROFILER_HIST_BINS; bin++)
+        {
+            printf_P(PSTR(" %u"), stats.hist[bin]);
+        }
+        printf_P(PSTR("\n"));
+    }
+
+    printf_P(PSTR("#PROF end\n"));
+}
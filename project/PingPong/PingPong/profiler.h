@@ -0,0 +1,76 @@
+/*
+ * Cycle profiling probes.
+ *
+ * Timer1 runs free at clk/1 and is extended to 32 bits in software, so a
+ * probe measures CPU cycles directly. Each probe keeps a logarithmic
+ * histogram (bin width x4) in external SRAM which can be dumped over the
+ * UART with profiler_export().
+ */
+#ifndef PROFILER_H__
+#define PROFILER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Set to 0 to compile all probes out
+#define PROFILER_ENABLED (1)
+
+// Number of histogram bins per probe. Bin n holds samples in [4^n, 4^(n+1))
+#define PROFILER_HIST_BINS (8)
+
+typedef enum
+{
+    PROFILER_PROBE_CAN_ISR = 0,
+    PROFILER_PROBE_OLED_PRINTCHAR,
+    PROFILER_PROBE_ADC_SAMPLE,
+    PROFILER_PROBE_UI_UPDATE,
+    PROFILER_PROBE_SCHED_TASK,
+    PROFILER_PROBE_BUTTON_TX,
+    PROFILER_PROBE_ANIM_FRAME,
+    PROFILER_PROBE_COUNT
+} profiler_probe_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t total_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint16_t hist[PROFILER_HIST_BINS];
+} profiler_probe_stats_t;
+
+// Start Timer1 and clear all probe statistics. Requires external SRAM.
+bool profiler_init(void);
+// Clear all probe statistics
+void profiler_reset(void);
+// Current 32-bit cycle count. Safe to call from interrupt context.
+uint32_t profiler_cycles_get(void);
+// Add a sample of `cycles` length to the given probe
+void profiler_record(profiler_probe_t probe, uint32_t cycles);
+// Dump the statistics of every probe to stdout (see tools/profview.py)
+void profiler_export(void);
+
+#if PROFILER_ENABLED
+static inline uint32_t profiler_probe_begin(void)
+{
+    return profiler_cycles_get();
+}
+
+static inline void profiler_probe_end(profiler_probe_t probe, uint32_t start)
+{
+    profiler_record(probe, profiler_cycles_get() - start);
+}
+#else
+static inline uint32_t profiler_probe_begin(void)
+{
+    return 0;
+}
+
+static inline void profiler_probe_end(profiler_probe_t probe, uint32_t start)
+{
+    (void) probe;
+    (void) start;
+}
+#endif
+
+#endif /* PROFILER_H__ */
@@ -10,12 +10,23 @@ UBBR for baudrate (UBBR = fOsc/(16 BAUD) - 1)
 #include <stdio.h>
 #include <avr/sfr_defs.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
 #include "rs232.h"
 
 #define BAUDRATE 9600
 
+// Transmit buffer, emptied by uart_drain(). Must be a power of two.
+#define M_TX_BUF_SIZE 64
+
 static const unsigned int m_ubbr_value = ((F_CPU / 16) / BAUDRATE - 1);
 
+static char m_tx_buf[M_TX_BUF_SIZE];
+static uint8_t m_tx_head;
+static uint8_t m_tx_tail;
+
+static uart_rx_handler_t m_rx_handler;
+
 /* Function prototypes */
 static int m_uart_printchar(char char_to_print, FILE *stream);
 static int m_uart_getchar(FILE *stream);
@@ -23,21 +34,52 @@ static int m_uart_getchar(FILE *stream);
 // allocate output stream statically to avoid malloc()
 static FILE uart_stream = FDEV_SETUP_STREAM(m_uart_printchar, m_uart_getchar, _FDEV_SETUP_RW);
 
+ISR(USART0_RXC_vect)
+{
+    char received = UDR0;
+
+    if (m_rx_handler)
+    {
+        m_rx_handler(received);
+    }
+}
+
+static void m_tx_put(char char_to_print)
+{
+    uint8_t next = (m_tx_tail + 1) & (M_TX_BUF_SIZE - 1);
+
+    // Buffer full: busy-wait until the line has taken the oldest character
+    while (next == m_tx_head)
+    {
+        uart_drain();
+    }
+
+    m_tx_buf[m_tx_tail] = char_to_print;
+    m_tx_tail = next;
+}
+
 static int m_uart_printchar(char char_to_print, FILE *stream)
 {
     if (char_to_print == '\n')
     {
-        return m_uart_printchar('\r', stream);
+        m_tx_put('\r');
     }
 
-    // busy-wait until bit UDRE is set in UCSRA
-    while ( bit_is_clear(UCSR0A, UDRE0) );
-
-    UDR0 = char_to_print; // write out character
+    m_tx_put(char_to_print);
 
     return 0;
 }
 
+void uart_drain(void)
+{
+    // Hand characters to the transmitter for as long as it accepts them
+    while (m_tx_head != m_tx_tail && bit_is_set(UCSR0A, UDRE0))
+    {
+        UDR0 = m_tx_buf[m_tx_head];
+        m_tx_head = (m_tx_head + 1) & (M_TX_BUF_SIZE - 1);
+    }
+}
+
 static int m_uart_getchar(FILE *stream)
 {
     if (ferror(&uart_stream))
@@ -63,6 +105,21 @@ char uart_fetch_by_force(void)
 	return UDR0;
 }
 
+void uart_rx_handler_set(uart_rx_handler_t handler)
+{
+	m_rx_handler = handler;
+
+	// Receive through the interrupt only while someone is listening
+	if (handler)
+	{
+		UCSR0B |= _BV(RXCIE0);
+	}
+	else
+	{
+		UCSR0B &= ~_BV(RXCIE0);
+	}
+}
+
 void uart_config_streams(void)
 {
 	stdout = &uart_stream;
@@ -72,7 +129,7 @@ void uart_config_streams(void)
 void uart_print(char *string)
 {
 	uart_config_streams();
-	printf("%s", string);
+	printf_P(PSTR("%s"), string);
 }
 
 bool uart_init(void)
@@ -81,6 +138,10 @@ bool uart_init(void)
 	UBRR0H = (uint8_t) (m_ubbr_value >> 8);
 	UBRR0L = (uint8_t) m_ubbr_value;
 	
+	m_tx_head = 0;
+	m_tx_tail = 0;
+	m_rx_handler = NULL;
+
 	/* Enable transmitter and receiver */
 	UCSR0B = (1 << RXEN0) | (1 << TXEN0);
     return true;
@@ -4,7 +4,14 @@
 
 #include "ping_pong.h"
 
+// Called from the receive interrupt for every character
+typedef void (*uart_rx_handler_t)(char received);
+
 bool uart_init(void);
+// Blocking read. Do not use while a receive handler is set.
 char uart_fetch_by_force(void);
+void uart_rx_handler_set(uart_rx_handler_t handler);
 void uart_config_streams(void);
-void uart_print(char *string);
\ No newline at end of file
+void uart_print(char *string);
+// Output is buffered; call regularly to pass it on to the transmitter
+void uart_drain(void);
\ No newline at end of file
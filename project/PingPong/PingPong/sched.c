@@ -0,0 +1,197 @@
+/*
+ * Cooperative run-to-completion task scheduler on the Timer0 tick.
+ */
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "ping_pong.h"
+#include "sched.h"
+#include "timer.h"
+#include "profiler.h"
+#include "cpu_load.h"
+
+typedef struct
+{
+    sched_task_cfg_t cfg;
+    uint32_t release_ms;
+    uint32_t worst_exec_cycles;
+    sched_task_stats_t stats;
+} m_task_t;
+
+static m_task_t m_tasks[SCHED_MAX_TASKS];
+static uint8_t m_task_count;
+
+// Set from interrupt context by sched_task_trigger()
+static volatile uint8_t m_triggered_mask;
+
+// First ready task in priority order, or NULL
+static m_task_t * m_ready_task_get(uint32_t now)
+{
+    if (m_triggered_mask)
+    {
+        // Move triggered releases to now
+        cli();
+        uint8_t triggered = m_triggered_mask;
+        m_triggered_mask = 0;
+        sei();
+
+        for (uint8_t i = 0; i < m_task_count; i++)
+        {
+            if ((triggered & _BV(i)) && (int32_t) (m_tasks[i].release_ms - now) > 0)
+            {
+                m_tasks[i].release_ms = now;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < m_task_count; i++)
+    {
+        if ((int32_t) (now - m_tasks[i].release_ms) >= 0)
+        {
+            return &m_tasks[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void m_task_run(m_task_t * p_task, uint32_t now)
+{
+    uint32_t latency = now - p_task->release_ms;
+    uint32_t start_cycles = profiler_cycles_get();
+
+    p_task->cfg.fn();
+
+    uint32_t exec_cycles = profiler_cycles_get() - start_cycles;
+    profiler_probe_end(PROFILER_PROBE_SCHED_TASK, start_cycles);
+    uint32_t finish = timer_ms_get();
+
+    p_task->stats.run_count++;
+    if (latency > p_task->stats.worst_latency_ms)
+    {
+        p_task->stats.worst_latency_ms = latency;
+    }
+    if (exec_cycles > p_task->worst_exec_cycles)
+    {
+        p_task->worst_exec_cycles = exec_cycles;
+    }
+    if (finish - p_task->release_ms > p_task->cfg.deadline_ms)
+    {
+        p_task->stats.deadline_miss_count++;
+    }
+
+    // Next release. Releases that have already passed are skipped, each
+    // one counting as a missed deadline.
+    p_task->release_ms += p_task->cfg.period_ms;
+    while ((int32_t) (finish - p_task->release_ms) >= (int32_t) p_task->cfg.period_ms)
+    {
+        p_task->release_ms += p_task->cfg.period_ms;
+        p_task->stats.deadline_miss_count++;
+    }
+}
+
+// Sleep until the next interrupt (tick, CAN, UART) unless a task was
+// triggered in the meantime.
+static void m_idle_wait(uint32_t now)
+{
+    cpu_load_idle_enter();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    while (timer_ms_get() == now && !m_triggered_mask)
+    {
+        // sei takes effect after the next instruction, so a wake-up
+        // interrupt cannot slip in between the check and the sleep
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        cli();
+    }
+    sei();
+
+    cpu_load_idle_exit();
+}
+
+void sched_init(void)
+{
+    m_task_count = 0;
+    m_triggered_mask = 0;
+}
+
+uint8_t sched_task_add(const sched_task_cfg_t * cfg)
+{
+    if (!cfg || !cfg->fn || cfg->period_ms == 0 || m_task_count >= SCHED_MAX_TASKS)
+    {
+        return SCHED_TASK_INVALID;
+    }
+
+    m_task_t * p_task = &m_tasks[m_task_count];
+    p_task->cfg = *cfg;
+    if (p_task->cfg.deadline_ms == 0)
+    {
+        p_task->cfg.deadline_ms = cfg->period_ms;
+    }
+    p_task->release_ms = timer_ms_get() + cfg->offset_ms;
+    p_task->worst_exec_cycles = 0;
+    memset(&p_task->stats, 0, sizeof(p_task->stats));
+
+    return m_task_count++;
+}
+
+void sched_task_trigger(uint8_t task_id)
+{
+    if (task_id < m_task_count)
+    {
+        uint8_t sreg = SREG;
+        cli();
+        m_triggered_mask |= _BV(task_id);
+        SREG = sreg;
+    }
+}
+
+uint8_t sched_task_count_get(void)
+{
+    return m_task_count;
+}
+
+const char * sched_task_name_get(uint8_t task_id)
+{
+    if (task_id >= m_task_count)
+    {
+        return NULL;
+    }
+
+    return m_tasks[task_id].cfg.name;
+}
+
+bool sched_task_stats_get(uint8_t task_id, sched_task_stats_t * p_stats_out)
+{
+    if (task_id >= m_task_count || !p_stats_out)
+    {
+        return false;
+    }
+
+    *p_stats_out = m_tasks[task_id].stats;
+    p_stats_out->worst_exec_us = (uint32_t) (((uint64_t) m_tasks[task_id].worst_exec_cycles * 1000000UL) / F_CPU);
+
+    return true;
+}
+
+void sched_run(void)
+{
+    while (1)
+    {
+        uint32_t now = timer_ms_get();
+        m_task_t * p_task = m_ready_task_get(now);
+
+        if (p_task)
+        {
+            m_task_run(p_task, now);
+        }
+        else
+        {
+            m_idle_wait(now);
+        }
+    }
+}
@@ -1,45 +1,300 @@
-// Boilerplate test driver for the SRAM chip.
+/*
+ * Non-destructive March C-, checkerboard and address test of the external SRAM.
+ */
 
-#include <stdlib.h>
-#include <stdint.h>
-#include <stdio.h>
+#include <avr/interrupt.h>
+#include "ping_pong.h"
+#include "ext_peripherals.h"
+#include "profiler.h"
 #include "sram_test.h"
 
-void SRAM_test(void)
-{
-  volatile char *ext_ram = (char *) 0x1800; // Start address for the SRAM
-  uint16_t ext_ram_size = 0x800;
-  uint16_t write_errors = 0;
-  uint16_t retrieval_errors = 0;
-  printf("Starting SRAM test...\n");
-  // rand() stores some internal state, so calling this function in a loop will
-  // yield different seeds each time (unless srand() is called before this function)
-  uint16_t seed = rand();
-  // Write phase: Immediately check that the correct value was stored
-  srand(seed);
-  for (uint16_t i = 0; i < ext_ram_size; i++)
-  {
-    uint8_t some_value = rand();
-    ext_ram[i] = some_value;
-    uint8_t retreived_value = ext_ram[i];
-    if (retreived_value != some_value)
-    {
-      printf("Write phase error: ext_ram[%4d] = %02X (should be %02X)\n", i, retreived_value, some_value);
-      write_errors++;
-    }
-  }
-  // Retrieval phase: Check that no values were changed during or after the write phase
-  srand(seed);
-  // reset the PRNG to the state it had before the write phase
-  for (uint16_t i = 0; i < ext_ram_size; i++)
-  {
-    uint8_t some_value = rand();
-    uint8_t retreived_value = ext_ram[i];
-    if (retreived_value != some_value)
-    {
-      printf("Retrieval phase error: ext_ram[%4d] = %02X (should be %02X)\n", i, retreived_value, some_value);
-      retrieval_errors++;
-    }
-  }
-  printf("SRAM test completed with \n%4d errors in write phase and \n%4d errors in retrieval phase\n\n", write_errors, retrieval_errors);
+// Accesses by offset into the external SRAM. The host test defines these to
+// run the test against a fault model.
+#ifndef SRAM_TEST_READ
+#define SRAM_TEST_READ(offset) (EXT_SRAM[offset])
+#define SRAM_TEST_WRITE(offset, value) (EXT_SRAM[offset] = (value))
+#endif
+
+// Checkerboard for byte i. Alternating bytes are inverted, so neighbouring
+// bits differ both within a byte and between adjacent bytes.
+#define M_CHECKER(i, inv) ((uint8_t) ((((i) & 1) ? 0xAA : 0x55) ^ ((inv) ? 0xFF : 0x00)))
+
+// Address test patterns, with every data bit differing between them
+#define M_ADDR_PATTERN (0xAA)
+#define M_ADDR_ANTIPATTERN (0x55)
+
+_Static_assert(EXT_SRAM_MEM_SIZE <= (1UL << (SRAM_TEST_ADDRESS_CELLS_MAX - 1)) * 2,
+               "too few address test cells for the external SRAM");
+
+static bool m_check(uint16_t offset, uint8_t expected, uint16_t *p_fault_offset)
+{
+    if (SRAM_TEST_READ(offset) == expected)
+    {
+        return true;
+    }
+    if (p_fault_offset)
+    {
+        *p_fault_offset = offset;
+    }
+    return false;
+}
+
+// March C-: up(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); up(r0)
+static bool m_march_c(uint16_t offset, uint8_t len, uint16_t *p_fault_offset)
+{
+    uint8_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        SRAM_TEST_WRITE(offset + i, 0x00);
+    }
+    for (i = 0; i < len; i++)
+    {
+        if (!m_check(offset + i, 0x00, p_fault_offset)) return false;
+        SRAM_TEST_WRITE(offset + i, 0xFF);
+    }
+    for (i = 0; i < len; i++)
+    {
+        if (!m_check(offset + i, 0xFF, p_fault_offset)) return false;
+        SRAM_TEST_WRITE(offset + i, 0x00);
+    }
+    for (i = len; i-- > 0;)
+    {
+        if (!m_check(offset + i, 0x00, p_fault_offset)) return false;
+        SRAM_TEST_WRITE(offset + i, 0xFF);
+    }
+    for (i = len; i-- > 0;)
+    {
+        if (!m_check(offset + i, 0xFF, p_fault_offset)) return false;
+        SRAM_TEST_WRITE(offset + i, 0x00);
+    }
+    for (i = 0; i < len; i++)
+    {
+        if (!m_check(offset + i, 0x00, p_fault_offset)) return false;
+    }
+
+    return true;
+}
+
+static bool m_checkerboard(uint16_t offset, uint8_t len, uint16_t *p_fault_offset)
+{
+    for (uint8_t inv = 0; inv < 2; inv++)
+    {
+        for (uint8_t i = 0; i < len; i++)
+        {
+            SRAM_TEST_WRITE(offset + i, M_CHECKER(offset + i, inv));
+        }
+        for (uint8_t i = 0; i < len; i++)
+        {
+            if (!m_check(offset + i, M_CHECKER(offset + i, inv), p_fault_offset)) return false;
+        }
+    }
+
+    return true;
+}
+
+static uint8_t m_address_cell_count(uint16_t len)
+{
+    uint8_t count = 1;
+
+    while (count < SRAM_TEST_ADDRESS_CELLS_MAX && SRAM_TEST_ADDRESS_CELL(count) < len)
+    {
+        count++;
+    }
+    return count;
+}
+
+// Walking address bit: cell 0 and each power-of-two cell are written in turn
+// with the antipattern while all the other cells must keep the pattern. An
+// address line stuck high or low, or shorted to another, makes two cells
+// alias and one of them read back wrong.
+static bool m_address(uint16_t offset, uint8_t count, uint16_t *p_fault_offset)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        SRAM_TEST_WRITE(offset + SRAM_TEST_ADDRESS_CELL(i), M_ADDR_PATTERN);
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        SRAM_TEST_WRITE(offset + SRAM_TEST_ADDRESS_CELL(i), M_ADDR_ANTIPATTERN);
+        for (uint8_t j = 0; j < count; j++)
+        {
+            if (j != i &&
+                !m_check(offset + SRAM_TEST_ADDRESS_CELL(j), M_ADDR_PATTERN, p_fault_offset))
+            {
+                return false;
+            }
+        }
+        if (!m_check(offset + SRAM_TEST_ADDRESS_CELL(i), M_ADDR_ANTIPATTERN, p_fault_offset))
+        {
+            return false;
+        }
+        SRAM_TEST_WRITE(offset + SRAM_TEST_ADDRESS_CELL(i), M_ADDR_PATTERN);
+    }
+
+    return true;
+}
+
+bool sram_test_address(uint16_t offset, uint16_t len, uint16_t *p_fault_offset)
+{
+    uint8_t saved[SRAM_TEST_ADDRESS_CELLS_MAX];
+
+    if (len == 0 || offset >= EXT_SRAM_MEM_SIZE || len > EXT_SRAM_MEM_SIZE - offset)
+    {
+        return false;
+    }
+
+    uint8_t count = m_address_cell_count(len);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        saved[i] = SRAM_TEST_READ(offset + SRAM_TEST_ADDRESS_CELL(i));
+    }
+
+    bool ok = m_address(offset, count, p_fault_offset);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        SRAM_TEST_WRITE(offset + SRAM_TEST_ADDRESS_CELL(i), saved[i]);
+    }
+
+    return ok;
+}
+
+bool sram_test_block(uint16_t offset, uint8_t len, uint16_t *p_fault_offset)
+{
+    uint8_t saved[SRAM_TEST_BLOCK_MAX];
+
+    if (len > SRAM_TEST_BLOCK_MAX || offset + len > EXT_SRAM_MEM_SIZE)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        saved[i] = SRAM_TEST_READ(offset + i);
+    }
+
+    bool ok = m_march_c(offset, len, p_fault_offset) &&
+              m_checkerboard(offset, len, p_fault_offset);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        SRAM_TEST_WRITE(offset + i, saved[i]);
+    }
+
+    return ok;
+}
+
+bool sram_test_init(sram_test_t *p_test, uint16_t offset, uint16_t len)
+{
+    if (!p_test || len == 0 || offset >= EXT_SRAM_MEM_SIZE || len > EXT_SRAM_MEM_SIZE - offset)
+    {
+        return false;
+    }
+
+    memset(p_test, 0, sizeof(*p_test));
+    p_test->start = offset;
+    p_test->len = len;
+
+    return true;
+}
+
+// Address test across the whole region at the start of a pass
+static void m_step_address(sram_test_t *p_test)
+{
+    sram_test_result_t *p_result = &p_test->result;
+    uint16_t fault_offset;
+
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t start = profiler_cycles_get();
+    bool ok = sram_test_address(p_test->start, p_test->len, &fault_offset);
+    p_result->cycles += profiler_cycles_get() - start;
+    SREG = sreg;
+
+    if (!ok)
+    {
+        p_result->address_fault_addr = EXT_SRAM_MEM_START + fault_offset;
+        if (p_result->address_fault_count < UINT16_MAX)
+        {
+            p_result->address_fault_count++;
+        }
+    }
+}
+
+bool sram_test_step(sram_test_t *p_test, uint16_t bytes)
+{
+    if (!p_test || p_test->len == 0)
+    {
+        return false;
+    }
+
+    sram_test_result_t *p_result = &p_test->result;
+    bool pass_done = false;
+    uint16_t tested = 0;
+
+    while (tested < bytes)
+    {
+        if (p_test->cursor == 0)
+        {
+            m_step_address(p_test);
+        }
+
+        uint16_t left = p_test->len - p_test->cursor;
+        uint8_t len = left < SRAM_TEST_BLOCK_MAX ? left : SRAM_TEST_BLOCK_MAX;
+        uint16_t offset = p_test->start + p_test->cursor;
+        uint16_t fault_offset;
+
+        uint8_t sreg = SREG;
+        cli();
+        uint32_t start = profiler_cycles_get();
+        bool ok = sram_test_block(offset, len, &fault_offset);
+        p_result->cycles += profiler_cycles_get() - start;
+        SREG = sreg;
+
+        if (!ok)
+        {
+            if (p_result->fault_count < SRAM_TEST_MAX_FAULTS)
+            {
+                p_result->fault_addr[p_result->fault_count] = EXT_SRAM_MEM_START + fault_offset;
+            }
+            if (p_result->fault_count < UINT16_MAX)
+            {
+                p_result->fault_count++;
+            }
+        }
+
+        p_result->bytes_tested += len;
+        tested += len;
+        p_test->cursor += len;
+        if (p_test->cursor == p_test->len)
+        {
+            p_test->cursor = 0;
+            p_result->pass_count++;
+            pass_done = true;
+        }
+    }
+
+    p_result->bytes_per_s = p_result->cycles ?
+        (uint32_t) (((uint64_t) p_result->bytes_tested * F_CPU) / p_result->cycles) : 0;
+
+    return pass_done;
+}
+
+bool sram_test_run(uint16_t offset, uint16_t len, sram_test_result_t *p_result_out)
+{
+    sram_test_t test;
+
+    assert(p_result_out);
+
+    if (!sram_test_init(&test, offset, len))
+    {
+        return false;
+    }
+    (void) sram_test_step(&test, len);
+
+    *p_result_out = test.result;
+
+    return test.result.fault_count == 0 && test.result.address_fault_count == 0;
 }
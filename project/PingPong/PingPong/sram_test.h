@@ -1,4 +1,74 @@
-// Boilerplate test driver for the SRAM chip.
-// Displays read/write failures
+/*
+ * Non-destructive external SRAM self-test.
+ *
+ * The region under test is checked one block at a time with a March C-
+ * sequence followed by a checkerboard. Each block is saved to internal RAM
+ * and restored, with interrupts disabled, so the test can run while the
+ * memory is in use. Run a region in one go with sram_test_run(), or spread
+ * it over the main loop with sram_test_step().
+ *
+ * The blocks are too small to see the upper address lines, so each pass
+ * starts with an address test over the whole region: a walking bit over the
+ * cells at the start of the region and at every power-of-two offset from it,
+ * which finds address lines that are stuck or shorted and make two parts of
+ * the region alias.
+ */
+#ifndef SRAM_TEST_H__
+#define SRAM_TEST_H__
 
-void SRAM_test(void);
+#include <stdint.h>
+#include <stdbool.h>
+
+// Largest block tested with interrupts disabled, about 0.3 ms at F_CPU
+#define SRAM_TEST_BLOCK_MAX (16)
+// Fault addresses kept in the result
+#define SRAM_TEST_MAX_FAULTS (4)
+// Cells of the address test, enough for a region of 2 KB: the first byte
+// and the bytes at offsets 1, 2, 4, ... 1024 from it
+#define SRAM_TEST_ADDRESS_CELLS_MAX (12)
+#define SRAM_TEST_ADDRESS_CELL(i) ((i) == 0 ? 0 : (uint16_t) (1u << ((i) - 1)))
+
+typedef struct
+{
+    // Bytes tested and the cycles spent on them, over all passes
+    uint32_t bytes_tested;
+    uint32_t cycles;
+    // Test throughput, excluding time between steps
+    uint32_t bytes_per_s;
+    // Complete passes over the region
+    uint16_t pass_count;
+    // Blocks with a fault and the address of the first fault in each of the
+    // first SRAM_TEST_MAX_FAULTS of them
+    uint16_t fault_count;
+    uint16_t fault_addr[SRAM_TEST_MAX_FAULTS];
+    // Passes whose address test failed and the address of the last fault
+    uint16_t address_fault_count;
+    uint16_t address_fault_addr;
+} sram_test_result_t;
+
+typedef struct
+{
+    uint16_t start;
+    uint16_t len;
+    // Next offset to test, relative to start
+    uint16_t cursor;
+    sram_test_result_t result;
+} sram_test_t;
+
+// Prepare a test of `len` bytes of the external SRAM from `offset`
+bool sram_test_init(sram_test_t *p_test, uint16_t offset, uint16_t len);
+// Test at least `bytes` more bytes, wrapping around at the end of the region.
+// Returns true if a pass over the region was completed.
+bool sram_test_step(sram_test_t *p_test, uint16_t bytes);
+// Test a region once. Returns true if no fault was found.
+bool sram_test_run(uint16_t offset, uint16_t len, sram_test_result_t *p_result_out);
+// Test one block of at most SRAM_TEST_BLOCK_MAX bytes. The contents are
+// restored, but interrupts are left as they are, so disable them if an
+// interrupt handler may use the block. On a fault, the offset of the first
+// faulty byte is stored in `p_fault_offset` if it is not NULL.
+bool sram_test_block(uint16_t offset, uint8_t len, uint16_t *p_fault_offset);
+// Address test of a region, restoring the cells it uses. Interrupts are left
+// as they are, as for sram_test_block().
+bool sram_test_address(uint16_t offset, uint16_t len, uint16_t *p_fault_offset);
+
+#endif /* SRAM_TEST_H__ */
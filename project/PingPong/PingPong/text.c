@@ -0,0 +1,158 @@
+/*
+ * Text rendering with the fonts in fonts.h.
+ *
+ * This is the only user of fonts.h; the font tables are defined in the
+ * header, so including it anywhere else would duplicate them in flash.
+ */
+
+#include "text.h"
+#include "fonts.h"
+#include "oled.h"
+#include "ping_pong.h"
+
+#define M_FIRST_CHAR   (' ')
+#define M_INVALID_CHAR ('?')
+
+#define M_OLED_WIDTH (128)
+
+typedef struct
+{
+    const unsigned char * p_glyphs;
+    uint8_t width;
+} m_font_t;
+
+static const m_font_t m_fonts[TEXT_FONT_COUNT] = {
+    [TEXT_FONT_SMALL]  = { .p_glyphs = &font4[0][0], .width = NUMELTS(font4[0]) },
+    [TEXT_FONT_NORMAL] = { .p_glyphs = &font5[0][0], .width = NUMELTS(font5[0]) },
+    [TEXT_FONT_LARGE]  = { .p_glyphs = &font8[0][0], .width = NUMELTS(font8[0]) },
+};
+
+uint8_t text_font_width(text_font_t font)
+{
+    assert(font < TEXT_FONT_COUNT);
+
+    return m_fonts[font].width;
+}
+
+uint16_t text_measure(text_font_t font, const char *s)
+{
+    assert(s);
+
+    return (uint16_t) strlen(s) * text_font_width(font);
+}
+
+uint8_t text_glyph_get(text_font_t font, char c, uint8_t *p_out)
+{
+    assert(font < TEXT_FONT_COUNT);
+
+    uint8_t index = (uint8_t) c - M_FIRST_CHAR;
+    if (index >= NUM_LETTERS_IN_FONT)
+    {
+        index = M_INVALID_CHAR - M_FIRST_CHAR;
+    }
+
+    const m_font_t *p_font = &m_fonts[font];
+    memcpy_P(p_out, &p_font->p_glyphs[(uint16_t) index * p_font->width], p_font->width);
+
+    return p_font->width;
+}
+
+int16_t text_fb_draw(const gfx_fb_t *p_fb, const text_window_t *p_clip, int16_t x, int16_t y,
+                     text_font_t font, const char *s, gfx_color_t color)
+{
+    assert(p_fb);
+    assert(s);
+
+    text_window_t clip = { 0, 0, p_fb->width, GFX_FB_HEIGHT(p_fb) };
+    if (p_clip)
+    {
+        clip = *p_clip;
+    }
+
+    uint8_t width = text_font_width(font);
+    int16_t clip_x1 = clip.x + clip.w;
+
+    // Rows of the glyph that fall inside the window
+    uint8_t row_mask = 0xFF;
+    for (uint8_t row = 0; row < 8; row++)
+    {
+        if (y + row < clip.y || y + row >= clip.y + clip.h)
+        {
+            row_mask &= ~(1 << row);
+        }
+    }
+
+    for (; *s; s++, x += width)
+    {
+        if (x >= clip_x1 || row_mask == 0)
+        {
+            // Nothing more will be visible, only advance the pen
+            x += (int16_t) strlen(s) * width;
+            break;
+        }
+        if (x + width <= clip.x)
+        {
+            continue;
+        }
+
+        uint8_t glyph[TEXT_GLYPH_MAX_WIDTH];
+        (void) text_glyph_get(font, *s, glyph);
+
+        uint8_t first = x < clip.x ? clip.x - x : 0;
+        uint8_t last = x + width > clip_x1 ? clip_x1 - x : width;
+        for (uint8_t i = first; i < last; i++)
+        {
+            glyph[i] &= row_mask;
+        }
+
+        gfx_bitmap_t bitmap = { .p_data = &glyph[first], .width = last - first, .height = 8 };
+        gfx_blit(p_fb, x + first, y, &bitmap, color);
+    }
+
+    return x;
+}
+
+int16_t text_oled_draw(uint8_t page, int16_t x, uint8_t clip_x0, uint8_t clip_x1,
+                       text_font_t font, const char *s, bool inv)
+{
+    assert(s);
+    assert(clip_x1 <= M_OLED_WIDTH);
+
+    uint8_t width = text_font_width(font);
+    uint8_t mask = inv ? 0xFF : 0x00;
+    bool positioned = false;
+
+    for (; *s; s++, x += width)
+    {
+        if (x >= clip_x1)
+        {
+            x += (int16_t) strlen(s) * width;
+            break;
+        }
+        if (x + width <= clip_x0)
+        {
+            continue;
+        }
+
+        uint8_t glyph[TEXT_GLYPH_MAX_WIDTH];
+        (void) text_glyph_get(font, *s, glyph);
+
+        uint8_t first = x < clip_x0 ? clip_x0 - x : 0;
+        uint8_t last = x + width > clip_x1 ? clip_x1 - x : width;
+        for (uint8_t i = first; i < last; i++)
+        {
+            glyph[i] ^= mask;
+        }
+
+        // The display advances its column by itself, so the visible glyphs
+        // follow each other without repositioning
+        if (!positioned)
+        {
+            oled_pos(page, x + first);
+            positioned = true;
+        }
+        oled_data_write(&glyph[first], last - first);
+    }
+
+    return x;
+}
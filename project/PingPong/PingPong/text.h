@@ -0,0 +1,54 @@
+/*
+ * Text rendering with the fonts in fonts.h.
+ *
+ * Glyphs are one page (8 pixels) high and a fixed number of columns wide,
+ * including the spacing column. Each glyph is fetched from flash with a
+ * single memcpy_P() burst and then streamed to a framebuffer or straight to
+ * the OLED, clipped to a window. Characters outside the font are drawn as '?'.
+ */
+#ifndef TEXT_H__
+#define TEXT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gfx.h"
+
+typedef enum
+{
+    TEXT_FONT_SMALL = 0, // 4x7
+    TEXT_FONT_NORMAL,    // 5x7
+    TEXT_FONT_LARGE,     // 8x8
+    TEXT_FONT_COUNT
+} text_font_t;
+
+#define TEXT_GLYPH_MAX_WIDTH (8)
+
+// Clip window in pixels
+typedef struct
+{
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+} text_window_t;
+
+// Width of every glyph of a font, in columns
+uint8_t text_font_width(text_font_t font);
+// Width of a string in pixels
+uint16_t text_measure(text_font_t font, const char *s);
+// Copy the columns of a glyph to `p_out` (TEXT_GLYPH_MAX_WIDTH bytes).
+// Returns the glyph width.
+uint8_t text_glyph_get(text_font_t font, char c, uint8_t *p_out);
+
+// Draw the set pixels of `s` with its top left corner at (x, y), clipped to
+// `p_clip` (NULL for the whole framebuffer). Returns the x position after
+// the last glyph, whether it was clipped or not.
+int16_t text_fb_draw(const gfx_fb_t *p_fb, const text_window_t *p_clip, int16_t x, int16_t y,
+                     text_font_t font, const char *s, gfx_color_t color);
+// Write `s` directly to a display page from column x, clipped to the columns
+// [clip_x0, clip_x1). Only the visible columns go over the bus, in a single
+// run. Returns the x position after the last glyph.
+int16_t text_oled_draw(uint8_t page, int16_t x, uint8_t clip_x0, uint8_t clip_x1,
+                       text_font_t font, const char *s, bool inv);
+
+#endif /* TEXT_H__ */
@@ -0,0 +1,43 @@
+/*
+ * Millisecond system tick on Timer0.
+ */
+
+#include <avr/interrupt.h>
+#include "ping_pong.h"
+#include "timer.h"
+
+// clk/64 with a compare value of 76 gives 76800 / 77 = 997 Hz, i.e. a tick
+// every 1.003 ms. Close enough for task periods.
+#define M_TIMER0_CLK_DIV (_BV(CS01) | _BV(CS00))
+#define M_TIMER0_TOP     ((uint8_t) (((F_CPU / 64) + 500) / 1000 - 1))
+
+static volatile uint32_t m_ms_count;
+
+ISR(TIMER0_COMP_vect)
+{
+    m_ms_count++;
+}
+
+bool timer_init(void)
+{
+    m_ms_count = 0;
+
+    // CTC mode, interrupt on compare match
+    TCCR0 = _BV(WGM01) | M_TIMER0_CLK_DIV;
+    OCR0 = M_TIMER0_TOP;
+    TCNT0 = 0;
+    TIFR = _BV(OCF0);
+    TIMSK |= _BV(OCIE0);
+
+    return true;
+}
+
+uint32_t timer_ms_get(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ms = m_ms_count;
+    SREG = sreg;
+
+    return ms;
+}
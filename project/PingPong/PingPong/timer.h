@@ -0,0 +1,14 @@
+/*
+ * Millisecond system tick on Timer0.
+ */
+#ifndef TIMER_H__
+#define TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool timer_init(void);
+// Milliseconds since timer_init()
+uint32_t timer_ms_get(void);
+
+#endif /* TIMER_H__ */
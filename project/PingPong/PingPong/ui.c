@@ -6,63 +6,240 @@
  */ 
 
 #include "ui.h"
+#include "anim.h"
+#include "menu_bitmaps.h"
 #include "oled.h"
+#include "oled_console.h"
 #include "ping_pong.h"
+#include "profiler.h"
+#include "timer.h"
 #include <stdlib.h>
 
-static ui_submenu_t m_final_menu = {
+/* Main menu option that opens the game screen */
+#define M_PLAY_GAME_OPTION (0)
+/* Main menu option that starts the animation */
+#define M_RUN_ANIMATION_OPTION (1)
+/* Main menu option that shows the console */
+#define M_CONSOLE_OPTION (2)
+
+/* Game screen layout: value column and row of each field */
+#define M_HUD_VALUE_COL  (32)
+#define M_HUD_SCORE_ROW  (2)
+#define M_HUD_LIVES_ROW  (3)
+#define M_HUD_TIME_ROW   (4)
+#define M_HUD_SERVO_ROW  (5)
+#define M_HUD_STATUS_ROW (7)
+
+typedef enum
+{
+	M_HUD_STATUS_WAITING = 0,
+	M_HUD_STATUS_LOST,
+	M_HUD_STATUS_GAME, // the game state from the frame
+} m_hud_status_t;
+
+/* Menus and their strings live in program memory, see ui_submenu_t */
+static const char m_final_option_0[] PROGMEM = "(1) :(";
+
+static const ui_submenu_t m_final_menu PROGMEM = {
 	.num_submenu_options = 1,
-	.submenu_options[0] = "(1) :(",
+	.submenu_options[0] = m_final_option_0,
 };
 
-static ui_submenu_t m_next_menu = {
+static const char m_next_option_0[] PROGMEM = "(1) WELCOME TO THE SUBMENU";
+static const char m_next_option_1[] PROGMEM = "(2) EXIT";
+
+static const ui_submenu_t m_next_menu PROGMEM = {
 	.num_submenu_options = 2,
-	.submenu_options[0]  = "(1) WELCOME TO THE SUBMENU",
-	.submenu_options[1]  = "(2) EXIT",
+	.submenu_options[0]  = m_next_option_0,
+	.submenu_options[1]  = m_next_option_1,
 	.next[1]             = &m_final_menu,
 };
 
-static ui_submenu_t m_main_menu = {
+static const char m_main_option_0[] PROGMEM = "(1) PLAY GAME";
+static const char m_main_option_1[] PROGMEM = "(2) RUN ANIMATION";
+static const char m_main_option_2[] PROGMEM = "(3) CONSOLE";
+static const char m_main_option_3[] PROGMEM = "(4) LAUNCH THE NUKES";
+static const char m_main_option_4[] PROGMEM = "(5) EXIT";
+
+static const ui_submenu_t m_main_menu PROGMEM = {
 	.num_submenu_options = 5,
-	.submenu_options[0]  = "(1) PLAY GAME",
-	.submenu_options[1]  = "(2) RUN ANIMATION",
-	.submenu_options[2]  = "(3) PLAY WITH FIRE",
-	.submenu_options[3]  = "(4) LAUNCH THE NUKES",
-	.submenu_options[4]  = "(5) EXIT",
+	.submenu_options[0]  = m_main_option_0,
+	.submenu_options[1]  = m_main_option_1,
+	.submenu_options[2]  = m_main_option_2,
+	.submenu_options[3]  = m_main_option_3,
+	.submenu_options[4]  = m_main_option_4,
 	.next[3]             = &m_next_menu,
 };
 
 static uint8_t m_current_selection;
-static ui_submenu_t *mp_current_menu;
+static const ui_submenu_t *mp_current_menu;
 
-void m_update_display(void)
+/* What the display shows, so that moving the selection only redraws two rows */
+static const ui_submenu_t *mp_drawn_menu;
+static uint8_t m_drawn_selection;
+
+static bool m_game_screen;
+static bool m_anim_screen;
+static bool m_console_screen;
+static ui_game_cmd_handler_t m_game_cmd_handler;
+
+/* Latest frame received, and the one the game screen currently shows */
+static game_frame_t m_game_frame;
+static bool m_game_frame_valid;
+static uint32_t m_game_frame_ms;
+static game_frame_t m_hud_frame;
+static m_hud_status_t m_hud_status;
+static game_state_t m_hud_game_state;
+static bool m_hud_drawn;
+static bool m_hud_status_drawn;
+static uint32_t m_hud_refresh_ms;
+
+/* Returns a string in program memory */
+static const char * m_game_state_to_str(game_state_t state)
+{
+	switch (state)
+	{
+		case GAME_STATE_IDLE:
+			return PSTR("READY");
+		case GAME_STATE_PLAYING:
+			return PSTR("PLAYING");
+		case GAME_STATE_GOAL:
+			return PSTR("GOAL!");
+		case GAME_STATE_GAME_OVER:
+			return PSTR("GAME OVER");
+		default:
+			return PSTR("");
+	}
+}
+
+static uint8_t m_menu_option_count_get(const ui_submenu_t *p_menu)
+{
+	return pgm_read_byte(&p_menu->num_submenu_options);
+}
+
+static const char * m_menu_option_get(const ui_submenu_t *p_menu, uint8_t option)
+{
+	return pgm_read_ptr(&p_menu->submenu_options[option]);
+}
+
+static const ui_submenu_t * m_menu_next_get(const ui_submenu_t *p_menu, uint8_t option)
+{
+	return pgm_read_ptr(&p_menu->next[option]);
+}
+
+/* Draw the static parts of the game screen; the fields follow on refresh */
+static void m_draw_game_screen(void)
 {
 	oled_reset();
+	mp_drawn_menu = NULL;
+
+	oled_goto_line(0);
+	oled_printf_P(PSTR("PING PONG     < TO EXIT"), true);
+	oled_goto_line(M_HUD_SCORE_ROW);
+	oled_printf_P(PSTR("SCORE"), false);
+	oled_goto_line(M_HUD_LIVES_ROW);
+	oled_printf_P(PSTR("LIVES"), false);
+	oled_goto_line(M_HUD_TIME_ROW);
+	oled_printf_P(PSTR("TIME"), false);
+	oled_goto_line(M_HUD_SERVO_ROW);
+	oled_printf_P(PSTR("SERVO"), false);
+
+	m_hud_drawn = false;
+	m_hud_status_drawn = false;
+	m_hud_refresh_ms = timer_ms_get() - UI_HUD_REFRESH_MS;
+}
+
+/* Draw one menu row from its pre-rendered bitmap, or with the font if the
+   string has none (e.g. menu_bitmaps.h was not regenerated) */
+static void m_draw_menu_row(uint8_t row)
+{
+	const char *p_text_P = m_menu_option_get(mp_current_menu, row);
+	bool selected = (row == m_current_selection);
+	char text[MAX_MENU_LINE_SIZE + 1];
+
+	strncpy_P(text, p_text_P, MAX_MENU_LINE_SIZE);
+	text[MAX_MENU_LINE_SIZE] = '\0';
 
-	/* Print out current menu to OLED display -- always assume it has changed for now */
-	for (uint8_t i = 0; i < mp_current_menu->num_submenu_options; i++)
+	for (uint8_t i = 0; i < MENU_BITMAP_COUNT; i++)
 	{
-		oled_goto_line(i);
-		oled_printf(mp_current_menu->submenu_options[i], (i == m_current_selection));
+		menu_bitmap_t bitmap;
+		memcpy_P(&bitmap, &menu_bitmaps[i], sizeof(bitmap));
+
+		if (strcmp_P(text, bitmap.p_text) == 0)
+		{
+			oled_blit_P(row, 0, bitmap.p_bitmap, bitmap.width, selected);
+			return;
+		}
 	}
+
+	oled_goto_line(row);
+	oled_printf_P(p_text_P, selected);
+}
+
+void m_update_display(void)
+{
+	if (m_game_screen)
+	{
+		m_draw_game_screen();
+		return;
+	}
+	if (m_anim_screen || m_console_screen)
+	{
+		/* The animation and the console draw the whole screen themselves */
+		mp_drawn_menu = NULL;
+		return;
+	}
+
+	uint32_t probe_start = profiler_probe_begin();
+
+	if (mp_drawn_menu == mp_current_menu)
+	{
+		/* Same menu: only the old and the new selection change */
+		if (m_drawn_selection != m_current_selection)
+		{
+			m_draw_menu_row(m_drawn_selection);
+			m_draw_menu_row(m_current_selection);
+		}
+	}
+	else
+	{
+		oled_reset();
+
+		for (uint8_t i = 0; i < m_menu_option_count_get(mp_current_menu); i++)
+		{
+			m_draw_menu_row(i);
+		}
+	}
+
+	mp_drawn_menu = mp_current_menu;
+	m_drawn_selection = m_current_selection;
+
+	profiler_probe_end(PROFILER_PROBE_UI_UPDATE, probe_start);
 }
 
 
 bool ui_init(void)
 {
-	assert(oled_init());
-	assert(NUMELTS(m_main_menu.submenu_options) <= m_main_menu.num_submenu_options);
-	assert(m_main_menu.num_submenu_options <= MAX_SUBMENU_OPTIONS);
+	if (!oled_init() || !anim_init() || !oled_console_init())
+	{
+		return false;
+	}
+	assert(m_menu_option_count_get(&m_main_menu) <= MAX_SUBMENU_OPTIONS);
 
 	m_current_selection = 0;
 	mp_current_menu = &m_main_menu;
+	m_game_screen = false;
+	m_anim_screen = false;
+	m_console_screen = false;
+	mp_drawn_menu = NULL;
+	m_game_frame_valid = false;
 
 	return true;
 }
 
 void m_ui_go_up(void)
 {
-	if (m_current_selection < (mp_current_menu->num_submenu_options - 1))
+	if (m_current_selection < (m_menu_option_count_get(mp_current_menu) - 1))
 	{
 		m_current_selection++;
 	}
@@ -78,22 +255,69 @@ void m_ui_go_down(void)
 
 void m_ui_enter(void)
 {
-	if (mp_current_menu->next)
+	if (mp_current_menu == &m_main_menu && m_current_selection == M_PLAY_GAME_OPTION)
+	{
+		m_game_screen = true;
+		if (m_game_cmd_handler)
+		{
+			m_game_cmd_handler(GAME_CMD_START);
+		}
+		return;
+	}
+	if (mp_current_menu == &m_main_menu && m_current_selection == M_RUN_ANIMATION_OPTION)
 	{
-		ui_submenu_t *p_next_submenu = mp_current_menu->next[m_current_selection];
+		/* Stays in the menu if there is no memory for the framebuffers */
+		m_anim_screen = anim_start();
+		return;
+	}
+	if (mp_current_menu == &m_main_menu && m_current_selection == M_CONSOLE_OPTION)
+	{
+		m_console_screen = true;
+		oled_console_show(true);
+		return;
+	}
+
+	const ui_submenu_t *p_next_submenu = m_menu_next_get(mp_current_menu, m_current_selection);
+
+	if (p_next_submenu)
+	{
+		mp_current_menu = p_next_submenu;
+	}
+
+	/* Reset "cursor" to the top of the menu options */
+	m_current_selection = 0;
+}
 
-		if (p_next_submenu)
+void m_ui_exit(void)
+{
+	if (m_game_screen)
+	{
+		m_game_screen = false;
+		if (m_game_cmd_handler)
 		{
-			mp_current_menu = p_next_submenu;
+			m_game_cmd_handler(GAME_CMD_ABORT);
 		}
-		
-		/* Reset "cursor" to the top of the menu options */
-		m_current_selection = 0;
+	}
+	if (m_anim_screen)
+	{
+		m_anim_screen = false;
+		anim_stop();
+	}
+	if (m_console_screen)
+	{
+		m_console_screen = false;
+		oled_console_show(false);
 	}
 }
 
 void ui_issue_cmd(ui_cmd_t cmd)
 {
+	/* Only exiting is possible from the game, animation and console screens */
+	if ((m_game_screen || m_anim_screen || m_console_screen) && cmd != UI_EXIT && cmd != UI_DO_NOTHING)
+	{
+		return;
+	}
+
 	switch(cmd)
 	{
 		case(UI_DO_NOTHING):
@@ -107,10 +331,104 @@ void ui_issue_cmd(ui_cmd_t cmd)
 		case(UI_ENTER_SUBMENU):
 			m_ui_enter();
 			break;
+		case(UI_EXIT):
+			m_ui_exit();
+			break;
 		default:
 			assert(false);
 			break;
 	}
 	
 	m_update_display();
+}
+
+void ui_game_cmd_handler_set(ui_game_cmd_handler_t handler)
+{
+	m_game_cmd_handler = handler;
+}
+
+void ui_game_frame_set(const game_frame_t *p_frame)
+{
+	m_game_frame = *p_frame;
+	m_game_frame_valid = true;
+	m_game_frame_ms = timer_ms_get();
+}
+
+void ui_game_refresh(void)
+{
+	uint32_t now = timer_ms_get();
+
+	if (!m_game_screen || now - m_hud_refresh_ms < UI_HUD_REFRESH_MS)
+	{
+		return;
+	}
+	m_hud_refresh_ms = now;
+
+	uint32_t probe_start = profiler_probe_begin();
+
+	m_hud_status_t status = M_HUD_STATUS_GAME;
+	if (!m_game_frame_valid)
+	{
+		status = M_HUD_STATUS_WAITING;
+	}
+	else if (now - m_game_frame_ms > UI_HUD_TIMEOUT_MS)
+	{
+		status = M_HUD_STATUS_LOST;
+	}
+
+	/* Fixed-width fields overwrite the previous value in place */
+	if (m_game_frame_valid)
+	{
+		const game_frame_t *p_frame = &m_game_frame;
+
+		if (!m_hud_drawn || p_frame->score != m_hud_frame.score)
+		{
+			oled_pos(M_HUD_SCORE_ROW, M_HUD_VALUE_COL);
+			oled_printf_P(PSTR("%5u"), false, p_frame->score);
+		}
+		if (!m_hud_drawn || p_frame->lives != m_hud_frame.lives)
+		{
+			oled_pos(M_HUD_LIVES_ROW, M_HUD_VALUE_COL);
+			oled_printf_P(PSTR("%5u"), false, p_frame->lives);
+		}
+		if (!m_hud_drawn || p_frame->elapsed_ds != m_hud_frame.elapsed_ds)
+		{
+			oled_pos(M_HUD_TIME_ROW, M_HUD_VALUE_COL);
+			oled_printf_P(PSTR("%5u.%u S"), false, p_frame->elapsed_ds / 10, p_frame->elapsed_ds % 10);
+		}
+		if (!m_hud_drawn || p_frame->servo_position != m_hud_frame.servo_position)
+		{
+			oled_pos(M_HUD_SERVO_ROW, M_HUD_VALUE_COL);
+			oled_printf_P(PSTR("%5u"), false, p_frame->servo_position);
+		}
+
+		m_hud_frame = *p_frame;
+	}
+
+	if (!m_hud_status_drawn || status != m_hud_status ||
+	    (status == M_HUD_STATUS_GAME && m_game_frame.state != m_hud_game_state))
+	{
+		oled_clear_line(M_HUD_STATUS_ROW);
+		oled_goto_line(M_HUD_STATUS_ROW);
+		if (status == M_HUD_STATUS_WAITING)
+		{
+			oled_printf_P(PSTR("WAITING FOR NODE2"), false);
+		}
+		else if (status == M_HUD_STATUS_LOST)
+		{
+			oled_printf_P(PSTR("NO SIGNAL FROM NODE2"), false);
+		}
+		else
+		{
+			oled_printf_P(m_game_state_to_str(m_game_frame.state), false);
+		}
+
+		m_hud_status = status;
+		m_hud_game_state = m_game_frame.state;
+		m_hud_status_drawn = true;
+	}
+
+	m_hud_drawn = m_hud_drawn || m_game_frame_valid;
+
+	profiler_probe_end(PROFILER_PROBE_UI_UPDATE, probe_start);
 }
\ No newline at end of file
@@ -11,17 +11,23 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "game_state.h"
 
 #define MAX_SUBMENU_OPTIONS (5)  /* Max number of options in any menu */
 #define MAX_MENU_LINE_SIZE  (32) /* Max number of characters in a row of a menu */
 
+#define UI_HUD_REFRESH_MS   (100) /* Minimum time between game screen redraws */
+#define UI_HUD_TIMEOUT_MS   (500) /* Game state older than this is shown as lost */
+
 typedef struct ui_submenu_t ui_submenu_t;
 
+/* Menus are placed in program memory (PROGMEM), and so are the strings and
+   submenus they point to. Read them with pgm_read_*. */
 struct ui_submenu_t
 {
 	uint8_t num_submenu_options;
 	const char * submenu_options[MAX_SUBMENU_OPTIONS];
-	ui_submenu_t* next[MAX_SUBMENU_OPTIONS];
+	const ui_submenu_t * next[MAX_SUBMENU_OPTIONS];
 };
 
 typedef enum
@@ -30,9 +36,20 @@ typedef enum
 	UI_SELECT_DOWN,
 	UI_SELECT_UP,
 	UI_ENTER_SUBMENU,
+	UI_EXIT,
 } ui_cmd_t;
 
+/* Called when the user starts or leaves the game screen */
+typedef void (*ui_game_cmd_handler_t)(game_cmd_t cmd);
+
 bool ui_init(void);
 void ui_issue_cmd(ui_cmd_t cmd);
+void ui_game_cmd_handler_set(ui_game_cmd_handler_t handler);
+/* Latest game state from Node2. Only stored; the game screen picks it up
+   in ui_game_refresh(). */
+void ui_game_frame_set(const game_frame_t *p_frame);
+/* Redraw the fields of the game screen that changed, at most once every
+   UI_HUD_REFRESH_MS. Does nothing outside the game screen. */
+void ui_game_refresh(void);
 
 #endif /* UI_H_ */
\ No newline at end of file
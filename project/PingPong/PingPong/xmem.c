@@ -0,0 +1,212 @@
+/*
+ * External SRAM arena and pool allocators.
+ */
+
+#include <avr/interrupt.h>
+#include "xmem.h"
+#include "ping_pong.h"
+
+static uint8_t m_heap_mem[XMEM_HEAP_SIZE] XMEM;
+static xmem_arena_t m_heap;
+
+void xmem_arena_init(xmem_arena_t * p_arena, void * p_mem, uint16_t size)
+{
+    assert(p_arena);
+    assert(p_mem);
+
+    p_arena->p_base = p_mem;
+    p_arena->size = size;
+    p_arena->used = 0;
+    p_arena->peak = 0;
+    p_arena->fail_count = 0;
+}
+
+void * xmem_arena_alloc(xmem_arena_t * p_arena, uint16_t size, uint8_t align)
+{
+    assert(p_arena);
+    assert(align != 0 && (align & (align - 1)) == 0);
+
+    void * p_mem = NULL;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    // Pad up to the alignment of the absolute address
+    uint16_t addr = (uint16_t) (uintptr_t) p_arena->p_base + p_arena->used;
+    uint16_t offset = p_arena->used + ((align - (addr & (align - 1))) & (align - 1));
+
+    if (offset <= p_arena->size && size <= p_arena->size - offset)
+    {
+        p_mem = &p_arena->p_base[offset];
+        p_arena->used = offset + size;
+        if (p_arena->used > p_arena->peak)
+        {
+            p_arena->peak = p_arena->used;
+        }
+    }
+    else
+    {
+        p_arena->fail_count++;
+    }
+
+    SREG = sreg;
+
+    return p_mem;
+}
+
+uint16_t xmem_arena_mark(const xmem_arena_t * p_arena)
+{
+    assert(p_arena);
+
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t mark = p_arena->used;
+    SREG = sreg;
+
+    return mark;
+}
+
+void xmem_arena_release(xmem_arena_t * p_arena, uint16_t mark)
+{
+    assert(p_arena);
+
+    uint8_t sreg = SREG;
+    cli();
+    assert(mark <= p_arena->used);
+    p_arena->used = mark;
+    SREG = sreg;
+}
+
+void xmem_arena_stats_get(const xmem_arena_t * p_arena, xmem_stats_t * p_stats_out)
+{
+    assert(p_arena);
+    assert(p_stats_out);
+
+    uint8_t sreg = SREG;
+    cli();
+    p_stats_out->capacity = p_arena->size;
+    p_stats_out->used = p_arena->used;
+    p_stats_out->peak = p_arena->peak;
+    p_stats_out->fail_count = p_arena->fail_count;
+    SREG = sreg;
+}
+
+bool xmem_pool_init(xmem_pool_t * p_pool, void * p_mem, uint8_t block_size, uint8_t block_count)
+{
+    if (!p_pool || !p_mem || block_size < sizeof(void *) || block_count == 0)
+    {
+        return false;
+    }
+
+    p_pool->p_base = p_mem;
+    p_pool->block_size = block_size;
+    p_pool->block_count = block_count;
+    p_pool->used = 0;
+    p_pool->peak = 0;
+    p_pool->fail_count = 0;
+
+    // Thread the free list through the blocks themselves
+    p_pool->p_free = NULL;
+    for (uint8_t i = block_count; i > 0; i--)
+    {
+        void ** p_block = (void **) &p_pool->p_base[(uint16_t) (i - 1) * block_size];
+        *p_block = p_pool->p_free;
+        p_pool->p_free = p_block;
+    }
+
+    return true;
+}
+
+void * xmem_pool_alloc(xmem_pool_t * p_pool)
+{
+    assert(p_pool);
+
+    uint8_t sreg = SREG;
+    cli();
+
+    void ** p_block = p_pool->p_free;
+    if (p_block)
+    {
+        p_pool->p_free = *p_block;
+        p_pool->used++;
+        if (p_pool->used > p_pool->peak)
+        {
+            p_pool->peak = p_pool->used;
+        }
+    }
+    else
+    {
+        p_pool->fail_count++;
+    }
+
+    SREG = sreg;
+
+    return p_block;
+}
+
+void xmem_pool_free(xmem_pool_t * p_pool, void * p_block)
+{
+    assert(p_pool);
+
+    if (!p_block)
+    {
+        return;
+    }
+
+    // Must be the start of a block of this pool
+    uint16_t offset = (uint8_t *) p_block - p_pool->p_base;
+    assert((uint8_t *) p_block >= p_pool->p_base);
+    assert(offset < (uint16_t) p_pool->block_size * p_pool->block_count);
+    assert(offset % p_pool->block_size == 0);
+
+    uint8_t sreg = SREG;
+    cli();
+
+    assert(p_pool->used > 0);
+    *(void **) p_block = p_pool->p_free;
+    p_pool->p_free = p_block;
+    p_pool->used--;
+
+    SREG = sreg;
+}
+
+void xmem_pool_stats_get(const xmem_pool_t * p_pool, xmem_stats_t * p_stats_out)
+{
+    assert(p_pool);
+    assert(p_stats_out);
+
+    uint8_t sreg = SREG;
+    cli();
+    p_stats_out->capacity = p_pool->block_count;
+    p_stats_out->used = p_pool->used;
+    p_stats_out->peak = p_pool->peak;
+    p_stats_out->fail_count = p_pool->fail_count;
+    SREG = sreg;
+}
+
+bool xmem_init(void)
+{
+    xmem_arena_init(&m_heap, m_heap_mem, sizeof(m_heap_mem));
+
+    return true;
+}
+
+xmem_arena_t * xmem_heap_get(void)
+{
+    return &m_heap;
+}
+
+void * xmem_alloc(uint16_t size, uint8_t align)
+{
+    return xmem_arena_alloc(&m_heap, size, align);
+}
+
+uint16_t xmem_mark(void)
+{
+    return xmem_arena_mark(&m_heap);
+}
+
+void xmem_release(uint16_t mark)
+{
+    xmem_arena_release(&m_heap, mark);
+}
@@ -0,0 +1,85 @@
+/*
+ * External SRAM placement and allocators.
+ *
+ * Variables declared with XMEM are placed by the linker in the .xmem section,
+ * which starts at EXT_SRAM_MEM_START (-Wl,--section-start=.xmem=0x801800).
+ * Like .noinit they are not cleared at startup, so initialize them in code.
+ * The section is marked @nobits so it takes no space in the .hex image.
+ *
+ * Two allocators work on top of it, both on memory the caller provides:
+ * - a bump arena for buffers that live until a mark is released, in LIFO
+ *   order (e.g. a framebuffer for the lifetime of a screen), and
+ * - a pool of fixed-size blocks that are freed in any order.
+ * xmem_alloc() allocates from a default arena in external SRAM.
+ *
+ * All functions are interrupt safe.
+ */
+#ifndef XMEM_H__
+#define XMEM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The trailing ';' comments out the flags the compiler appends after the name
+#define XMEM __attribute__((section(".xmem,\"aw\",@nobits;")))
+
+// Size of the default arena
+#define XMEM_HEAP_SIZE (1536)
+
+typedef struct
+{
+    // Arena: bytes. Pool: blocks.
+    uint16_t capacity;
+    uint16_t used;
+    uint16_t peak;
+    // Allocations that failed because the memory was exhausted
+    uint16_t fail_count;
+} xmem_stats_t;
+
+typedef struct
+{
+    uint8_t * p_base;
+    uint16_t size;
+    uint16_t used;
+    uint16_t peak;
+    uint16_t fail_count;
+} xmem_arena_t;
+
+typedef struct
+{
+    uint8_t * p_base;
+    void * p_free;
+    uint8_t block_size;
+    uint8_t block_count;
+    uint8_t used;
+    uint8_t peak;
+    uint16_t fail_count;
+} xmem_pool_t;
+
+void xmem_arena_init(xmem_arena_t * p_arena, void * p_mem, uint16_t size);
+// Allocate `size` bytes aligned to `align`, a power of two. Returns NULL if
+// the arena is exhausted.
+void * xmem_arena_alloc(xmem_arena_t * p_arena, uint16_t size, uint8_t align);
+// Current fill level, to be passed to xmem_arena_release()
+uint16_t xmem_arena_mark(const xmem_arena_t * p_arena);
+// Free everything allocated since `mark` was taken
+void xmem_arena_release(xmem_arena_t * p_arena, uint16_t mark);
+void xmem_arena_stats_get(const xmem_arena_t * p_arena, xmem_stats_t * p_stats_out);
+
+// Split `p_mem` into `block_count` blocks of `block_size` bytes. Blocks must
+// be able to hold a pointer.
+bool xmem_pool_init(xmem_pool_t * p_pool, void * p_mem, uint8_t block_size, uint8_t block_count);
+// Returns NULL if all blocks are in use
+void * xmem_pool_alloc(xmem_pool_t * p_pool);
+void xmem_pool_free(xmem_pool_t * p_pool, void * p_block);
+void xmem_pool_stats_get(const xmem_pool_t * p_pool, xmem_stats_t * p_stats_out);
+
+// Set up the default arena. Requires external SRAM to be enabled.
+bool xmem_init(void);
+xmem_arena_t * xmem_heap_get(void);
+// Shorthands for the default arena
+void * xmem_alloc(uint16_t size, uint8_t align);
+uint16_t xmem_mark(void);
+void xmem_release(uint16_t mark);
+
+#endif /* XMEM_H__ */
@@ -0,0 +1,267 @@
+/*
+ * External memory bus wait state tuning and characterization.
+ */
+
+#include <avr/interrupt.h>
+#include "ping_pong.h"
+#include <util/delay.h>
+#include "ext_peripherals.h"
+#include "oled.h"
+#include "profiler.h"
+#include "sram_test.h"
+#include "xmem_timing.h"
+
+// The OLED and the ADC cannot be read back to verify an access, so their
+// minimum is what they are known to work with: the board ran with no wait
+// states before tuning was added.
+#define M_OLED_MIN_WAIT (XMEM_WAIT_NONE)
+#define M_ADC_MIN_WAIT  (XMEM_WAIT_NONE)
+
+// Full SRAM passes required at a setting before it counts as safe
+#define M_TUNE_PASSES (3)
+
+// Timing used to save and restore the SRAM around a test at another setting
+#define M_SAFE_WAIT (XMEM_WAIT_2_PLUS_1)
+
+#define M_BENCH_PAGE       (7)
+#define M_BENCH_RUNS       (8)
+#define M_ADC_NUM_CH       (4)
+#define M_ADC_CONVERSION_US (50)
+#define M_COPY_LEN         (256)
+
+static xmem_wait_t m_wait;
+static xmem_wait_t m_tuned_wait;
+
+static const char m_wait_names[XMEM_WAIT_COUNT][8] PROGMEM = {
+    [XMEM_WAIT_NONE]     = "0",
+    [XMEM_WAIT_1]        = "1",
+    [XMEM_WAIT_2]        = "2",
+    [XMEM_WAIT_2_PLUS_1] = "2+1",
+};
+
+void xmem_wait_set(xmem_wait_t wait)
+{
+    assert(wait < XMEM_WAIT_COUNT);
+
+    uint8_t sreg = SREG;
+    cli();
+
+    // SRL = 0: the whole external memory is one sector, timed by SRW11:SRW10
+    XMCRA = (XMCRA & ~(_BV(SRL2) | _BV(SRL1) | _BV(SRL0) | _BV(SRW11))) |
+            ((wait & 0x02) ? _BV(SRW11) : 0);
+    MCUCR = (MCUCR & ~_BV(SRW10)) | ((wait & 0x01) ? _BV(SRW10) : 0);
+    m_wait = wait;
+
+    SREG = sreg;
+}
+
+xmem_wait_t xmem_wait_get(void)
+{
+    return m_wait;
+}
+
+// Address test of the whole SRAM at the given wait state, which the blocks
+// of the March test are too small to cover. Its cells are saved and put back
+// at the safe setting, as for the blocks below.
+static bool m_sram_address_pass(xmem_wait_t wait)
+{
+    xmem_wait_t previous = m_wait;
+    uint8_t saved[SRAM_TEST_ADDRESS_CELLS_MAX];
+
+    uint8_t sreg = SREG;
+    cli();
+
+    xmem_wait_set(M_SAFE_WAIT);
+    for (uint8_t i = 0; i < SRAM_TEST_ADDRESS_CELLS_MAX; i++)
+    {
+        saved[i] = EXT_SRAM[SRAM_TEST_ADDRESS_CELL(i)];
+    }
+
+    xmem_wait_set(wait);
+    bool ok = sram_test_address(0, EXT_SRAM_MEM_SIZE, NULL);
+
+    xmem_wait_set(M_SAFE_WAIT);
+    for (uint8_t i = 0; i < SRAM_TEST_ADDRESS_CELLS_MAX; i++)
+    {
+        EXT_SRAM[SRAM_TEST_ADDRESS_CELL(i)] = saved[i];
+    }
+    xmem_wait_set(previous);
+
+    SREG = sreg;
+
+    return ok;
+}
+
+// Address and March test of the whole SRAM at the given wait state. The
+// block test restores each block itself, but at a setting the SRAM may fail
+// at, so the contents are also saved and put back at the safe setting.
+static bool m_sram_pass(xmem_wait_t wait)
+{
+    xmem_wait_t previous = m_wait;
+    uint8_t saved[SRAM_TEST_BLOCK_MAX];
+
+    if (!m_sram_address_pass(wait))
+    {
+        return false;
+    }
+
+    for (uint16_t offset = 0; offset < EXT_SRAM_MEM_SIZE; offset += SRAM_TEST_BLOCK_MAX)
+    {
+        uint8_t sreg = SREG;
+        cli();
+
+        xmem_wait_set(M_SAFE_WAIT);
+        for (uint8_t i = 0; i < SRAM_TEST_BLOCK_MAX; i++)
+        {
+            saved[i] = EXT_SRAM[offset + i];
+        }
+
+        xmem_wait_set(wait);
+        bool ok = sram_test_block(offset, SRAM_TEST_BLOCK_MAX, NULL);
+
+        xmem_wait_set(M_SAFE_WAIT);
+        for (uint8_t i = 0; i < SRAM_TEST_BLOCK_MAX; i++)
+        {
+            EXT_SRAM[offset + i] = saved[i];
+        }
+        xmem_wait_set(previous);
+
+        SREG = sreg;
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fastest wait state at which the SRAM passes, XMEM_WAIT_COUNT if none does
+static xmem_wait_t m_sram_min_wait(void)
+{
+    for (xmem_wait_t wait = XMEM_WAIT_NONE; wait < XMEM_WAIT_COUNT; wait++)
+    {
+        uint8_t passes = 0;
+        while (passes < M_TUNE_PASSES && m_sram_pass(wait))
+        {
+            passes++;
+        }
+        if (passes == M_TUNE_PASSES)
+        {
+            return wait;
+        }
+    }
+
+    return XMEM_WAIT_COUNT;
+}
+
+static xmem_wait_t m_max(xmem_wait_t a, xmem_wait_t b)
+{
+    return a > b ? a : b;
+}
+
+xmem_wait_t xmem_timing_tune(void)
+{
+    xmem_wait_t sram_wait = m_sram_min_wait();
+
+    // A failing SRAM gets the slowest timing rather than none
+    if (sram_wait == XMEM_WAIT_COUNT)
+    {
+        sram_wait = XMEM_WAIT_2_PLUS_1;
+    }
+
+    m_tuned_wait = m_max(sram_wait, m_max(M_OLED_MIN_WAIT, M_ADC_MIN_WAIT));
+    xmem_wait_set(m_tuned_wait);
+
+    return m_tuned_wait;
+}
+
+static uint32_t m_per_s(uint32_t bytes, uint32_t cycles)
+{
+    return cycles ? (uint32_t) (((uint64_t) bytes * F_CPU) / cycles) : 0;
+}
+
+// One page of zeros per run, the same bus traffic as a framebuffer flush
+static uint32_t m_oled_flush_bench(void)
+{
+    static const uint8_t zeros[128];
+    uint32_t cycles = 0;
+
+    for (uint8_t run = 0; run < M_BENCH_RUNS; run++)
+    {
+        uint32_t start = profiler_cycles_get();
+        oled_page_write(M_BENCH_PAGE, 0, zeros, sizeof(zeros));
+        cycles += profiler_cycles_get() - start;
+    }
+
+    return m_per_s((uint32_t) M_BENCH_RUNS * sizeof(zeros), cycles);
+}
+
+// Reading the converted channels, without the conversion time
+static uint32_t m_adc_read_bench(void)
+{
+    volatile uint8_t sink;
+    uint32_t cycles = 0;
+
+    for (uint8_t run = 0; run < M_BENCH_RUNS; run++)
+    {
+        *EXT_ADC = 0;
+        _delay_us(M_ADC_CONVERSION_US);
+
+        uint32_t start = profiler_cycles_get();
+        for (uint8_t ch = 0; ch < M_ADC_NUM_CH; ch++)
+        {
+            sink = *EXT_ADC;
+        }
+        cycles += profiler_cycles_get() - start;
+    }
+    (void) sink;
+
+    return m_per_s((uint32_t) M_BENCH_RUNS * M_ADC_NUM_CH, cycles);
+}
+
+// Read and write back a block, counted as bytes read plus bytes written
+static uint32_t m_sram_copy_bench(void)
+{
+    volatile uint8_t *p_mem = EXT_SRAM;
+    uint32_t cycles = 0;
+
+    for (uint8_t run = 0; run < M_BENCH_RUNS; run++)
+    {
+        // Writing back what was read keeps the contents
+        uint8_t sreg = SREG;
+        cli();
+        uint32_t start = profiler_cycles_get();
+        for (uint16_t i = 0; i < M_COPY_LEN; i++)
+        {
+            p_mem[i] = p_mem[i];
+        }
+        cycles += profiler_cycles_get() - start;
+        SREG = sreg;
+    }
+
+    return m_per_s(2UL * M_BENCH_RUNS * M_COPY_LEN, cycles);
+}
+
+void xmem_timing_report(void)
+{
+    printf_P(PSTR("XMEM wait states, tuned %S\n"), m_wait_names[m_tuned_wait]);
+    printf_P(PSTR("  wait  sram  oled B/s   adc B/s  sram B/s\n"));
+
+    for (xmem_wait_t wait = XMEM_WAIT_NONE; wait < XMEM_WAIT_COUNT; wait++)
+    {
+        bool sram_ok = m_sram_pass(wait);
+        xmem_wait_set(wait);
+        uint32_t oled = m_oled_flush_bench();
+        uint32_t adc = m_adc_read_bench();
+        uint32_t sram = sram_ok ? m_sram_copy_bench() : 0;
+
+        printf_P(PSTR("  %-4S  %-4S %9lu %9lu %9lu\n"), m_wait_names[wait],
+                 sram_ok ? PSTR("ok") : PSTR("FAIL"),
+                 (unsigned long) oled, (unsigned long) adc, (unsigned long) sram);
+    }
+
+    xmem_wait_set(m_tuned_wait);
+    oled_clear_line(M_BENCH_PAGE);
+}
@@ -0,0 +1,36 @@
+/*
+ * External memory bus wait states.
+ *
+ * The OLED (0x1000), the ADC (0x1400) and the SRAM (0x1800) all sit below
+ * 0x2000. The smallest lower sector the ATmega162 supports (SRL = 1) already
+ * covers 0x1100-0x1FFF, so the devices cannot be given different timing.
+ * The bus runs as a single sector with the wait state the slowest device
+ * needs.
+ */
+#ifndef XMEM_TIMING_H__
+#define XMEM_TIMING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    XMEM_WAIT_NONE = 0,
+    XMEM_WAIT_1,        // one cycle during the read/write strobe
+    XMEM_WAIT_2,        // two cycles during the strobe
+    XMEM_WAIT_2_PLUS_1, // two cycles during the strobe, one before the next address
+    XMEM_WAIT_COUNT
+} xmem_wait_t;
+
+void xmem_wait_set(xmem_wait_t wait);
+xmem_wait_t xmem_wait_get(void);
+// Find the fastest wait state at which the SRAM passes a pattern test and
+// apply the slowest of that and what the other devices need. Non-destructive,
+// runs with interrupts disabled. Call after the external memory is enabled.
+xmem_wait_t xmem_timing_tune(void);
+// Print SRAM test results and the OLED flush, ADC read and SRAM copy
+// bandwidth at every wait state, then go back to the tuned setting. Draws
+// over the bottom page of the display.
+void xmem_timing_report(void);
+
+#endif /* XMEM_TIMING_H__ */
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "can_types.h"
+#include "can_bit_timing.h"
 
 #define CAN_BUF_INVALID 0xFF
 
@@ -14,21 +15,66 @@
 #define CAN_ERROR_NOT_SUPPORTED 10
 #define CAN_ERROR_GENERIC 50
 
-/* Message IDs used. */
+/* Message IDs used. Lower IDs win arbitration. */
+/* Buttons: [0] pressed mask, [1] right press count, [2] left press count.
+   The counts wrap and let the receiver detect presses in lost or repeated
+   frames. */
+#define CAN_BUTTON_MSG_ID   (0xC)
+#define CAN_BUTTON_RIGHT_MASK (0x01)
+#define CAN_BUTTON_LEFT_MASK  (0x02)
+/* Latency budget from a button edge on Node1 to the solenoid coil on Node2.
+   The edge waits up to one poll period, the buttons task then queues the
+   frame within its deadline, and the frame may wait for one frame already on
+   the bus before its own. Node2 fires the coil from the receive interrupt
+   within SOLENOID_LATENCY_BUDGET_US (solenoid.h). Node1 counts deadline
+   misses of the buttons task, Node2 traces the last part, and
+   tests/test_solenoid.c walks edges through all of it. */
+#define CAN_BUTTON_LATENCY_BUDGET_US (10000)
+#define CAN_BUTTON_POLL_PERIOD_MS    (5)
+#define CAN_BUTTON_TASK_DEADLINE_MS  (2)
+#define CAN_BUTTON_BUS_BUDGET_US     (2000)
 #define CAN_JOYSTICK_MSG_ID (0xF)
 #define CAN_SLIDER_MSG_ID   (0xE)
+/* Game state broadcast by Node2 and commands to it, see game_state.h */
+#define CAN_GAME_STATE_MSG_ID (0x10)
+#define CAN_GAME_CMD_MSG_ID   (0x11)
+/* Motor PID gains kp, ki, kd: int16 little endian each, in 1/256 */
+#define CAN_MOTOR_GAINS_MSG_ID (0xD)
 
-typedef void (*can_rx_handler_t)(uint8_t rx_buf_no, const can_msg_rx_t * msg);
-typedef void (*can_tx_handler_t)(uint8_t tx_buf_no);
+/* Bus-off recovery backoff: doubles on every bus-off up to the maximum and
+   falls back to the minimum once the node has stayed on the bus for
+   CAN_BUS_OFF_STABLE_MS after a recovery. */
+#define CAN_BUS_OFF_BACKOFF_MIN_MS (100)
+#define CAN_BUS_OFF_BACKOFF_MAX_MS (3200)
+#define CAN_BUS_OFF_STABLE_MS      (5000)
+
+typedef enum
+{
+    CAN_ERROR_STATE_ACTIVE = 0,
+    CAN_ERROR_STATE_WARNING,  // TEC or REC >= 96
+    CAN_ERROR_STATE_PASSIVE,  // TEC or REC >= 128
+    CAN_ERROR_STATE_BUS_OFF,  // TEC > 255, off the bus until recovered
+} can_error_state_t;
 
 typedef struct
 {
-    uint32_t baudrate;
-    uint8_t sync_jump_len;
-    uint8_t prop_seg_len;
-    uint8_t phase_1_len;
-    uint8_t phase_2_len;
-} can_bit_timing_t;
+    can_error_state_t state;
+    // Error counters at the last can_error_poll()
+    can_error_counter_t counters;
+    // Frames lost because the receive buffer still held an unread frame
+    uint16_t rx_overflow_count;
+    // Error frames seen on the bus, sent or received
+    uint16_t bus_error_count;
+    uint16_t bus_off_count;
+    uint16_t recovery_count;
+    // Wait before the next bus-off recovery
+    uint16_t backoff_ms;
+} can_error_stats_t;
+
+typedef void (*can_rx_handler_t)(uint8_t rx_buf_no, const can_msg_rx_t * msg);
+typedef void (*can_tx_handler_t)(uint8_t tx_buf_no);
+// Called from can_error_poll() when the error state has changed
+typedef void (*can_error_handler_t)(can_error_state_t state, const can_error_stats_t * stats);
 
 typedef struct
 {
@@ -42,8 +88,9 @@ typedef struct
     can_rx_handler_t rx_handler;
     // Handler function for transmission complete events
     can_tx_handler_t tx_handler;
+    // Optional handler for error state changes
+    can_error_handler_t error_handler;
     can_buf_cfg_t buf;
-    can_bit_timing_t bit;
 } can_init_t;
 
 // Initialize CAN driver module
@@ -53,4 +100,9 @@ uint8_t can_data_send(uint8_t tx_buf_no, const can_id_t *id, const can_data_t *d
 // Send a CAN remote message (data request)
 uint8_t can_remote_send(uint8_t tx_buf_no, const can_id_t *id);
 
-uint8_t can_get_error_counters(can_error_counter_t * counts);
\ No newline at end of file
+uint8_t can_get_error_counters(can_error_counter_t * counts);
+// Update the error state, run bus-off recovery and call the error handler.
+// Call periodically from the main context.
+void can_error_poll(uint32_t now_ms);
+// Error statistics since can_init()
+void can_error_stats_get(can_error_stats_t * stats);
\ No newline at end of file
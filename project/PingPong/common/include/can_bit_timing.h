@@ -0,0 +1,102 @@
+/*
+ * Compile-time CAN bit timing solver.
+ *
+ * Both nodes must sample the bus at the same bitrate and at roughly the same
+ * point in the bit, but their controllers divide different clocks. Given the
+ * time quantum clock, the prescaler range of a controller, the bitrate and
+ * the sample point, CAN_BT_TQ() picks the largest number of time quanta per
+ * bit (CAN_BT_TQ_MAX down to CAN_BT_TQ_MIN) that the clock divides exactly
+ * and that fits the segment limits shared by the MCP2515 and the SAM3X CAN
+ * controller. It evaluates to 0 if there is none, so a driver can reject the
+ * configuration with _Static_assert:
+ *
+ *   enum { M_TQ = CAN_BT_TQ(clk, brp_min, brp_max, CAN_BITRATE, CAN_SAMPLE_POINT_PERMILLE) };
+ *   _Static_assert(M_TQ != 0, "no valid bit timing");
+ *
+ * The segment macros then give the lengths in TQ for that solution. A bit is
+ * SYNC (1 TQ) + PROP + PHASE1, sampled here, + PHASE2.
+ *
+ * Everything is an integer constant expression; keep the solution in an enum
+ * as above so the large expansion is evaluated only once.
+ */
+
+#ifndef CAN_BIT_TIMING_H__
+#define CAN_BIT_TIMING_H__
+
+#include <stdint.h>
+
+// Bitrate and sample point used by every node on the bus
+#define CAN_BITRATE (125000UL)
+#define CAN_SAMPLE_POINT_PERMILLE (875)
+// Largest distance between the requested and the solved sample point
+#define CAN_SAMPLE_POINT_TOLERANCE_PERMILLE (25)
+
+#define CAN_BT_TQ_MIN (8)
+#define CAN_BT_TQ_MAX (25)
+
+// Segment limits in TQ, common to the MCP2515 (sec. 5.3) and the SAM3X CAN
+#define CAN_BT_TSEG1_MIN (2)  // PROP + PHASE1, each 1..8
+#define CAN_BT_TSEG1_MAX (16)
+#define CAN_BT_PHASE2_MIN (2) // information processing time
+#define CAN_BT_PHASE2_MAX (8)
+#define CAN_BT_SJW_MAX (4)
+
+#define CAN_BT_MIN_(a, b) ((a) < (b) ? (a) : (b))
+
+// TQ from the start of the bit to the sample point, rounded to nearest
+#define CAN_BT_SAMPLE_TQ(tq, sp) ((((uint32_t) (tq) * (sp)) + 500) / 1000)
+
+// Segment lengths in TQ for `tq` quanta per bit
+#define CAN_BT_TSEG1(tq, sp) (CAN_BT_SAMPLE_TQ(tq, sp) - 1)
+#define CAN_BT_PHASE1(tq, sp) ((CAN_BT_TSEG1(tq, sp) + 1) / 2)
+#define CAN_BT_PROP(tq, sp) (CAN_BT_TSEG1(tq, sp) / 2)
+#define CAN_BT_PHASE2(tq, sp) ((tq) - CAN_BT_SAMPLE_TQ(tq, sp))
+// Widest resynchronization jump both controllers accept: SJW < PHASE2 and SJW <= PHASE1
+#define CAN_BT_SJW(tq, sp) \
+    CAN_BT_MIN_(CAN_BT_MIN_(CAN_BT_SJW_MAX, CAN_BT_PHASE2(tq, sp) - 1), CAN_BT_PHASE1(tq, sp))
+
+// Prescaler value for a TQ clock of `clk` Hz, with TQ = (BRP + 1) / clk
+#define CAN_BT_BRP(clk, bitrate, tq) ((uint32_t) (clk) / ((uint32_t) (bitrate) * (tq)) - 1)
+
+// Sample point of a solution, in 1/1000 of the bit
+#define CAN_BT_ACTUAL_SAMPLE_POINT(tq, sp) (CAN_BT_SAMPLE_TQ(tq, sp) * 1000 / (tq))
+#define CAN_BT_SAMPLE_POINT_OK(tq, sp) \
+    (CAN_BT_ACTUAL_SAMPLE_POINT(tq, sp) + CAN_SAMPLE_POINT_TOLERANCE_PERMILLE >= (sp) && \
+     CAN_BT_ACTUAL_SAMPLE_POINT(tq, sp) <= (sp) + CAN_SAMPLE_POINT_TOLERANCE_PERMILLE)
+
+#define CAN_BT_VALID_(clk, brp_min, brp_max, bitrate, sp, tq) \
+    ((uint32_t) (clk) % ((uint32_t) (bitrate) * (tq)) == 0 && \
+     CAN_BT_BRP(clk, bitrate, tq) + 1 > (brp_min) && \
+     CAN_BT_BRP(clk, bitrate, tq) <= (brp_max) && \
+     CAN_BT_TSEG1(tq, sp) >= CAN_BT_TSEG1_MIN && \
+     CAN_BT_TSEG1(tq, sp) <= CAN_BT_TSEG1_MAX && \
+     CAN_BT_PHASE2(tq, sp) >= CAN_BT_PHASE2_MIN && \
+     CAN_BT_PHASE2(tq, sp) <= CAN_BT_PHASE2_MAX && \
+     CAN_BT_PHASE2(tq, sp) <= CAN_BT_TSEG1(tq, sp))
+
+#define CAN_BT_TRY_(c, lo, hi, b, sp, tq, next) \
+    (CAN_BT_VALID_(c, lo, hi, b, sp, tq) ? (tq) : (next))
+
+// Quanta per bit of the best solution, or 0 if there is none
+#define CAN_BT_TQ(clk, brp_min, brp_max, bitrate, sp) \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 25, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 24, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 23, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 22, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 21, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 20, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 19, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 18, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 17, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 16, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 15, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 14, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 13, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 12, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 11, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 10, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 9, \
+    CAN_BT_TRY_(clk, brp_min, brp_max, bitrate, sp, 8, \
+    0))))))))))))))))))
+
+#endif /* CAN_BIT_TIMING_H__ */
@@ -0,0 +1,75 @@
+/*
+ * CAN bus load and per-ID traffic statistics.
+ *
+ * The CAN driver reports every received frame and every frame queued for
+ * transmission. On a two-node bus, that is all the traffic on the bus. Each
+ * ID gets a slot in a fixed table on first sight; frames with IDs that do
+ * not fit are only counted towards the bus load. The load is estimated from
+ * the worst-case length of each frame, bit stuffing included, at
+ * CAN_BITRATE, and updated once per window by can_stats_tick().
+ *
+ * Another node can read the statistics over CAN: a CAN_STATS_QUERY_MSG_ID
+ * frame holding one index byte is answered with a CAN_STATS_REPLY_MSG_ID
+ * frame, see can_stats_reply_encode().
+ */
+
+#ifndef CAN_STATS_H__
+#define CAN_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAN_STATS_MAX_IDS (8)
+#define CAN_STATS_WINDOW_MS (1000)
+
+// Highest IDs in use, so statistics traffic loses arbitration to everything else
+#define CAN_STATS_QUERY_MSG_ID (0x7F0)
+#define CAN_STATS_REPLY_MSG_ID (0x7F1)
+#define CAN_STATS_QUERY_LEN (1)
+#define CAN_STATS_REPLY_LEN (8)
+
+// Query index for the summary instead of a table entry
+#define CAN_STATS_INDEX_SUMMARY (0xFF)
+
+typedef struct
+{
+    uint16_t id;
+    uint16_t rx_count;
+    uint16_t tx_count;
+    uint16_t min_gap_ms;
+    uint16_t max_gap_ms;
+    // Time of the last frame, in ms modulo 2^16
+    uint16_t last_ms;
+    uint32_t byte_count;
+} can_stats_entry_t;
+
+typedef struct
+{
+    // Bus utilization over the last complete window and the highest seen
+    uint16_t load_permille;
+    uint16_t peak_load_permille;
+    // Table entries in use
+    uint8_t id_count;
+    // Frames whose ID did not fit in the table
+    uint16_t untracked_count;
+} can_stats_summary_t;
+
+// Clear all statistics
+void can_stats_init(void);
+// Account for a received frame. Called by the CAN driver, may run in interrupt context.
+void can_stats_rx(uint16_t id, uint8_t len);
+// Account for a frame queued for transmission. Called by the CAN driver.
+void can_stats_tx(uint16_t id, uint8_t len);
+// Close the load window if it has passed. Call periodically.
+void can_stats_tick(uint32_t now_ms);
+void can_stats_summary_get(can_stats_summary_t * p_summary);
+// Copy table entry `index`. Returns false if the entry is not in use.
+bool can_stats_entry_get(uint8_t index, can_stats_entry_t * p_entry);
+// Encode the reply to a query for `index` into CAN_STATS_REPLY_LEN bytes:
+//   summary: [0] 0xFF, [1] ID count, [2..3] load, [4..5] peak load, [6..7] untracked frames
+//   entry:   [0] index, [1..2] ID, [3..4] RX + TX frames, [5..6] max gap, [7] min gap
+// Values too large for their bytes are saturated.
+// Multi-byte values are little endian. Returns false for an entry not in use.
+bool can_stats_reply_encode(uint8_t index, uint8_t * p_data);
+
+#endif /* CAN_STATS_H__ */
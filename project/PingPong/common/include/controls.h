@@ -33,6 +33,12 @@ typedef struct
 	uint8_t left_slider_pos;
 } sliders_position_t;
 
+typedef struct
+{
+	bool right_pressed;
+	bool left_pressed;
+} buttons_state_t;
+
 static const char * joystick_dir_to_str(joystick_direction_t joystick_dir)
 {
 	switch(joystick_dir)
@@ -62,5 +68,6 @@ bool joystick_init(void);
 void get_joystick_pos(joystick_position_t *p_joystick_position_out);
 void get_joystick_dir(joystick_direction_t *p_first_dir_out, joystick_direction_t *p_second_dir_out);
 void get_sliders_pos(sliders_position_t *p_sliders_position_out);
+void get_buttons_state(buttons_state_t *p_buttons_out);
 
 #endif /* JOYSTICK_H_ */
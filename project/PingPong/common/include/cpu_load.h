@@ -0,0 +1,39 @@
+/*
+ * CPU load and idle-time accounting.
+ *
+ * The main loop calls cpu_load_idle_ms() instead of a busy delay. Time spent
+ * inside the idle hook counts as idle, everything between two calls counts as
+ * busy. Interrupts that fire while idling are counted as idle time.
+ */
+
+#ifndef CPU_LOAD_H__
+#define CPU_LOAD_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+    // Busy share of the last complete window, in 1/1000
+    uint16_t load_permille;
+    // Highest load seen in any complete window, in 1/1000
+    uint16_t peak_load_permille;
+    // Longest time between two consecutive idle hook entries
+    uint32_t worst_loop_period_us;
+    // Longest busy stretch between leaving and re-entering the idle hook
+    uint32_t worst_busy_us;
+    // Number of completed accounting windows
+    uint32_t window_count;
+} cpu_load_stats_t;
+
+// Initialize load accounting with the given window length
+void cpu_load_init(uint16_t window_ms);
+// Idle hook: wait for `ms` milliseconds, accounting the time as idle
+void cpu_load_idle_ms(uint16_t ms);
+// Mark the start and end of an idle stretch, for idle loops that wait on
+// something other than time (e.g. a scheduler waiting for its next tick)
+void cpu_load_idle_enter(void);
+void cpu_load_idle_exit(void);
+// Fetch the current statistics
+void cpu_load_get(cpu_load_stats_t * p_stats_out);
+
+#endif /* CPU_LOAD_H__ */
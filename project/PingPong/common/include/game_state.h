@@ -0,0 +1,82 @@
+/*
+ * Game state frames shared by both nodes.
+ *
+ * Node2 runs the game and broadcasts its state with CAN_GAME_STATE_MSG_ID
+ * at a fixed rate. Node1 starts and aborts games with CAN_GAME_CMD_MSG_ID.
+ *
+ * State frame layout (little endian):
+ *   [0]    game_state_t
+ *   [1..2] score
+ *   [3]    lives left
+ *   [4..5] elapsed time since the start of the game, in 1/10 s
+ *   [6]    sequence number, incremented with every frame
+ *   [7]    servo position
+ *
+ * Command frame layout:
+ *   [0]    game_cmd_t
+ */
+
+#ifndef GAME_STATE_H__
+#define GAME_STATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GAME_STATE_FRAME_LEN (8)
+#define GAME_CMD_FRAME_LEN   (1)
+
+typedef enum
+{
+    GAME_STATE_IDLE = 0,
+    GAME_STATE_PLAYING,
+    GAME_STATE_GOAL,      // short pause after a goal while the ball is put back
+    GAME_STATE_GAME_OVER,
+} game_state_t;
+
+typedef enum
+{
+    GAME_CMD_START = 0,
+    GAME_CMD_ABORT,
+} game_cmd_t;
+
+typedef struct
+{
+    game_state_t state;
+    uint16_t score;
+    uint8_t lives;
+    uint16_t elapsed_ds;
+    uint8_t sequence;
+    uint8_t servo_position;
+} game_frame_t;
+
+static inline void game_frame_encode(const game_frame_t *p_frame, uint8_t *p_buf)
+{
+    p_buf[0] = (uint8_t) p_frame->state;
+    p_buf[1] = (uint8_t) p_frame->score;
+    p_buf[2] = (uint8_t) (p_frame->score >> 8);
+    p_buf[3] = p_frame->lives;
+    p_buf[4] = (uint8_t) p_frame->elapsed_ds;
+    p_buf[5] = (uint8_t) (p_frame->elapsed_ds >> 8);
+    p_buf[6] = p_frame->sequence;
+    p_buf[7] = p_frame->servo_position;
+}
+
+// Returns false if the buffer does not hold a valid state frame
+static inline bool game_frame_decode(const uint8_t *p_buf, uint8_t len, game_frame_t *p_frame_out)
+{
+    if (len != GAME_STATE_FRAME_LEN || p_buf[0] > GAME_STATE_GAME_OVER)
+    {
+        return false;
+    }
+
+    p_frame_out->state = (game_state_t) p_buf[0];
+    p_frame_out->score = p_buf[1] | ((uint16_t) p_buf[2] << 8);
+    p_frame_out->lives = p_buf[3];
+    p_frame_out->elapsed_ds = p_buf[4] | ((uint16_t) p_buf[5] << 8);
+    p_frame_out->sequence = p_buf[6];
+    p_frame_out->servo_position = p_buf[7];
+
+    return true;
+}
+
+#endif /* GAME_STATE_H__ */
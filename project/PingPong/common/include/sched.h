@@ -0,0 +1,59 @@
+/*
+ * Cooperative run-to-completion task scheduler.
+ *
+ * Tasks are released periodically from the millisecond tick of the node's
+ * timer module and run to completion in the main context. When several tasks are ready the one
+ * registered first runs first, so register the shortest period first (rate
+ * monotonic). A task that has not finished within its deadline after its
+ * release counts as a deadline miss, as does every release skipped because
+ * the task was still late.
+ */
+
+#ifndef SCHED_H__
+#define SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHED_MAX_TASKS (7)
+#define SCHED_TASK_INVALID (0xFF)
+
+typedef void (*sched_task_fn_t)(void);
+
+typedef struct
+{
+    const char * name;
+    sched_task_fn_t fn;
+    // Release period
+    uint16_t period_ms;
+    // Deadline relative to release, 0 means the end of the period
+    uint16_t deadline_ms;
+    // Delay before the first release, to spread tasks with equal periods
+    uint16_t offset_ms;
+} sched_task_cfg_t;
+
+typedef struct
+{
+    uint32_t run_count;
+    uint32_t deadline_miss_count;
+    // Longest time from release to start
+    uint32_t worst_latency_ms;
+    // Longest execution time
+    uint32_t worst_exec_us;
+} sched_task_stats_t;
+
+// Initialize the scheduler. Requires timer_init().
+void sched_init(void);
+// Register a periodic task, returns its id or SCHED_TASK_INVALID
+uint8_t sched_task_add(const sched_task_cfg_t * cfg);
+// Release a task right away, e.g. when an event arrives. Interrupt safe.
+void sched_task_trigger(uint8_t task_id);
+// Number of registered tasks
+uint8_t sched_task_count_get(void);
+// Name and statistics of a task
+const char * sched_task_name_get(uint8_t task_id);
+bool sched_task_stats_get(uint8_t task_id, sched_task_stats_t * p_stats_out);
+// Run the registered tasks forever
+void sched_run(void) __attribute__((noreturn));
+
+#endif // SCHED_H__
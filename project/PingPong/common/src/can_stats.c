@@ -0,0 +1,216 @@
+/*
+ * CAN bus load and per-ID traffic statistics, built into both nodes.
+ *
+ * The node provides timer_ms_get() and, in its can_stats_port.h, the
+ * critical section that keeps the CAN interrupt out of the tables.
+ */
+
+#include "can_stats.h"
+
+#include <string.h>
+#include <assert.h>
+#include "can_bit_timing.h"
+#include "can_stats_port.h"
+#include "timer.h"
+
+// Worst-case bits of a standard frame: 47 + 8n fixed bits, 3 of them
+// interframe space, and a stuff bit per 4 of the 34 + 8n stuffed bits
+#define M_FRAME_BITS(len) (47 + 8 * (len) + (34 + 8 * (len) - 1) / 4)
+
+static can_stats_entry_t m_entries[CAN_STATS_MAX_IDS];
+static uint8_t m_id_count;
+static uint16_t m_untracked_count;
+
+static uint32_t m_window_bits;
+static uint32_t m_window_start_ms;
+static uint16_t m_load_permille;
+static uint16_t m_peak_load_permille;
+
+static void m_count(uint16_t * p_count)
+{
+    if (*p_count < UINT16_MAX)
+    {
+        (*p_count)++;
+    }
+}
+
+// Entry for `id`, added if there is room. Call with interrupts disabled.
+static can_stats_entry_t * m_entry_get(uint16_t id)
+{
+    for (uint8_t i = 0; i < m_id_count; i++)
+    {
+        if (m_entries[i].id == id)
+        {
+            return &m_entries[i];
+        }
+    }
+
+    if (m_id_count == CAN_STATS_MAX_IDS)
+    {
+        return NULL;
+    }
+
+    can_stats_entry_t * p_entry = &m_entries[m_id_count++];
+    memset(p_entry, 0, sizeof(*p_entry));
+    p_entry->id = id;
+    p_entry->min_gap_ms = UINT16_MAX;
+
+    return p_entry;
+}
+
+static void m_frame_add(uint16_t id, uint8_t len, bool tx)
+{
+    uint16_t now = (uint16_t) timer_ms_get();
+
+    can_stats_lock_t lock = can_stats_lock();
+
+    m_window_bits += M_FRAME_BITS(len);
+
+    can_stats_entry_t * p_entry = m_entry_get(id);
+    if (p_entry)
+    {
+        if (p_entry->rx_count || p_entry->tx_count)
+        {
+            uint16_t gap = now - p_entry->last_ms;
+            if (gap < p_entry->min_gap_ms)
+            {
+                p_entry->min_gap_ms = gap;
+            }
+            if (gap > p_entry->max_gap_ms)
+            {
+                p_entry->max_gap_ms = gap;
+            }
+        }
+        p_entry->last_ms = now;
+        m_count(tx ? &p_entry->tx_count : &p_entry->rx_count);
+        p_entry->byte_count += len;
+    }
+    else
+    {
+        m_count(&m_untracked_count);
+    }
+
+    can_stats_unlock(lock);
+}
+
+void can_stats_init(void)
+{
+    can_stats_lock_t lock = can_stats_lock();
+
+    m_id_count = 0;
+    m_untracked_count = 0;
+    m_window_bits = 0;
+    m_window_start_ms = timer_ms_get();
+    m_load_permille = 0;
+    m_peak_load_permille = 0;
+
+    can_stats_unlock(lock);
+}
+
+void can_stats_rx(uint16_t id, uint8_t len)
+{
+    m_frame_add(id, len, false);
+}
+
+void can_stats_tx(uint16_t id, uint8_t len)
+{
+    m_frame_add(id, len, true);
+}
+
+void can_stats_tick(uint32_t now_ms)
+{
+    uint32_t elapsed = now_ms - m_window_start_ms;
+
+    if (elapsed < CAN_STATS_WINDOW_MS)
+    {
+        return;
+    }
+
+    can_stats_lock_t lock = can_stats_lock();
+    uint32_t bits = m_window_bits;
+    m_window_bits = 0;
+    can_stats_unlock(lock);
+
+    m_window_start_ms = now_ms;
+    m_load_permille = (uint16_t) ((bits * 1000) / ((CAN_BITRATE / 1000) * elapsed));
+    if (m_load_permille > m_peak_load_permille)
+    {
+        m_peak_load_permille = m_load_permille;
+    }
+}
+
+void can_stats_summary_get(can_stats_summary_t * p_summary)
+{
+    assert(p_summary);
+
+    can_stats_lock_t lock = can_stats_lock();
+
+    p_summary->load_permille = m_load_permille;
+    p_summary->peak_load_permille = m_peak_load_permille;
+    p_summary->id_count = m_id_count;
+    p_summary->untracked_count = m_untracked_count;
+
+    can_stats_unlock(lock);
+}
+
+bool can_stats_entry_get(uint8_t index, can_stats_entry_t * p_entry)
+{
+    assert(p_entry);
+
+    can_stats_lock_t lock = can_stats_lock();
+
+    bool used = index < m_id_count;
+    if (used)
+    {
+        *p_entry = m_entries[index];
+    }
+
+    can_stats_unlock(lock);
+
+    return used;
+}
+
+bool can_stats_reply_encode(uint8_t index, uint8_t * p_data)
+{
+    assert(p_data);
+
+    if (index == CAN_STATS_INDEX_SUMMARY)
+    {
+        can_stats_summary_t summary;
+        can_stats_summary_get(&summary);
+
+        p_data[0] = CAN_STATS_INDEX_SUMMARY;
+        p_data[1] = summary.id_count;
+        p_data[2] = (uint8_t) summary.load_permille;
+        p_data[3] = (uint8_t) (summary.load_permille >> 8);
+        p_data[4] = (uint8_t) summary.peak_load_permille;
+        p_data[5] = (uint8_t) (summary.peak_load_permille >> 8);
+        p_data[6] = (uint8_t) summary.untracked_count;
+        p_data[7] = (uint8_t) (summary.untracked_count >> 8);
+
+        return true;
+    }
+
+    can_stats_entry_t entry;
+    if (!can_stats_entry_get(index, &entry))
+    {
+        return false;
+    }
+
+    uint32_t frames = (uint32_t) entry.rx_count + entry.tx_count;
+    if (frames > UINT16_MAX)
+    {
+        frames = UINT16_MAX;
+    }
+
+    p_data[0] = index;
+    p_data[1] = (uint8_t) entry.id;
+    p_data[2] = (uint8_t) (entry.id >> 8);
+    p_data[3] = (uint8_t) frames;
+    p_data[4] = (uint8_t) (frames >> 8);
+    p_data[5] = (uint8_t) entry.max_gap_ms;
+    p_data[6] = (uint8_t) (entry.max_gap_ms >> 8);
+    p_data[7] = entry.min_gap_ms > UINT8_MAX ? UINT8_MAX : (uint8_t) entry.min_gap_ms;
+
+    return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * CPU load and idle-time accounting, built into both nodes.
+ *
+ * The cycle counter and its rate come from the node's cpu_load_port.h.
+ */
+
+#include "cpu_load.h"
+
+#include <stdbool.h>
+#include <assert.h>
+#include "cpu_load_port.h"
+
+static uint32_t m_window_cycles;
+static uint32_t m_busy_cycles;
+static uint32_t m_idle_cycles;
+
+static uint32_t m_last_idle_entry;
+static uint32_t m_last_idle_exit;
+static bool m_loop_started;
+
+static uint32_t m_worst_period_cycles;
+static uint32_t m_worst_busy_cycles;
+
+static uint16_t m_load_permille;
+static uint16_t m_peak_load_permille;
+static uint32_t m_window_count;
+
+static void m_window_close(void)
+{
+    uint32_t total = m_busy_cycles + m_idle_cycles;
+
+    m_load_permille = (uint16_t) (m_busy_cycles / (total / 1000));
+    if (m_load_permille > m_peak_load_permille)
+    {
+        m_peak_load_permille = m_load_permille;
+    }
+    m_window_count++;
+
+    m_busy_cycles = 0;
+    m_idle_cycles = 0;
+}
+
+static void m_idle_enter(uint32_t now)
+{
+    uint32_t busy = now - m_last_idle_exit;
+
+    if (m_loop_started)
+    {
+        uint32_t period = now - m_last_idle_entry;
+        if (period > m_worst_period_cycles)
+        {
+            m_worst_period_cycles = period;
+        }
+    }
+    if (busy > m_worst_busy_cycles)
+    {
+        m_worst_busy_cycles = busy;
+    }
+
+    m_busy_cycles += busy;
+    m_last_idle_entry = now;
+    m_loop_started = true;
+}
+
+static void m_idle_exit(uint32_t now)
+{
+    m_idle_cycles += now - m_last_idle_entry;
+    m_last_idle_exit = now;
+
+    if (m_busy_cycles + m_idle_cycles >= m_window_cycles)
+    {
+        m_window_close();
+    }
+}
+
+void cpu_load_init(uint16_t window_ms)
+{
+    assert(window_ms > 0);
+
+    cpu_load_cycles_init();
+
+    m_window_cycles = (uint32_t) window_ms * CPU_LOAD_CYCLES_PER_MS;
+    m_busy_cycles = 0;
+    m_idle_cycles = 0;
+    m_loop_started = false;
+    m_worst_period_cycles = 0;
+    m_worst_busy_cycles = 0;
+    m_load_permille = 0;
+    m_peak_load_permille = 0;
+    m_window_count = 0;
+
+    m_last_idle_exit = cpu_load_cycles_get();
+    m_last_idle_entry = m_last_idle_exit;
+}
+
+void cpu_load_idle_ms(uint16_t ms)
+{
+    uint32_t now = cpu_load_cycles_get();
+    uint32_t end = now + (uint32_t) ms * CPU_LOAD_CYCLES_PER_MS;
+
+    m_idle_enter(now);
+
+    do
+    {
+        now = cpu_load_cycles_get();
+    } while ((int32_t) (end - now) > 0);
+
+    m_idle_exit(now);
+}
+
+void cpu_load_idle_enter(void)
+{
+    m_idle_enter(cpu_load_cycles_get());
+}
+
+void cpu_load_idle_exit(void)
+{
+    m_idle_exit(cpu_load_cycles_get());
+}
+
+void cpu_load_get(cpu_load_stats_t * p_stats_out)
+{
+    assert(p_stats_out);
+
+    p_stats_out->load_permille = m_load_permille;
+    p_stats_out->peak_load_permille = m_peak_load_permille;
+    p_stats_out->worst_loop_period_us = cpu_load_cycles_to_us(m_worst_period_cycles);
+    p_stats_out->worst_busy_us = cpu_load_cycles_to_us(m_worst_busy_cycles);
+    p_stats_out->window_count = m_window_count;
+}
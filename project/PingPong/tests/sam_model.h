@@ -0,0 +1,42 @@
+/*
+ * Peripheral instances behind stubs/sam3x8e.h. Include in the one
+ * translation unit of a Node2 test.
+ */
+#ifndef SAM_MODEL_H__
+#define SAM_MODEL_H__
+
+#include <string.h>
+#include <sam3x8e.h>
+
+// Master clock of Node2
+#define SAM_MODEL_MCK_HZ (84000000UL)
+
+uint8_t g_nvic_enabled[64];
+uint32_t g_primask;
+Pmc g_pmc;
+Pio g_pioa, g_piob, g_pioc, g_piod;
+Pwm g_pwm;
+Tc g_tc0, g_tc1, g_tc2;
+Dacc g_dacc;
+DWT_Type g_dwt;
+CoreDebug_Type g_core_debug;
+
+static void sam_model_reset(void)
+{
+    memset(g_nvic_enabled, 0, sizeof(g_nvic_enabled));
+    g_primask = 0;
+    memset(&g_pmc, 0, sizeof(g_pmc));
+    memset(&g_pioa, 0, sizeof(g_pioa));
+    memset(&g_piob, 0, sizeof(g_piob));
+    memset(&g_pioc, 0, sizeof(g_pioc));
+    memset(&g_piod, 0, sizeof(g_piod));
+    memset(&g_pwm, 0, sizeof(g_pwm));
+    memset(&g_tc0, 0, sizeof(g_tc0));
+    memset(&g_tc1, 0, sizeof(g_tc1));
+    memset(&g_tc2, 0, sizeof(g_tc2));
+    memset(&g_dacc, 0, sizeof(g_dacc));
+    memset(&g_dwt, 0, sizeof(g_dwt));
+    memset(&g_core_debug, 0, sizeof(g_core_debug));
+}
+
+#endif /* SAM_MODEL_H__ */
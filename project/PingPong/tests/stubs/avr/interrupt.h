@@ -0,0 +1,12 @@
+/*
+ * Host stand-in for <avr/interrupt.h>. There are no interrupts on the host.
+ */
+#ifndef STUB_AVR_INTERRUPT_H__
+#define STUB_AVR_INTERRUPT_H__
+
+#include <avr/io.h>
+
+#define cli() ((void) 0)
+#define sei() ((void) 0)
+
+#endif /* STUB_AVR_INTERRUPT_H__ */
@@ -0,0 +1,11 @@
+/*
+ * Host stand-in for <avr/io.h>: only the registers the tested modules touch.
+ */
+#ifndef STUB_AVR_IO_H__
+#define STUB_AVR_IO_H__
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#endif /* STUB_AVR_IO_H__ */
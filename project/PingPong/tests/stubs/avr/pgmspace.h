@@ -0,0 +1,16 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>. Program memory is ordinary memory.
+ */
+#ifndef STUB_AVR_PGMSPACE_H__
+#define STUB_AVR_PGMSPACE_H__
+
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define memcpy_P memcpy
+#define printf_P printf
+
+#endif /* STUB_AVR_PGMSPACE_H__ */
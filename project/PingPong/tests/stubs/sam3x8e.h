@@ -0,0 +1,218 @@
+/*
+ * Host stand-in for the SAM3X8E device header.
+ *
+ * The peripherals are plain structs in RAM, defined by the test, with the
+ * register and bit names of the device header that the tested modules use.
+ * Bit values are those of the SAM3X datasheet, so a test can model what the
+ * hardware does with the configuration written to them.
+ */
+#ifndef STUB_SAM3X8E_H__
+#define STUB_SAM3X8E_H__
+
+#include <stdint.h>
+
+// Read-only registers are writable, so a test can set status bits
+#define __I volatile
+#define __O volatile
+#define __IO volatile
+
+typedef enum
+{
+    PIOD_IRQn = 14,
+    TC0_IRQn = 27,
+    TC3_IRQn = 30,
+    TC4_IRQn = 31,
+    PWM_IRQn = 36,
+} IRQn_Type;
+
+#define ID_PIOD (14)
+#define ID_TC0 (27)
+#define ID_TC3 (30)
+#define ID_TC4 (31)
+#define ID_TC6 (33)
+#define ID_PWM (36)
+#define ID_DACC (38)
+
+// Interrupt controller, recorded per interrupt by the test
+extern uint8_t g_nvic_enabled[64];
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { g_nvic_enabled[irq] = 1; }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { g_nvic_enabled[irq] = 0; }
+
+// Interrupt mask, 1 while interrupts are disabled
+extern uint32_t g_primask;
+static inline uint32_t __get_PRIMASK(void) { return g_primask; }
+static inline void __set_PRIMASK(uint32_t primask) { g_primask = primask; }
+static inline void __disable_irq(void) { g_primask = 1; }
+static inline void __enable_irq(void) { g_primask = 0; }
+
+// Power management controller
+typedef struct
+{
+    __O uint32_t PMC_PCER0;
+    __O uint32_t PMC_PCER1;
+    __IO uint32_t PMC_PCR;
+} Pmc;
+
+#define PMC_PCR_PID(value) ((uint32_t) (value) & 0x3F)
+#define PMC_PCR_CMD (0x1u << 12)
+#define PMC_PCR_DIV_PERIPH_DIV_MCK (0x0u << 16)
+#define PMC_PCR_EN (0x1u << 28)
+
+// Parallel I/O controller
+typedef struct
+{
+    __O uint32_t PIO_PER;
+    __O uint32_t PIO_PDR;
+    __O uint32_t PIO_OER;
+    __O uint32_t PIO_ODR;
+    __O uint32_t PIO_SODR;
+    __O uint32_t PIO_CODR;
+    __IO uint32_t PIO_ODSR;
+    __I uint32_t PIO_PDSR;
+    __O uint32_t PIO_IER;
+    __O uint32_t PIO_IDR;
+    __IO uint32_t PIO_ABSR;
+} Pio;
+
+#define PIO_PB25B_TIOA0 (0x1u << 25)
+#define PIO_PC12 (0x1u << 12)
+#define PIO_PC22B_PWML5 (0x1u << 22)
+#define PIO_PC25B_TIOA6 (0x1u << 25)
+#define PIO_PC26B_TIOB6 (0x1u << 26)
+#define PIO_PD9 (0x1u << 9)
+#define PIO_PD10 (0x1u << 10)
+
+// Pulse width modulation controller
+typedef struct
+{
+    __IO uint32_t PWM_CMR;
+    __IO uint32_t PWM_CDTY;
+    __O uint32_t PWM_CDTYUPD;
+    __IO uint32_t PWM_CPRD;
+    __O uint32_t PWM_CPRDUPD;
+    __I uint32_t PWM_CCNT;
+} PwmCh_num;
+
+typedef struct
+{
+    __IO uint32_t PWM_CLK;
+    __O uint32_t PWM_ENA;
+    __O uint32_t PWM_DIS;
+    __I uint32_t PWM_SR;
+    __O uint32_t PWM_IER1;
+    __O uint32_t PWM_IDR1;
+    __I uint32_t PWM_IMR1;
+    __I uint32_t PWM_ISR1;
+    PwmCh_num PWM_CH_NUM[8];
+} Pwm;
+
+#define PWM_CLK_DIVA(value) ((uint32_t) (value) & 0xFF)
+#define PWM_CLK_PREA(value) (((uint32_t) (value) & 0xF) << 8)
+#define PWM_CMR_CPRE_Msk (0xFu << 0)
+#define PWM_CMR_CPRE_CLKA (0xBu << 0)
+#define PWM_CMR_CALG (0x1u << 8)
+#define PWM_CMR_CPOL (0x1u << 9)
+#define PWM_IER1_CHID0 (0x1u << 0)
+#define PWM_ISR1_CHID0 (0x1u << 0)
+
+// Timer counter
+typedef struct
+{
+    __O uint32_t TC_CCR;
+    __IO uint32_t TC_CMR;
+    __IO uint32_t TC_SMMR;
+    __I uint32_t Reserved1[1];
+    __I uint32_t TC_CV;
+    __IO uint32_t TC_RA;
+    __IO uint32_t TC_RB;
+    __IO uint32_t TC_RC;
+    __I uint32_t TC_SR;
+    __O uint32_t TC_IER;
+    __O uint32_t TC_IDR;
+    __I uint32_t TC_IMR;
+} TcChannel;
+
+typedef struct
+{
+    TcChannel TC_CHANNEL[3];
+    __O uint32_t TC_BCR;
+    __IO uint32_t TC_BMR;
+} Tc;
+
+#define TC_CCR_CLKEN (0x1u << 0)
+#define TC_CCR_CLKDIS (0x1u << 1)
+#define TC_CCR_SWTRG (0x1u << 2)
+#define TC_CMR_TCCLKS_TIMER_CLOCK1 (0x0u << 0)
+#define TC_CMR_TCCLKS_TIMER_CLOCK2 (0x1u << 0)
+#define TC_CMR_TCCLKS_TIMER_CLOCK4 (0x3u << 0)
+#define TC_CMR_TCCLKS_XC0 (0x5u << 0)
+#define TC_CMR_CPCSTOP (0x1u << 6)
+#define TC_CMR_WAVSEL_UP_RC (0x2u << 13)
+#define TC_CMR_WAVE (0x1u << 15)
+#define TC_CMR_ACPA_SET (0x1u << 16)
+#define TC_CMR_ACPC_CLEAR (0x2u << 18)
+#define TC_SR_CPCS (0x1u << 4)
+#define TC_IER_CPCS (0x1u << 4)
+#define TC_BMR_QDEN (0x1u << 8)
+#define TC_BMR_POSEN (0x1u << 9)
+#define TC_BMR_EDGPHA (0x1u << 12)
+#define TC_BMR_MAXFILT(value) (((uint32_t) (value) & 0x3F) << 20)
+
+// Digital-to-analog converter controller
+typedef struct
+{
+    __O uint32_t DACC_CR;
+    __IO uint32_t DACC_MR;
+    __I uint32_t Reserved1[2];
+    __O uint32_t DACC_CHER;
+    __O uint32_t DACC_CHDR;
+    __I uint32_t DACC_CHSR;
+    __I uint32_t Reserved2[1];
+    __O uint32_t DACC_CDR;
+    __I uint32_t Reserved3[48];
+    __IO uint32_t DACC_WPMR;
+} Dacc;
+
+#define DACC_CR_SWRST (0x1u << 0)
+#define DACC_MR_TRGEN_DIS (0x0u << 0)
+#define DACC_MR_USER_SEL_CHANNEL1 (0x1u << 16)
+#define DACC_MR_STARTUP_8 (0x1u << 24)
+#define DACC_WPMR_WPKEY(value) (((uint32_t) (value) & 0xFFFFFF) << 8)
+
+// Data watchpoint and trace unit, for its cycle counter
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (0x1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (0x1u << 24)
+
+extern Pmc g_pmc;
+extern Pio g_pioa, g_piob, g_pioc, g_piod;
+extern Pwm g_pwm;
+extern Tc g_tc0, g_tc1, g_tc2;
+extern Dacc g_dacc;
+extern DWT_Type g_dwt;
+extern CoreDebug_Type g_core_debug;
+
+#define PMC (&g_pmc)
+#define PIOA (&g_pioa)
+#define PIOB (&g_piob)
+#define PIOC (&g_pioc)
+#define PIOD (&g_piod)
+#define PWM (&g_pwm)
+#define TC0 (&g_tc0)
+#define TC1 (&g_tc1)
+#define TC2 (&g_tc2)
+#define DACC (&g_dacc)
+#define DWT (&g_dwt)
+#define CoreDebug (&g_core_debug)
+
+#endif /* STUB_SAM3X8E_H__ */
@@ -0,0 +1,35 @@
+/*
+ * Minimal host test harness. A test file defines its test functions, runs
+ * them with TEST_RUN() from main() and returns TEST_RESULT().
+ */
+#ifndef TEST_H__
+#define TEST_H__
+
+#include <stdio.h>
+
+static unsigned m_test_checks;
+static unsigned m_test_failures;
+
+#define TEST_CHECK(cond) \
+    do \
+    { \
+        m_test_checks++; \
+        if (!(cond)) \
+        { \
+            m_test_failures++; \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define TEST_RUN(fn) \
+    do \
+    { \
+        unsigned failures = m_test_failures; \
+        fn(); \
+        printf("%-48s %s\n", #fn, m_test_failures == failures ? "ok" : "FAILED"); \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%u checks, %u failed\n", m_test_checks, m_test_failures), m_test_failures ? 1 : 0)
+
+#endif /* TEST_H__ */
@@ -0,0 +1,190 @@
+/*
+ * Host test of the CAN statistics shared by both nodes
+ * (common/src/can_stats.c). Built once with the can_stats_port.h of each
+ * node, NODE2 defined for Node2.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#ifdef NODE2
+#include "sam_model.h"
+#endif
+#include "../common/src/can_stats.c"
+
+#ifdef NODE2
+#define M_INTERRUPTS_ENABLED() (g_primask == 0)
+#else
+volatile uint8_t SREG = 0x80;
+#define M_INTERRUPTS_ENABLED() (SREG == 0x80)
+#endif
+
+static uint32_t m_now_ms;
+
+uint32_t timer_ms_get(void)
+{
+    return m_now_ms;
+}
+
+static void m_init(void)
+{
+    m_now_ms = 0;
+    can_stats_init();
+}
+
+static void test_bus_load(void)
+{
+    can_stats_summary_t summary;
+
+    m_init();
+
+    // 135 bits each with worst-case stuffing, 10.8% of a second at 125 kbit/s
+    TEST_CHECK(M_FRAME_BITS(8) == 135);
+    for (uint8_t i = 0; i < 100; i++)
+    {
+        can_stats_rx(0x100, 8);
+    }
+    can_stats_tick(CAN_STATS_WINDOW_MS - 1);
+    can_stats_summary_get(&summary);
+    TEST_CHECK(summary.load_permille == 0);
+
+    can_stats_tick(CAN_STATS_WINDOW_MS);
+    can_stats_summary_get(&summary);
+    TEST_CHECK(summary.load_permille == 100UL * 135 * 1000 / CAN_BITRATE);
+
+    // A quieter window, the peak is kept
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        can_stats_tx(0x200, 0);
+    }
+    can_stats_tick(2 * CAN_STATS_WINDOW_MS);
+    can_stats_summary_get(&summary);
+    TEST_CHECK(summary.load_permille == 10UL * M_FRAME_BITS(0) * 1000 / CAN_BITRATE);
+    TEST_CHECK(summary.peak_load_permille == 100UL * 135 * 1000 / CAN_BITRATE);
+    TEST_CHECK(M_INTERRUPTS_ENABLED());
+}
+
+static void test_table_full(void)
+{
+    can_stats_summary_t summary;
+    can_stats_entry_t entry;
+
+    m_init();
+
+    for (uint16_t id = 0; id <= CAN_STATS_MAX_IDS; id++)
+    {
+        can_stats_rx(0x10 + id, 1);
+    }
+    can_stats_rx(0x10, 2);
+
+    can_stats_summary_get(&summary);
+    TEST_CHECK(summary.id_count == CAN_STATS_MAX_IDS);
+    TEST_CHECK(summary.untracked_count == 1);
+
+    TEST_CHECK(can_stats_entry_get(0, &entry));
+    TEST_CHECK(entry.id == 0x10);
+    TEST_CHECK(entry.rx_count == 2);
+    TEST_CHECK(entry.byte_count == 3);
+    TEST_CHECK(!can_stats_entry_get(CAN_STATS_MAX_IDS, &entry));
+    TEST_CHECK(M_INTERRUPTS_ENABLED());
+}
+
+static void test_gaps(void)
+{
+    can_stats_entry_t entry;
+
+    m_init();
+
+    can_stats_rx(0x100, 1);
+    m_now_ms = 5;
+    can_stats_tx(0x100, 1);
+    m_now_ms = 20;
+    can_stats_rx(0x100, 1);
+    m_now_ms = 65530;
+    can_stats_rx(0x100, 1);
+    // Across the 16-bit wrap of last_ms
+    m_now_ms = 65540;
+    can_stats_rx(0x100, 1);
+
+    TEST_CHECK(can_stats_entry_get(0, &entry));
+    TEST_CHECK(entry.min_gap_ms == 5);
+    TEST_CHECK(entry.max_gap_ms == 65530 - 20);
+    TEST_CHECK(entry.last_ms == 4);
+    TEST_CHECK(entry.rx_count == 4 && entry.tx_count == 1);
+}
+
+static void test_reply_summary(void)
+{
+    uint8_t data[CAN_STATS_REPLY_LEN];
+
+    m_init();
+    for (uint8_t i = 0; i < 100; i++)
+    {
+        can_stats_rx(0x100, 8);
+    }
+    for (uint16_t id = 0; id < CAN_STATS_MAX_IDS + 3; id++)
+    {
+        can_stats_rx(0x200 + id, 0);
+    }
+    can_stats_tick(CAN_STATS_WINDOW_MS);
+
+    TEST_CHECK(can_stats_reply_encode(CAN_STATS_INDEX_SUMMARY, data));
+    uint16_t load = data[2] | data[3] << 8;
+    TEST_CHECK(data[0] == CAN_STATS_INDEX_SUMMARY);
+    TEST_CHECK(data[1] == CAN_STATS_MAX_IDS);
+    TEST_CHECK(load > 100 && load == (data[4] | data[5] << 8));
+    TEST_CHECK((data[6] | data[7] << 8) == 4);
+}
+
+static void test_reply_entry_saturates(void)
+{
+    uint8_t data[CAN_STATS_REPLY_LEN];
+    can_stats_entry_t entry;
+
+    m_init();
+    for (uint16_t i = 0; i < 40000; i++)
+    {
+        can_stats_rx(0x123, 0);
+        can_stats_tx(0x123, 0);
+    }
+    m_now_ms = 1000;
+    can_stats_rx(0x123, 0);
+
+    TEST_CHECK(can_stats_reply_encode(0, data));
+    TEST_CHECK(data[0] == 0);
+    TEST_CHECK((data[1] | data[2] << 8) == 0x123);
+    // 80001 frames, more than the two bytes hold
+    TEST_CHECK((data[3] | data[4] << 8) == UINT16_MAX);
+    TEST_CHECK((data[5] | data[6] << 8) == 1000);
+    TEST_CHECK(data[7] == 0);
+
+    // And the counters themselves
+    for (uint16_t i = 0; i < 30000; i++)
+    {
+        can_stats_rx(0x123, 0);
+    }
+    TEST_CHECK(can_stats_entry_get(0, &entry));
+    TEST_CHECK(entry.rx_count == UINT16_MAX);
+    TEST_CHECK(entry.tx_count == 40000);
+
+    // A new ID whose shortest gap is over 255 ms
+    can_stats_rx(0x124, 0);
+    m_now_ms = 1300;
+    can_stats_rx(0x124, 0);
+    TEST_CHECK(can_stats_reply_encode(1, data));
+    TEST_CHECK(data[7] == UINT8_MAX);
+
+    TEST_CHECK(!can_stats_reply_encode(2, data));
+    TEST_CHECK(M_INTERRUPTS_ENABLED());
+}
+
+int main(void)
+{
+    TEST_RUN(test_bus_load);
+    TEST_RUN(test_table_full);
+    TEST_RUN(test_gaps);
+    TEST_RUN(test_reply_summary);
+    TEST_RUN(test_reply_entry_saturates);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,144 @@
+/*
+ * Host test of the CPU load accounting shared by both nodes
+ * (common/src/cpu_load.c). Built once with the cpu_load_port.h of each
+ * node, NODE2 defined for Node2.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#ifdef NODE2
+#include "sam_model.h"
+#endif
+#include "../common/src/cpu_load.c"
+
+#ifdef NODE2
+#define M_CYCLES_SET(cycles) (g_dwt.CYCCNT = (cycles))
+#else
+volatile uint8_t SREG;
+static uint32_t m_cycles;
+
+uint32_t profiler_cycles_get(void)
+{
+    return m_cycles;
+}
+
+#define M_CYCLES_SET(cycles) (m_cycles = (cycles))
+#endif
+
+#define M_WINDOW_MS (100)
+#define M_US_TO_CYCLES(us) ((uint32_t) ((uint64_t) (us) * CPU_LOAD_CYCLES_PER_MS / 1000))
+
+static uint32_t m_now;
+
+static void m_init(uint32_t start)
+{
+#ifdef NODE2
+    sam_model_reset();
+#endif
+    cpu_load_init(M_WINDOW_MS);
+    m_now = start;
+    M_CYCLES_SET(m_now);
+    // Restart the accounting at `start`
+    m_last_idle_exit = m_now;
+    m_last_idle_entry = m_now;
+}
+
+// One main loop pass: busy for `busy_us`, then idle for `idle_us`
+static void m_loop(uint32_t busy_us, uint32_t idle_us)
+{
+    m_now += M_US_TO_CYCLES(busy_us);
+    M_CYCLES_SET(m_now);
+    cpu_load_idle_enter();
+    m_now += M_US_TO_CYCLES(idle_us);
+    M_CYCLES_SET(m_now);
+    cpu_load_idle_exit();
+}
+
+// Loop until the current window closes
+static void m_loop_window(uint32_t busy_us, uint32_t idle_us)
+{
+    uint32_t window_count = m_window_count;
+
+    for (uint16_t i = 0; i < 1000 && m_window_count == window_count; i++)
+    {
+        m_loop(busy_us, idle_us);
+    }
+}
+
+// Microseconds are truncated to whole cycles, so results may come out one
+// below on Node1
+#define M_NEAR(value, expected) ((value) <= (expected) && (value) + 1 >= (expected))
+
+static void test_init(void)
+{
+    cpu_load_stats_t stats;
+
+    m_init(0);
+    cpu_load_get(&stats);
+    TEST_CHECK(stats.load_permille == 0);
+    TEST_CHECK(stats.window_count == 0);
+    TEST_CHECK(m_window_cycles == M_WINDOW_MS * CPU_LOAD_CYCLES_PER_MS);
+#ifdef NODE2
+    TEST_CHECK(g_core_debug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+    TEST_CHECK(g_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk);
+#endif
+}
+
+static void test_load_per_window(void)
+{
+    cpu_load_stats_t stats;
+
+    m_init(0);
+
+    // 30% busy for one window
+    m_loop_window(300, 700);
+    cpu_load_get(&stats);
+    TEST_CHECK(stats.window_count == 1);
+    TEST_CHECK(M_NEAR(stats.load_permille, 300));
+
+    // Then 10%, the peak is kept
+    m_loop_window(100, 900);
+    cpu_load_get(&stats);
+    TEST_CHECK(stats.window_count == 2);
+    TEST_CHECK(M_NEAR(stats.load_permille, 100));
+    TEST_CHECK(M_NEAR(stats.peak_load_permille, 300));
+}
+
+static void test_worst_stretches(void)
+{
+    cpu_load_stats_t stats;
+
+    m_init(0);
+    m_loop(200, 800);
+    m_loop(2500, 500);
+    m_loop(200, 800);
+
+    cpu_load_get(&stats);
+    TEST_CHECK(M_NEAR(stats.worst_busy_us, 2500));
+    // From one idle entry to the next: 800 us idle and 2500 us busy
+    TEST_CHECK(M_NEAR(stats.worst_loop_period_us, 3300));
+}
+
+// The cycle counter wraps every 14 minutes on Node1 and 51 s on Node2
+static void test_counter_wrap(void)
+{
+    cpu_load_stats_t stats;
+
+    m_init(UINT32_MAX - M_US_TO_CYCLES(M_WINDOW_MS * 500UL));
+    m_loop_window(500, 500);
+    cpu_load_get(&stats);
+    TEST_CHECK(stats.window_count == 1);
+    TEST_CHECK(M_NEAR(stats.load_permille, 500));
+    TEST_CHECK(M_NEAR(stats.worst_loop_period_us, 1000));
+}
+
+int main(void)
+{
+    TEST_RUN(test_init);
+    TEST_RUN(test_load_per_window);
+    TEST_RUN(test_worst_stretches);
+    TEST_RUN(test_counter_wrap);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,470 @@
+/*
+ * Host test of the drawing primitives (PingPong/gfx.c).
+ *
+ * Small scenes are compared with golden images drawn as text, one character
+ * per pixel ('#' set, '.' clear), and the span and blit fast paths are
+ * compared with a pixel by pixel reference over random, partly clipped
+ * arguments.
+ *
+ * Run with "golden" as the argument to print the scenes as rendered, or
+ * with "bench" for primitives per second on the host.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include "test.h"
+#include "../PingPong/gfx.c"
+
+volatile uint8_t SREG;
+
+#define M_WIDTH (24)
+#define M_HEIGHT (16)
+
+static uint8_t m_buf[GFX_FB_SIZE(M_WIDTH, M_HEIGHT)];
+static uint8_t m_ref_buf[GFX_FB_SIZE(M_WIDTH, M_HEIGHT)];
+static gfx_fb_t m_fb;
+static gfx_fb_t m_ref_fb;
+
+// 8x10 sprite: a frame with a diagonal, the last two rows on a second page
+static const uint8_t m_sprite_data[16] = {
+    0xFF, 0x03, 0x05, 0x09, 0x11, 0x21, 0x41, 0xFF,
+    0x03, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x03,
+};
+static const gfx_bitmap_t m_sprite = { .p_data = m_sprite_data, .width = 8, .height = 10 };
+
+static void m_init(void)
+{
+    TEST_CHECK(gfx_fb_init(&m_fb, m_buf, M_WIDTH, M_HEIGHT));
+    TEST_CHECK(gfx_fb_init(&m_ref_fb, m_ref_buf, M_WIDTH, M_HEIGHT));
+    gfx_clear(&m_fb, GFX_COLOR_OFF);
+    gfx_clear(&m_ref_fb, GFX_COLOR_OFF);
+}
+
+static void m_scene_lines(void)
+{
+    gfx_line(&m_fb, 0, 0, 11, 5, GFX_COLOR_ON);
+    gfx_line(&m_fb, 23, 15, 14, 0, GFX_COLOR_ON);
+    gfx_hline(&m_fb, 2, 9, 8, GFX_COLOR_ON);
+    gfx_vline(&m_fb, 12, 4, 9, GFX_COLOR_ON);
+}
+
+static void m_scene_rects(void)
+{
+    gfx_rect(&m_fb, 1, 1, 9, 6, GFX_COLOR_ON);
+    gfx_fill_rect(&m_fb, 12, 3, 10, 10, GFX_COLOR_ON);
+    // Inverted over the filled one, and a hole punched in it
+    gfx_rect(&m_fb, 10, 6, 6, 9, GFX_COLOR_INVERT);
+    gfx_fill_rect(&m_fb, 17, 7, 3, 3, GFX_COLOR_OFF);
+}
+
+static void m_scene_circles(void)
+{
+    gfx_circle(&m_fb, 6, 7, 5, GFX_COLOR_ON);
+    gfx_fill_circle(&m_fb, 18, 8, 4, GFX_COLOR_ON);
+}
+
+// Everything partly outside the framebuffer
+static void m_scene_clipped(void)
+{
+    gfx_circle(&m_fb, 0, 0, 6, GFX_COLOR_ON);
+    gfx_line(&m_fb, -5, 20, 30, 5, GFX_COLOR_ON);
+    gfx_fill_rect(&m_fb, 20, -3, 10, 6, GFX_COLOR_ON);
+    gfx_fill_circle(&m_fb, 23, 15, 3, GFX_COLOR_ON);
+}
+
+// Unaligned to the pages, and clipped on three sides
+static void m_scene_blit(void)
+{
+    gfx_blit(&m_fb, 2, 3, &m_sprite, GFX_COLOR_ON);
+    gfx_blit(&m_fb, -3, 11, &m_sprite, GFX_COLOR_ON);
+    gfx_blit(&m_fb, 19, -4, &m_sprite, GFX_COLOR_ON);
+    gfx_fill_rect(&m_fb, 12, 5, 6, 6, GFX_COLOR_ON);
+    gfx_blit(&m_fb, 11, 4, &m_sprite, GFX_COLOR_INVERT);
+}
+
+typedef struct
+{
+    const char * p_name;
+    void (*draw)(void);
+    const char * rows[M_HEIGHT];
+} m_golden_t;
+
+static const m_golden_t m_goldens[] = {
+    {
+        "lines", m_scene_lines,
+        {
+            "##............#.........",
+            "..##...........#........",
+            "....##.........#........",
+            "......##........#.......",
+            "........##..#...#.......",
+            "..........###....#......",
+            "............#.....#.....",
+            "............#.....#.....",
+            "............#......#....",
+            "..########..#......#....",
+            "............#.......#...",
+            "............#........#..",
+            "............#........#..",
+            "......................#.",
+            "......................#.",
+            ".......................#",
+        },
+    },
+    {
+        "rects", m_scene_rects,
+        {
+            "........................",
+            ".#########..............",
+            ".#.......#..............",
+            ".#.......#..##########..",
+            ".#.......#..##########..",
+            ".#.......#..##########..",
+            ".###########....######..",
+            "..........#.###.#...##..",
+            "..........#.###.#...##..",
+            "..........#.###.#...##..",
+            "..........#.###.######..",
+            "..........#.###.######..",
+            "..........#.###.######..",
+            "..........#....#........",
+            "..........######........",
+            "........................",
+        },
+    },
+    {
+        "circles", m_scene_circles,
+        {
+            "........................",
+            "........................",
+            "....#####...............",
+            "...#.....#..............",
+            "..#.......#.......#.....",
+            ".#.........#....#####...",
+            ".#.........#...#######..",
+            ".#.........#...#######..",
+            ".#.........#..#########.",
+            ".#.........#...#######..",
+            "..#.......#....#######..",
+            "...#.....#......#####...",
+            "....#####.........#.....",
+            "........................",
+            "........................",
+            "........................",
+        },
+    },
+    {
+        "clipped", m_scene_clipped,
+        {
+            "......#.............####",
+            "......#.............####",
+            "......#.............####",
+            ".....#..................",
+            "....#...................",
+            "...#....................",
+            "###.....................",
+            "........................",
+            "......................##",
+            "....................##..",
+            "..................##....",
+            "...............###......",
+            ".............##........#",
+            "...........##........###",
+            "........###..........###",
+            "......##............####",
+        },
+    },
+    {
+        "blit", m_scene_blit,
+        {
+            "...................#...#",
+            "...................#....",
+            "...................#....",
+            "..########.........#....",
+            "..##.....#.#########....",
+            "..#.#....#.#.###########",
+            "..#..#...#.##.#####.....",
+            "..#...#..#.###.####.....",
+            "..#....#.#.####.###.....",
+            "..#.....##.#####.##.....",
+            "..#......#.######.#.....",
+            "#####....#.#......#.....",
+            "..########.#......#.....",
+            "....#......########.....",
+            "#...#...................",
+            ".#..#...................",
+        },
+    },
+};
+
+static void m_render(char rows[M_HEIGHT][M_WIDTH + 1])
+{
+    for (int16_t y = 0; y < M_HEIGHT; y++)
+    {
+        for (int16_t x = 0; x < M_WIDTH; x++)
+        {
+            rows[y][x] = gfx_pixel_get(&m_fb, x, y) ? '#' : '.';
+        }
+        rows[y][M_WIDTH] = '\0';
+    }
+}
+
+static void m_golden_print(const char * p_name, char rows[M_HEIGHT][M_WIDTH + 1])
+{
+    printf("    {\n        \"%s\", m_scene_%s,\n        {\n", p_name, p_name);
+    for (int16_t y = 0; y < M_HEIGHT; y++)
+    {
+        printf("            \"%s\",\n", rows[y]);
+    }
+    printf("        },\n    },\n");
+}
+
+static void test_golden_images(void)
+{
+    for (uint8_t i = 0; i < NUMELTS(m_goldens); i++)
+    {
+        const m_golden_t * p_golden = &m_goldens[i];
+        char rows[M_HEIGHT][M_WIDTH + 1];
+        bool match = true;
+
+        m_init();
+        p_golden->draw();
+        m_render(rows);
+
+        for (int16_t y = 0; y < M_HEIGHT; y++)
+        {
+            match &= strcmp(rows[y], p_golden->rows[y]) == 0;
+        }
+        TEST_CHECK(match);
+        if (!match)
+        {
+            printf("%s: rendered\n", p_golden->p_name);
+            m_golden_print(p_golden->p_name, rows);
+        }
+    }
+}
+
+// Pixel by pixel reference of the span and blit primitives
+static void m_ref_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, gfx_color_t color)
+{
+    for (int16_t j = y; j < y + h; j++)
+    {
+        for (int16_t i = x; i < x + w; i++)
+        {
+            gfx_pixel(&m_ref_fb, i, j, color);
+        }
+    }
+}
+
+static void m_ref_blit(int16_t x, int16_t y, const gfx_bitmap_t * p_bitmap, gfx_color_t color)
+{
+    for (int16_t j = 0; j < p_bitmap->height; j++)
+    {
+        for (int16_t i = 0; i < p_bitmap->width; i++)
+        {
+            if ((p_bitmap->p_data[(j >> 3) * p_bitmap->width + i] >> (j & 7)) & 1)
+            {
+                gfx_pixel(&m_ref_fb, x + i, y + j, color);
+            }
+        }
+    }
+}
+
+static int16_t m_random(int16_t min, int16_t max)
+{
+    return min + rand() % (max - min + 1);
+}
+
+static void test_spans_match_reference(void)
+{
+    srand(1);
+    m_init();
+
+    for (uint16_t i = 0; i < 5000; i++)
+    {
+        int16_t x = m_random(-30, M_WIDTH + 5);
+        int16_t y = m_random(-20, M_HEIGHT + 5);
+        int16_t w = m_random(-2, 40);
+        int16_t h = m_random(-2, 30);
+        gfx_color_t color = (gfx_color_t) m_random(GFX_COLOR_OFF, GFX_COLOR_INVERT);
+
+        switch (i % 3)
+        {
+            case 0:
+                gfx_fill_rect(&m_fb, x, y, w, h, color);
+                m_ref_fill_rect(x, y, w, h, color);
+                break;
+            case 1:
+                gfx_hline(&m_fb, x, y, w, color);
+                m_ref_fill_rect(x, y, w, 1, color);
+                break;
+            default:
+                gfx_vline(&m_fb, x, y, h, color);
+                m_ref_fill_rect(x, y, 1, h, color);
+                break;
+        }
+        TEST_CHECK(memcmp(m_buf, m_ref_buf, sizeof(m_buf)) == 0);
+    }
+}
+
+static void test_blit_matches_reference(void)
+{
+    srand(2);
+    m_init();
+
+    for (uint16_t i = 0; i < 5000; i++)
+    {
+        int16_t x = m_random(-10, M_WIDTH + 2);
+        int16_t y = m_random(-12, M_HEIGHT + 2);
+        gfx_color_t color = (gfx_color_t) m_random(GFX_COLOR_OFF, GFX_COLOR_INVERT);
+
+        gfx_blit(&m_fb, x, y, &m_sprite, color);
+        m_ref_blit(x, y, &m_sprite, color);
+        TEST_CHECK(memcmp(m_buf, m_ref_buf, sizeof(m_buf)) == 0);
+    }
+}
+
+// Inverting twice restores the framebuffer, so every pixel is drawn once
+static void test_invert_draws_each_pixel_once(void)
+{
+    m_init();
+    gfx_line(&m_fb, 0, 0, 23, 15, GFX_COLOR_ON);
+
+    memcpy(m_ref_buf, m_buf, sizeof(m_buf));
+    gfx_rect(&m_fb, 2, 3, 17, 9, GFX_COLOR_INVERT);
+    gfx_fill_circle(&m_fb, 12, 8, 6, GFX_COLOR_INVERT);
+    gfx_line(&m_fb, 3, 14, 20, 1, GFX_COLOR_INVERT);
+    gfx_blit(&m_fb, 5, 5, &m_sprite, GFX_COLOR_INVERT);
+    TEST_CHECK(memcmp(m_buf, m_ref_buf, sizeof(m_buf)) != 0);
+
+    gfx_rect(&m_fb, 2, 3, 17, 9, GFX_COLOR_INVERT);
+    gfx_fill_circle(&m_fb, 12, 8, 6, GFX_COLOR_INVERT);
+    gfx_line(&m_fb, 3, 14, 20, 1, GFX_COLOR_INVERT);
+    gfx_blit(&m_fb, 5, 5, &m_sprite, GFX_COLOR_INVERT);
+    TEST_CHECK(memcmp(m_buf, m_ref_buf, sizeof(m_buf)) == 0);
+}
+
+static void test_fb_init_arguments(void)
+{
+    gfx_fb_t fb;
+
+    TEST_CHECK(!gfx_fb_init(NULL, m_buf, M_WIDTH, M_HEIGHT));
+    TEST_CHECK(!gfx_fb_init(&fb, NULL, M_WIDTH, M_HEIGHT));
+    TEST_CHECK(!gfx_fb_init(&fb, m_buf, 0, M_HEIGHT));
+    TEST_CHECK(!gfx_fb_init(&fb, m_buf, M_WIDTH, 0));
+    TEST_CHECK(!gfx_fb_init(&fb, m_buf, M_WIDTH, 12));
+    TEST_CHECK(gfx_fb_init(&fb, m_buf, M_WIDTH, M_HEIGHT));
+    TEST_CHECK(fb.pages == 2);
+}
+
+/*
+ * Host benchmark, on the 128x40 framebuffer and with the shapes of the
+ * on-target benchmark (gfx_bench.c), to compare primitives with each other
+ * and before and after a change. Absolute numbers are not those of the AVR.
+ */
+
+#define M_BENCH_WIDTH (128)
+#define M_BENCH_HEIGHT (40)
+#define M_BENCH_NS (200000000ULL)
+
+static uint8_t m_bench_buf[GFX_FB_SIZE(M_BENCH_WIDTH, M_BENCH_HEIGHT)];
+
+static const uint8_t m_ball_data[32] = {
+    0xE0, 0xF8, 0xFC, 0xFE, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFE, 0xFC, 0xF8, 0xE0,
+    0x07, 0x1F, 0x3F, 0x7F, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x7F, 0x3F, 0x1F, 0x07,
+};
+static const gfx_bitmap_t m_ball = { .p_data = m_ball_data, .width = 16, .height = 16 };
+
+static void m_bench_op(const gfx_fb_t * p_fb, uint8_t op, uint32_t i)
+{
+    int16_t x = i & 0x1F;
+    int16_t y = i & 0x07;
+
+    switch (op)
+    {
+        case 0: gfx_clear(p_fb, GFX_COLOR_OFF); break;
+        case 1: gfx_pixel(p_fb, x, y, GFX_COLOR_INVERT); break;
+        case 2: gfx_hline(p_fb, x, y, 100, GFX_COLOR_INVERT); break;
+        case 3: gfx_vline(p_fb, x, y, 30, GFX_COLOR_INVERT); break;
+        case 4: gfx_line(p_fb, x, y, x + 99, y + 29, GFX_COLOR_INVERT); break;
+        case 5: gfx_rect(p_fb, x, y, 60, 30, GFX_COLOR_INVERT); break;
+        case 6: gfx_fill_rect(p_fb, x, y, 60, 30, GFX_COLOR_INVERT); break;
+        case 7: gfx_circle(p_fb, x + 20, y + 16, 15, GFX_COLOR_INVERT); break;
+        case 8: gfx_fill_circle(p_fb, x + 20, y + 16, 15, GFX_COLOR_INVERT); break;
+        default: gfx_blit(p_fb, x, y, &m_ball, GFX_COLOR_INVERT); break;
+    }
+}
+
+static uint64_t m_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void m_bench(void)
+{
+    static const char * const names[] = {
+        "clear", "pixel", "hline 100", "vline 30", "line 100x30", "rect 60x30",
+        "fill_rect 60x30", "circle r15", "fill_circle r15", "blit 16x16",
+    };
+    gfx_fb_t fb;
+
+    TEST_CHECK(gfx_fb_init(&fb, m_bench_buf, M_BENCH_WIDTH, M_BENCH_HEIGHT));
+    printf("gfx host bench, %ux%u framebuffer\n", M_BENCH_WIDTH, M_BENCH_HEIGHT);
+
+    for (uint8_t op = 0; op < NUMELTS(names); op++)
+    {
+        uint64_t start = m_now_ns();
+        uint64_t elapsed;
+        uint32_t count = 0;
+
+        gfx_clear(&fb, GFX_COLOR_OFF);
+        do
+        {
+            for (uint32_t i = 0; i < 1000; i++)
+            {
+                m_bench_op(&fb, op, count + i);
+            }
+            count += 1000;
+            elapsed = m_now_ns() - start;
+        } while (elapsed < M_BENCH_NS);
+
+        // Keep the drawing from being optimized out
+        __asm__ __volatile__ ("" : : "r" (m_bench_buf) : "memory");
+        printf("  %-16s %10.0f /s\n", names[op], count * 1e9 / elapsed);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "golden") == 0)
+    {
+        char rows[M_HEIGHT][M_WIDTH + 1];
+
+        for (uint8_t i = 0; i < NUMELTS(m_goldens); i++)
+        {
+            m_init();
+            m_goldens[i].draw();
+            m_render(rows);
+            m_golden_print(m_goldens[i].p_name, rows);
+        }
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+        m_bench();
+        return 0;
+    }
+
+    TEST_RUN(test_fb_init_arguments);
+    TEST_RUN(test_golden_images);
+    TEST_RUN(test_spans_match_reference);
+    TEST_RUN(test_blit_matches_reference);
+    TEST_RUN(test_invert_draws_each_pixel_once);
+
+    return TEST_RESULT();
+}
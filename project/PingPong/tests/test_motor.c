@@ -0,0 +1,292 @@
+/*
+ * Host test of the motor position loop (Node2/motor.c) against a model of
+ * the motor box, racket and encoder.
+ *
+ * Run with "tune kp ki kd" as the arguments to print the step response
+ * metrics and trace for other gains (in 1/256, as motor_gains_t).
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+#include "test.h"
+#include "sam_model.h"
+#include "../Node2/motor.c"
+
+// Racket speed at full output, velocity time constant, and the output
+// needed to overcome static friction
+#define M_PLANT_MAX_SPEED (10000.0) // counts/s
+#define M_PLANT_TAU_S (0.03)
+#define M_PLANT_DEADBAND (200)      // DAC counts
+
+#define M_DT_S (1.0 / MOTOR_LOOP_RATE_HZ)
+// Settled when within 1% of the range
+#define M_SETTLE_BAND (MOTOR_ENCODER_RANGE / 100)
+// Largest error left 3 s after a step: half a setpoint step
+#define M_FINAL_ERROR_MAX (MOTOR_ENCODER_RANGE / 255 / 2)
+
+typedef struct
+{
+    double position;
+    double velocity;
+    // Held in place, as if the racket were blocked
+    bool blocked;
+} m_plant_t;
+
+typedef struct
+{
+    uint32_t rise_ms;    // 10% to 90% of the step
+    uint32_t settle_ms;  // until it stays within M_SETTLE_BAND
+    double overshoot;    // fraction of the step
+    double final_error;  // counts, at the end of the run
+    uint32_t saturated_ms;
+} m_step_metrics_t;
+
+static m_plant_t m_plant;
+
+// Signed output the driver gave the motor box: DAC value and direction pin
+static int32_t m_drive_read(void)
+{
+    int32_t output = (int32_t) g_dacc.DACC_CDR;
+    bool forward = g_piod.PIO_SODR & MOTOR_DIR_PIN;
+    bool reverse = g_piod.PIO_CODR & MOTOR_DIR_PIN;
+
+    TEST_CHECK(forward != reverse);
+    TEST_CHECK(output >= 0 && output <= MOTOR_OUTPUT_MAX);
+    g_piod.PIO_SODR = 0;
+    g_piod.PIO_CODR = 0;
+
+    return reverse ? -output : output;
+}
+
+static void m_plant_step(int32_t drive)
+{
+    double magnitude = abs(drive) > M_PLANT_DEADBAND ? abs(drive) - M_PLANT_DEADBAND : 0;
+    double speed = M_PLANT_MAX_SPEED * magnitude / (MOTOR_OUTPUT_MAX - M_PLANT_DEADBAND);
+    double target = drive < 0 ? -speed : speed;
+
+    if (m_plant.blocked)
+    {
+        m_plant.velocity = 0;
+        return;
+    }
+
+    m_plant.velocity += (target - m_plant.velocity) * M_DT_S / M_PLANT_TAU_S;
+    m_plant.position += m_plant.velocity * M_DT_S;
+
+    // End stops
+    if (m_plant.position < 0)
+    {
+        m_plant.position = 0;
+        m_plant.velocity = 0;
+    }
+    else if (m_plant.position > MOTOR_ENCODER_RANGE)
+    {
+        m_plant.position = MOTOR_ENCODER_RANGE;
+        m_plant.velocity = 0;
+    }
+}
+
+// One control loop period: sample the encoder, run the loop, move the plant
+static void m_tick(void)
+{
+    g_tc2.TC_CHANNEL[0].TC_CV = (uint32_t) (int32_t) lround(m_plant.position);
+    g_tc1.TC_CHANNEL[0].TC_SR = TC_SR_CPCS;
+    TC3_Handler();
+    g_tc1.TC_CHANNEL[0].TC_SR = 0;
+
+    m_plant_step(m_drive_read());
+}
+
+static void m_init(void)
+{
+    sam_model_reset();
+    memset(&m_plant, 0, sizeof(m_plant));
+    motor_init();
+    g_piod.PIO_SODR = 0;
+    g_piod.PIO_CODR = 0;
+}
+
+// Step to `setpoint` and run for `ms`, measuring the response
+static void m_step(uint8_t setpoint, uint32_t ms, m_step_metrics_t *p_metrics, bool print)
+{
+    motor_status_t status;
+    double start = m_plant.position;
+
+    motor_setpoint_set(setpoint);
+    motor_status_get(&status);
+    double step = status.setpoint - start;
+    uint32_t saturated = status.saturated_count;
+
+    memset(p_metrics, 0, sizeof(*p_metrics));
+    uint32_t t10 = 0, t90 = 0;
+
+    for (uint32_t t = 1; t <= ms; t++)
+    {
+        m_tick();
+
+        double progress = (m_plant.position - start) / step;
+        if (!t10 && progress >= 0.1)
+        {
+            t10 = t;
+        }
+        if (!t90 && progress >= 0.9)
+        {
+            t90 = t;
+        }
+        if (progress - 1.0 > p_metrics->overshoot)
+        {
+            p_metrics->overshoot = progress - 1.0;
+        }
+        if (fabs(m_plant.position - status.setpoint) > M_SETTLE_BAND)
+        {
+            p_metrics->settle_ms = t;
+        }
+        if (print && t % 10 == 0)
+        {
+            motor_status_t now;
+            motor_status_get(&now);
+            printf("%6u ms  setpoint %5d  position %8.1f  output %5d\n",
+                   t, (int) status.setpoint, m_plant.position, now.output);
+        }
+    }
+
+    motor_status_get(&status);
+    p_metrics->rise_ms = t90 - t10;
+    p_metrics->final_error = m_plant.position - status.setpoint;
+    p_metrics->saturated_ms = status.saturated_count - saturated;
+}
+
+static void test_init_configures_hardware(void)
+{
+    sam_model_reset();
+    motor_init();
+
+    TEST_CHECK(g_tc2.TC_BMR & TC_BMR_QDEN);
+    TEST_CHECK(g_tc2.TC_BMR & TC_BMR_POSEN);
+    TEST_CHECK(g_tc2.TC_CHANNEL[0].TC_CMR == TC_CMR_TCCLKS_XC0);
+    TEST_CHECK(g_pioc.PIO_ABSR & (PIO_PC25B_TIOA6 | PIO_PC26B_TIOB6));
+    TEST_CHECK(g_dacc.DACC_CHER == 1u << MOTOR_DAC_CHANNEL);
+    TEST_CHECK(g_piod.PIO_SODR & MOTOR_EN_PIN);
+    // 1 kHz from MCK/2
+    TEST_CHECK(g_tc1.TC_CHANNEL[0].TC_RC * 2 * MOTOR_LOOP_RATE_HZ == SAM_MODEL_MCK_HZ);
+    TEST_CHECK(g_nvic_enabled[TC3_IRQn]);
+}
+
+static void test_setpoint_scaling(void)
+{
+    motor_status_t status;
+
+    m_init();
+    motor_setpoint_set(0);
+    motor_status_get(&status);
+    TEST_CHECK(status.setpoint == 0);
+    motor_setpoint_set(255);
+    motor_status_get(&status);
+    TEST_CHECK(status.setpoint == MOTOR_ENCODER_RANGE);
+}
+
+static void test_step_response(void)
+{
+    m_step_metrics_t metrics;
+
+    m_init();
+    m_step(128, 3000, &metrics, false);
+
+    // Half the range at full speed takes about 0.45 s in the model
+    TEST_CHECK(metrics.rise_ms < 400);
+    TEST_CHECK(metrics.settle_ms < 700);
+    TEST_CHECK(metrics.overshoot < 0.02);
+    TEST_CHECK(fabs(metrics.final_error) <= M_FINAL_ERROR_MAX);
+
+    // And back, from the other direction
+    m_step(32, 3000, &metrics, false);
+    TEST_CHECK(metrics.settle_ms < 700);
+    TEST_CHECK(metrics.overshoot < 0.02);
+    TEST_CHECK(fabs(metrics.final_error) <= M_FINAL_ERROR_MAX);
+}
+
+// A small step is inside the friction deadband for P alone, so the
+// integral has to finish it
+static void test_small_step_overcomes_friction(void)
+{
+    m_step_metrics_t metrics;
+
+    m_init();
+    m_step(128, 3000, &metrics, false);
+    m_step(129, 3000, &metrics, false);
+    TEST_CHECK(fabs(metrics.final_error) <= M_FINAL_ERROR_MAX);
+}
+
+// Held against a blocked racket the integral must not wind up past what the
+// output can use, so the racket does not fly past the setpoint on release
+static void test_anti_windup(void)
+{
+    m_step_metrics_t metrics;
+
+    m_init();
+    m_plant.blocked = true;
+    m_step(200, 3000, &metrics, false);
+    TEST_CHECK(metrics.saturated_ms > 2900);
+    TEST_CHECK(abs(m_integral) <= m_integral_max);
+
+    m_plant.blocked = false;
+    m_step(200, 3000, &metrics, false);
+    TEST_CHECK(metrics.overshoot < 0.10);
+    TEST_CHECK(fabs(metrics.final_error) <= M_FINAL_ERROR_MAX);
+}
+
+static void test_gains_update_limits_integral(void)
+{
+    m_init();
+    m_integral = -m_integral_max;
+    int32_t integral = m_integral;
+
+    motor_gains_set(&(motor_gains_t) { .kp = MOTOR_DEFAULT_KP, .ki = 4 * MOTOR_DEFAULT_KI, .kd = MOTOR_DEFAULT_KD });
+    TEST_CHECK(m_integral_max == ((int32_t) MOTOR_OUTPUT_MAX << (GAIN_SHIFT + INTEGRAL_SHIFT)) / (4 * MOTOR_DEFAULT_KI));
+    TEST_CHECK(m_integral == -m_integral_max && m_integral > integral);
+
+    // No integral action at all with ki = 0
+    motor_gains_set(&(motor_gains_t) { .kp = MOTOR_DEFAULT_KP, .ki = 0, .kd = MOTOR_DEFAULT_KD });
+    TEST_CHECK(m_integral == 0);
+    TEST_CHECK(g_nvic_enabled[TC3_IRQn]);
+}
+
+static int m_tune(int argc, char **argv)
+{
+    m_step_metrics_t metrics;
+
+    if (argc != 5)
+    {
+        printf("usage: %s tune kp ki kd\n", argv[0]);
+        return 1;
+    }
+
+    m_init();
+    motor_gains_set(&(motor_gains_t) {
+        .kp = (int16_t) atoi(argv[2]), .ki = (int16_t) atoi(argv[3]), .kd = (int16_t) atoi(argv[4]) });
+    m_step(128, 3000, &metrics, true);
+
+    printf("rise %u ms, settle %u ms, overshoot %.1f%%, final error %.1f counts, saturated %u ms\n",
+           metrics.rise_ms, metrics.settle_ms, metrics.overshoot * 100, metrics.final_error,
+           metrics.saturated_ms);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "tune") == 0)
+    {
+        return m_tune(argc, argv);
+    }
+
+    TEST_RUN(test_init_configures_hardware);
+    TEST_RUN(test_setpoint_scaling);
+    TEST_RUN(test_step_response);
+    TEST_RUN(test_small_step_overcomes_friction);
+    TEST_RUN(test_anti_windup);
+    TEST_RUN(test_gains_update_limits_integral);
+
+    return TEST_RESULT();
+}
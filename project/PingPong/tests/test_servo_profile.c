@@ -0,0 +1,260 @@
+/*
+ * Host simulation of the servo motion profile (Node2/servo.c), driven by
+ * the TC0 backend one PWM period at a time.
+ *
+ * Run with "plot" as the argument to print commanded against achieved
+ * position for a full-range move and a reversal.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "test.h"
+#include "sam_model.h"
+#include "../Node2/servo.c"
+
+#define M_PERIODS_MAX (1000)
+
+typedef struct
+{
+    uint16_t target;
+    // Position and velocity in 1/256 positions (per period)
+    int32_t position_fp;
+    int32_t velocity_fp;
+    bool moving;
+} m_sample_t;
+
+static m_sample_t m_trace[M_PERIODS_MAX];
+static uint16_t m_trace_len;
+
+// One PWM period: RC compare ends the period and raises the interrupt
+static void m_period(void)
+{
+    g_tc0.TC_CHANNEL[0].TC_SR = TC_SR_CPCS;
+    if (g_nvic_enabled[TC0_IRQn])
+    {
+        TC0_Handler();
+    }
+    g_tc0.TC_CHANNEL[0].TC_SR = 0;
+
+    if (m_trace_len < M_PERIODS_MAX)
+    {
+        m_trace[m_trace_len++] = (m_sample_t) {
+            .target = (uint16_t) (m_target_fp >> FP_SHIFT),
+            .position_fp = m_position_fp,
+            .velocity_fp = m_velocity_fp,
+            .moving = m_moving,
+        };
+    }
+}
+
+// Run until the servo stops, returns the number of periods
+static uint16_t m_run_until_stopped(void)
+{
+    uint16_t periods = 0;
+
+    while (m_moving && periods < M_PERIODS_MAX)
+    {
+        m_period();
+        periods++;
+    }
+    return periods;
+}
+
+static void m_init(void)
+{
+    sam_model_reset();
+    servo_init(SERVO_BACKEND_TC);
+    m_trace_len = 0;
+}
+
+// Velocity and acceleration within limits, and no step past the target
+static void m_check_trace(int32_t max_velocity_fp, int32_t acceleration_fp)
+{
+    m_sample_t previous = m_trace[0];
+
+    for (uint16_t i = 1; i < m_trace_len; i++)
+    {
+        const m_sample_t *p_sample = &m_trace[i];
+        int32_t target_fp = (int32_t) p_sample->target << FP_SHIFT;
+
+        TEST_CHECK(m_abs(p_sample->velocity_fp) <= max_velocity_fp);
+        TEST_CHECK(m_abs(p_sample->velocity_fp - previous.velocity_fp) <= acceleration_fp);
+        if (p_sample->target == previous.target && previous.position_fp <= target_fp)
+        {
+            TEST_CHECK(p_sample->position_fp <= target_fp);
+        }
+        if (p_sample->target == previous.target && previous.position_fp >= target_fp)
+        {
+            TEST_CHECK(p_sample->position_fp >= target_fp);
+        }
+        previous = *p_sample;
+    }
+}
+
+static void test_full_range_move_is_trapezoidal(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    uint16_t periods = m_run_until_stopped();
+
+    m_check_trace(m_max_velocity_fp, m_acceleration_fp);
+    servo_status_get(&status);
+    TEST_CHECK(status.position == SERVO_POSITION_COUNT - 1);
+    TEST_CHECK(!status.moving);
+
+    // 59 positions: 0.2 s to reach 240/s over 24 positions, the same to
+    // stop, and 11 positions at full speed
+    TEST_CHECK(status.last_settle_ms == periods * SERVO_PWM_PERIOD_MS);
+    TEST_CHECK(status.last_settle_ms >= 420 && status.last_settle_ms <= 500);
+
+    // Reaches the velocity limit in the middle of the move
+    int32_t peak_fp = 0;
+    for (uint16_t i = 0; i < m_trace_len; i++)
+    {
+        peak_fp = m_trace[i].velocity_fp > peak_fp ? m_trace[i].velocity_fp : peak_fp;
+    }
+    TEST_CHECK(peak_fp == m_max_velocity_fp);
+    // The servo output follows the profile
+    TEST_CHECK(g_tc0.TC_CHANNEL[0].TC_RA == TC_RA_VALUE(SERVO_MIN_STEPS + SERVO_POSITION_COUNT - 1));
+}
+
+static void test_short_move_never_reaches_full_speed(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(SERVO_NEUTRAL_POS + 5);
+    (void) m_run_until_stopped();
+
+    m_check_trace(m_max_velocity_fp, m_acceleration_fp);
+    for (uint16_t i = 0; i < m_trace_len; i++)
+    {
+        TEST_CHECK(m_trace[i].velocity_fp < m_max_velocity_fp);
+    }
+    servo_status_get(&status);
+    TEST_CHECK(status.position == SERVO_NEUTRAL_POS + 5);
+}
+
+static void test_reversal_mid_move(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    for (int i = 0; i < 10; i++)
+    {
+        m_period();
+    }
+    TEST_CHECK(m_velocity_fp > 0);
+    servo_target_set(0);
+    (void) m_run_until_stopped();
+
+    m_check_trace(m_max_velocity_fp, m_acceleration_fp);
+    servo_status_get(&status);
+    TEST_CHECK(status.position == 0);
+    TEST_CHECK(!status.moving);
+}
+
+static void test_retarget_while_moving_keeps_start_time(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(SERVO_NEUTRAL_POS + 20);
+    for (int i = 0; i < 5; i++)
+    {
+        m_period();
+    }
+    servo_target_set(SERVO_NEUTRAL_POS + 30);
+    uint16_t periods = 5 + m_run_until_stopped();
+
+    servo_status_get(&status);
+    TEST_CHECK(status.last_settle_ms == periods * SERVO_PWM_PERIOD_MS);
+}
+
+static void test_stop_decelerates(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    for (int i = 0; i < 20; i++)
+    {
+        m_period();
+    }
+    int32_t position_fp = m_position_fp;
+    servo_stop();
+    (void) m_run_until_stopped();
+
+    m_check_trace(m_max_velocity_fp, m_acceleration_fp);
+    servo_status_get(&status);
+    TEST_CHECK(!status.moving);
+    TEST_CHECK(status.position > (position_fp >> FP_SHIFT));
+    TEST_CHECK(status.position < SERVO_POSITION_COUNT - 1);
+    TEST_CHECK((m_position_fp & (FP_ONE - 1)) == 0);
+}
+
+static void test_limits(void)
+{
+    m_init();
+    int32_t max_velocity_fp = m_max_velocity_fp;
+
+    servo_limits_set(0, 100);
+    TEST_CHECK(m_max_velocity_fp == max_velocity_fp);
+
+    servo_limits_set(60, 600);
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    (void) m_run_until_stopped();
+    m_check_trace(((int32_t) 60 << FP_SHIFT) / SERVO_PWM_RATE_HZ, m_acceleration_fp);
+    TEST_CHECK(!m_moving);
+}
+
+// Commanded and achieved position, one row per period
+static void m_plot(void)
+{
+    m_init();
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    for (int i = 0; i < 30; i++)
+    {
+        m_period();
+    }
+    servo_target_set(20);
+    (void) m_run_until_stopped();
+
+    printf("period  target  position  velocity/s\n");
+    for (uint16_t i = 0; i < m_trace_len; i++)
+    {
+        const m_sample_t *p_sample = &m_trace[i];
+        char row[SERVO_POSITION_COUNT / 2 + 1];
+
+        memset(row, ' ', sizeof(row) - 1);
+        row[sizeof(row) - 1] = '\0';
+        row[p_sample->target / 2] = '|';
+        row[(p_sample->position_fp >> FP_SHIFT) / 2] = '*';
+
+        printf("%6u  %6u  %8.2f  %10.1f  %s\n", i, p_sample->target,
+               p_sample->position_fp / (double) FP_ONE,
+               p_sample->velocity_fp * SERVO_PWM_RATE_HZ / (double) FP_ONE, row);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "plot") == 0)
+    {
+        m_plot();
+        return 0;
+    }
+
+    TEST_RUN(test_full_range_move_is_trapezoidal);
+    TEST_RUN(test_short_move_never_reaches_full_speed);
+    TEST_RUN(test_reversal_mid_move);
+    TEST_RUN(test_retarget_while_moving_keeps_start_time);
+    TEST_RUN(test_stop_decelerates);
+    TEST_RUN(test_limits);
+
+    return TEST_RESULT();
+}
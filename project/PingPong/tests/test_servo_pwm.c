@@ -0,0 +1,185 @@
+/*
+ * Host test of the PWM controller backend of the servo (Node2/servo.c). The
+ * register configuration is run through a model of a left-aligned PWM
+ * channel to get the pulse the servo sees on PWML5.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#include "sam_model.h"
+#include "../Node2/servo.c"
+
+#define M_CH (&g_pwm.PWM_CH_NUM[PWM_SERVO_CHANNEL])
+
+// Channel clock divider selected by CPRE, for CLKA only
+static uint32_t m_channel_clock_div(void)
+{
+    uint32_t prea = (g_pwm.PWM_CLK >> 8) & 0xF;
+    uint32_t diva = g_pwm.PWM_CLK & 0xFF;
+
+    TEST_CHECK((M_CH->PWM_CMR & PWM_CMR_CPRE_Msk) == PWM_CMR_CPRE_CLKA);
+    TEST_CHECK(diva != 0);
+    return (1UL << prea) * diva;
+}
+
+// The comparator output starts each period at the CPOL level and changes
+// when the counter reaches CDTY. PWML is its complement, as dead time is off.
+static uint32_t m_pwml_high_counts(void)
+{
+    TEST_CHECK(!(M_CH->PWM_CMR & PWM_CMR_CALG));
+    return (M_CH->PWM_CMR & PWM_CMR_CPOL) ? M_CH->PWM_CPRD - M_CH->PWM_CDTY : M_CH->PWM_CDTY;
+}
+
+static uint32_t m_counts_to_us(uint32_t counts)
+{
+    uint64_t ticks = (uint64_t) counts * m_channel_clock_div() * 1000000UL;
+    return (uint32_t) ((ticks + SAM_MODEL_MCK_HZ / 2) / SAM_MODEL_MCK_HZ);
+}
+
+static uint32_t m_pulse_us(void)
+{
+    return m_counts_to_us(m_pwml_high_counts());
+}
+
+// One PWM period: the duty update is latched at the start of the period,
+// which raises the channel counter event
+static void m_period(void)
+{
+    if (M_CH->PWM_CDTYUPD)
+    {
+        M_CH->PWM_CDTY = M_CH->PWM_CDTYUPD;
+        M_CH->PWM_CDTYUPD = 0;
+    }
+    g_pwm.PWM_ISR1 = PWM_ISR1_CHID0 << PWM_SERVO_CHANNEL;
+    if (g_nvic_enabled[PWM_IRQn])
+    {
+        PWM_Handler();
+    }
+    g_pwm.PWM_ISR1 = 0;
+}
+
+static void m_settle(void)
+{
+    servo_status_t status;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        m_period();
+        servo_status_get(&status);
+        if (!status.moving)
+        {
+            break;
+        }
+    }
+    // One more period to latch the last update
+    m_period();
+    TEST_CHECK(!status.moving);
+}
+
+static void m_init(void)
+{
+    sam_model_reset();
+    servo_init(SERVO_BACKEND_PWM);
+}
+
+static void test_init_configures_channel(void)
+{
+    m_init();
+
+    TEST_CHECK(g_pmc.PMC_PCER1 & (1u << (ID_PWM - 32)));
+    TEST_CHECK(g_pioc.PIO_PDR & PIO_PC22B_PWML5);
+    TEST_CHECK(g_pioc.PIO_ABSR & PIO_PC22B_PWML5);
+    TEST_CHECK(g_pwm.PWM_ENA & (1u << PWM_SERVO_CHANNEL));
+    TEST_CHECK(g_pwm.PWM_IER1 & (PWM_IER1_CHID0 << PWM_SERVO_CHANNEL));
+    TEST_CHECK(g_nvic_enabled[PWM_IRQn]);
+    TEST_CHECK(!g_nvic_enabled[TC0_IRQn]);
+    // 50 Hz
+    TEST_CHECK(m_counts_to_us(M_CH->PWM_CPRD) == 20000);
+}
+
+static void test_pulse_is_active_high(void)
+{
+    m_init();
+
+    TEST_CHECK(!(M_CH->PWM_CMR & PWM_CMR_CPOL));
+    TEST_CHECK(m_pulse_us() == 1500);
+}
+
+static void test_range_endpoints(void)
+{
+    m_init();
+
+    servo_target_set(0);
+    m_settle();
+    TEST_CHECK(m_pulse_us() == 900);
+
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    m_settle();
+    TEST_CHECK(m_pulse_us() == 900 + 10 * (SERVO_POSITION_COUNT - 1));
+
+    // Clamped to the range
+    servo_target_set(UINT16_MAX);
+    m_settle();
+    TEST_CHECK(m_pulse_us() == 900 + 10 * (SERVO_POSITION_COUNT - 1));
+}
+
+static void test_duty_updates_are_buffered(void)
+{
+    m_init();
+
+    uint32_t cdty = M_CH->PWM_CDTY;
+    servo_target_set(0);
+    g_pwm.PWM_ISR1 = PWM_ISR1_CHID0 << PWM_SERVO_CHANNEL;
+    PWM_Handler();
+
+    // Written to the update register only, the running period is unchanged
+    TEST_CHECK(M_CH->PWM_CDTY == cdty);
+    TEST_CHECK(M_CH->PWM_CDTYUPD != 0 && M_CH->PWM_CDTYUPD < cdty);
+}
+
+static void test_pulse_moves_monotonically(void)
+{
+    servo_status_t status;
+    uint32_t previous;
+
+    m_init();
+    servo_target_set(SERVO_POSITION_COUNT - 1);
+    previous = m_pulse_us();
+
+    do
+    {
+        m_period();
+        uint32_t pulse = m_pulse_us();
+        TEST_CHECK(pulse >= previous);
+        TEST_CHECK(pulse >= 900 && pulse <= 2100);
+        previous = pulse;
+        servo_status_get(&status);
+    } while (status.moving);
+}
+
+// Other channel events must not advance the profile
+static void test_other_channel_events_ignored(void)
+{
+    servo_status_t status;
+
+    m_init();
+    servo_target_set(0);
+    g_pwm.PWM_ISR1 = PWM_ISR1_CHID0 << 0;
+    PWM_Handler();
+    servo_status_get(&status);
+    TEST_CHECK(status.position == SERVO_NEUTRAL_POS);
+    TEST_CHECK(M_CH->PWM_CDTYUPD == 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_init_configures_channel);
+    TEST_RUN(test_pulse_is_active_high);
+    TEST_RUN(test_range_endpoints);
+    TEST_RUN(test_duty_updates_are_buffered);
+    TEST_RUN(test_pulse_moves_monotonically);
+    TEST_RUN(test_other_channel_events_ignored);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,283 @@
+/*
+ * Host test of the solenoid driver (Node2/solenoid.c) and a trace-point
+ * simulation of the path from a button edge on Node1 to the coil on Node2,
+ * checked against CAN_BUTTON_LATENCY_BUDGET_US.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "test.h"
+#include "sam_model.h"
+#include "CAN.h"
+#include "../Node2/solenoid.c"
+
+#define M_US_TO_TICKS(us) ((uint32_t) (((uint64_t) (us) * TIMER_TICKS_PER_MS) / 1000))
+#define M_TICKS_TO_US(ticks) ((uint32_t) (((uint64_t) (ticks) * 1000) / TIMER_TICKS_PER_MS))
+
+// Node2 timer, in ticks of TIMER_TICKS_PER_MS
+static uint32_t m_ticks;
+
+uint32_t timer_ticks_get(void)
+{
+    return m_ticks;
+}
+
+// Coil pin as driven by the driver
+static bool m_coil_on(void)
+{
+    bool on = g_pioc.PIO_SODR & SOLENOID_PIN;
+    bool off = g_pioc.PIO_CODR & SOLENOID_PIN;
+
+    TEST_CHECK(!(on && off));
+    return on;
+}
+
+static void m_pins_clear(void)
+{
+    g_pioc.PIO_SODR = 0;
+    g_pioc.PIO_CODR = 0;
+}
+
+// The pulse timer reaches RC
+static void m_pulse_end(void)
+{
+    g_tc1.TC_CHANNEL[1].TC_SR = TC_SR_CPCS;
+    TC4_Handler();
+    g_tc1.TC_CHANNEL[1].TC_SR = 0;
+}
+
+static void m_init(void)
+{
+    sam_model_reset();
+    m_ticks = 0;
+    solenoid_init();
+    m_pins_clear();
+}
+
+static void test_init(void)
+{
+    sam_model_reset();
+    solenoid_init();
+
+    TEST_CHECK(g_pioc.PIO_OER & SOLENOID_PIN);
+    TEST_CHECK(g_pioc.PIO_CODR & SOLENOID_PIN);
+    TEST_CHECK(g_tc1.TC_CHANNEL[1].TC_CMR & TC_CMR_CPCSTOP);
+    TEST_CHECK(g_tc1.TC_CHANNEL[1].TC_RC == SOLENOID_DEFAULT_PULSE_MS * SOLENOID_TICKS_PER_MS);
+    TEST_CHECK(g_nvic_enabled[TC4_IRQn]);
+}
+
+static void test_pulse(void)
+{
+    m_init();
+
+    TEST_CHECK(solenoid_fire(m_ticks));
+    TEST_CHECK(m_coil_on());
+    TEST_CHECK(g_tc1.TC_CHANNEL[1].TC_CCR == (TC_CCR_CLKEN | TC_CCR_SWTRG));
+    TEST_CHECK(g_primask == 0);
+    m_pins_clear();
+
+    m_pulse_end();
+    TEST_CHECK(g_pioc.PIO_CODR & SOLENOID_PIN);
+    TEST_CHECK(!m_active);
+}
+
+static void test_rate_limit(void)
+{
+    solenoid_stats_t stats;
+
+    m_init();
+    TEST_CHECK(solenoid_fire(m_ticks));
+
+    // Still energized
+    m_ticks += M_US_TO_TICKS(1000);
+    TEST_CHECK(!solenoid_fire(m_ticks));
+    m_pulse_end();
+
+    // Within the re-trigger interval
+    m_ticks = M_US_TO_TICKS(SOLENOID_DEFAULT_MIN_INTERVAL_MS * 1000UL - 10);
+    TEST_CHECK(!solenoid_fire(m_ticks));
+    m_ticks = M_US_TO_TICKS(SOLENOID_DEFAULT_MIN_INTERVAL_MS * 1000UL);
+    TEST_CHECK(solenoid_fire(m_ticks));
+
+    solenoid_stats_get(&stats);
+    TEST_CHECK(stats.fire_count == 2);
+    TEST_CHECK(stats.reject_count == 2);
+    TEST_CHECK(g_primask == 0);
+
+    // Called with interrupts masked, they stay masked
+    __disable_irq();
+    solenoid_stats_get(&stats);
+    TEST_CHECK(g_primask == 1);
+    __enable_irq();
+}
+
+static void test_config(void)
+{
+    m_init();
+
+    solenoid_config_set(50, 10);
+    TEST_CHECK(g_tc1.TC_CHANNEL[1].TC_RC == 50 * SOLENOID_TICKS_PER_MS);
+    TEST_CHECK(m_min_interval_ticks == 50 * TIMER_TICKS_PER_MS);
+
+    // Ignored
+    solenoid_config_set(0, 100);
+    TEST_CHECK(g_tc1.TC_CHANNEL[1].TC_RC == 50 * SOLENOID_TICKS_PER_MS);
+}
+
+static void test_latency_trace(void)
+{
+    solenoid_stats_t stats;
+
+    m_init();
+    m_ticks = M_US_TO_TICKS(1000);
+    TEST_CHECK(solenoid_fire(M_US_TO_TICKS(1000 - 40)));
+    m_pulse_end();
+
+    m_ticks += M_US_TO_TICKS(SOLENOID_DEFAULT_MIN_INTERVAL_MS * 1000UL);
+    TEST_CHECK(solenoid_fire(m_ticks - M_US_TO_TICKS(2 * SOLENOID_LATENCY_BUDGET_US)));
+
+    solenoid_stats_get(&stats);
+    TEST_CHECK(stats.fire_count == 2);
+    TEST_CHECK(stats.worst_latency_us == 2 * SOLENOID_LATENCY_BUDGET_US);
+    TEST_CHECK(stats.budget_miss_count == 1);
+}
+
+/*
+ * Trace-point simulation of the whole path. Each button edge is followed
+ * through the trace points below, with the Node1 task start and the frame
+ * already on the bus varied from none to their worst case:
+ *   T0 edge at the button
+ *   T1 buttons task samples it (released every CAN_BUTTON_POLL_PERIOD_MS)
+ *   T2 frame queued, the task finishing within its deadline
+ *   T3 frame received by Node2, after any frame in progress and its own
+ *   T4 coil energized by solenoid_fire() from the receive interrupt
+ */
+
+// Bits of a standard data frame with `len` data bytes, with the worst-case
+// stuffing and the interframe space
+static uint32_t m_frame_bits(uint8_t len)
+{
+    // SOF, ID, RTR, IDE, r0, DLC, data, CRC
+    uint32_t stuffed = 1 + 11 + 1 + 1 + 1 + 4 + 8 * len + 15;
+    // CRC delimiter, ACK, ACK delimiter, EOF, IFS
+    return stuffed + (stuffed - 1) / 4 + 1 + 1 + 1 + 7 + 3;
+}
+
+static uint32_t m_frame_us(uint8_t len)
+{
+    return (uint32_t) ((m_frame_bits(len) * 1000000ULL + CAN_BITRATE - 1) / CAN_BITRATE);
+}
+
+// Receive interrupt entry and the handler up to the coil, on Node2
+#define M_NODE2_RX_HANDLING_US (30)
+
+// Deterministic pseudo-random numbers for the simulation
+static uint32_t m_random_state = 1;
+
+static uint32_t m_random(uint32_t max)
+{
+    m_random_state = m_random_state * 1103515245u + 12345u;
+    return (m_random_state >> 8) % (max + 1);
+}
+
+typedef struct
+{
+    uint32_t t[5];
+} m_trace_t;
+
+static void m_trace_edge(uint32_t edge_us, bool worst, m_trace_t *p_trace)
+{
+    const uint32_t period_us = CAN_BUTTON_POLL_PERIOD_MS * 1000UL;
+    const uint32_t deadline_us = CAN_BUTTON_TASK_DEADLINE_MS * 1000UL;
+
+    p_trace->t[0] = edge_us;
+
+    // The task samples the buttons at the start of its run and queues the
+    // frame before its deadline. Starting late samples later, which is the
+    // worst case for an edge just missed by the previous run.
+    uint32_t release_us = (edge_us / period_us + 1) * period_us;
+    p_trace->t[1] = release_us + (worst ? deadline_us : m_random(deadline_us));
+    p_trace->t[2] = worst ? release_us + deadline_us : p_trace->t[1] + m_random(release_us + deadline_us - p_trace->t[1]);
+
+    // Waits for an 8-byte frame on the bus, then sends the 3-byte button frame
+    uint32_t blocked_us = worst ? m_frame_us(8) : m_random(m_frame_us(8));
+    p_trace->t[3] = p_trace->t[2] + blocked_us + m_frame_us(3);
+
+    // Node2: timestamp in the receive interrupt, then fire
+    uint32_t rx_ticks = M_US_TO_TICKS(p_trace->t[3]);
+    m_ticks = rx_ticks + M_US_TO_TICKS(M_NODE2_RX_HANDLING_US);
+    m_pins_clear();
+    TEST_CHECK(solenoid_fire(rx_ticks));
+    TEST_CHECK(m_coil_on());
+    p_trace->t[4] = M_TICKS_TO_US(m_ticks);
+    m_pulse_end();
+}
+
+_Static_assert(CAN_BUTTON_POLL_PERIOD_MS * 1000UL + CAN_BUTTON_TASK_DEADLINE_MS * 1000UL +
+               CAN_BUTTON_BUS_BUDGET_US + SOLENOID_LATENCY_BUDGET_US <= CAN_BUTTON_LATENCY_BUDGET_US,
+               "the parts of the button latency budget exceed the total");
+
+static void test_button_to_coil_budget(void)
+{
+    solenoid_stats_t stats;
+    uint32_t worst_total_us = 0;
+    uint32_t worst_stage_us[4] = { 0 };
+    uint32_t worst_node1_us = 0;
+    uint32_t base_us = 0;
+
+    m_init();
+
+    TEST_CHECK(m_frame_us(8) + m_frame_us(3) <= CAN_BUTTON_BUS_BUDGET_US);
+
+    // Edges at every phase of the poll period, each after the re-trigger
+    // interval has passed
+    for (uint32_t phase_us = 0; phase_us < CAN_BUTTON_POLL_PERIOD_MS * 1000UL; phase_us += 13)
+    {
+        for (int worst = 0; worst < 2; worst++)
+        {
+            m_trace_t trace;
+
+            base_us += SOLENOID_DEFAULT_MIN_INTERVAL_MS * 1000UL + 20000UL;
+            base_us -= base_us % (CAN_BUTTON_POLL_PERIOD_MS * 1000UL);
+            m_trace_edge(base_us + phase_us, worst, &trace);
+
+            for (int stage = 0; stage < 4; stage++)
+            {
+                uint32_t stage_us = trace.t[stage + 1] - trace.t[stage];
+                worst_stage_us[stage] = stage_us > worst_stage_us[stage] ? stage_us : worst_stage_us[stage];
+            }
+            uint32_t node1_us = trace.t[2] - trace.t[0];
+            worst_node1_us = node1_us > worst_node1_us ? node1_us : worst_node1_us;
+            uint32_t total_us = trace.t[4] - trace.t[0];
+            worst_total_us = total_us > worst_total_us ? total_us : worst_total_us;
+        }
+    }
+
+    TEST_CHECK(worst_node1_us <= CAN_BUTTON_POLL_PERIOD_MS * 1000UL + CAN_BUTTON_TASK_DEADLINE_MS * 1000UL);
+    TEST_CHECK(worst_stage_us[2] <= CAN_BUTTON_BUS_BUDGET_US);
+    TEST_CHECK(worst_stage_us[3] <= SOLENOID_LATENCY_BUDGET_US);
+    TEST_CHECK(worst_total_us <= CAN_BUTTON_LATENCY_BUDGET_US);
+
+    // Node2's own trace point agrees with the simulation
+    solenoid_stats_get(&stats);
+    TEST_CHECK(stats.worst_latency_us == worst_stage_us[3]);
+    TEST_CHECK(stats.budget_miss_count == 0);
+    TEST_CHECK(stats.reject_count == 0);
+
+    printf("button to coil: worst %u us of %u us (node1 %u, bus %u, node2 %u)\n",
+           worst_total_us, CAN_BUTTON_LATENCY_BUDGET_US, worst_node1_us,
+           worst_stage_us[2], worst_stage_us[3]);
+}
+
+int main(void)
+{
+    TEST_RUN(test_init);
+    TEST_RUN(test_pulse);
+    TEST_RUN(test_rate_limit);
+    TEST_RUN(test_config);
+    TEST_RUN(test_latency_trace);
+    TEST_RUN(test_button_to_coil_budget);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,210 @@
+/*
+ * Host test of the external SRAM self-test (PingPong/sram_test.c) against a
+ * model of the 2 KB SRAM with injected data and address line faults.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "test.h"
+
+static uint8_t m_sim_read(uint16_t offset);
+static void m_sim_write(uint16_t offset, uint8_t value);
+
+#define SRAM_TEST_READ(offset) m_sim_read(offset)
+#define SRAM_TEST_WRITE(offset, value) m_sim_write(offset, value)
+#include "../PingPong/sram_test.c"
+
+volatile uint8_t SREG;
+
+static uint8_t m_cells[EXT_SRAM_MEM_SIZE];
+// Address lines forced to 0 or 1, and data bits stuck at 1
+static uint16_t m_addr_stuck_low;
+static uint16_t m_addr_stuck_high;
+// Address line m_short_a follows m_short_b (wired AND when both are set)
+static uint16_t m_short_a;
+static uint16_t m_short_b;
+static uint8_t m_data_stuck_high;
+
+static uint16_t m_decode(uint16_t offset)
+{
+    uint16_t addr = (offset & ~m_addr_stuck_low) | m_addr_stuck_high;
+
+    if (m_short_a && !(addr & m_short_b))
+    {
+        addr &= ~m_short_a;
+    }
+    return addr % EXT_SRAM_MEM_SIZE;
+}
+
+static uint8_t m_sim_read(uint16_t offset)
+{
+    return m_cells[m_decode(offset)] | m_data_stuck_high;
+}
+
+static void m_sim_write(uint16_t offset, uint8_t value)
+{
+    m_cells[m_decode(offset)] = value;
+}
+
+uint32_t profiler_cycles_get(void)
+{
+    static uint32_t cycles;
+    return cycles += 100;
+}
+
+static void m_reset(void)
+{
+    m_addr_stuck_low = 0;
+    m_addr_stuck_high = 0;
+    m_short_a = 0;
+    m_short_b = 0;
+    m_data_stuck_high = 0;
+    for (uint16_t i = 0; i < EXT_SRAM_MEM_SIZE; i++)
+    {
+        m_cells[i] = (uint8_t) rand();
+    }
+}
+
+static bool m_run_full(sram_test_result_t *p_result)
+{
+    return sram_test_run(0, EXT_SRAM_MEM_SIZE, p_result);
+}
+
+static void test_fault_free_passes_and_keeps_contents(void)
+{
+    uint8_t before[EXT_SRAM_MEM_SIZE];
+    sram_test_result_t result;
+
+    m_reset();
+    memcpy(before, m_cells, sizeof(before));
+
+    TEST_CHECK(m_run_full(&result));
+    TEST_CHECK(result.fault_count == 0);
+    TEST_CHECK(result.address_fault_count == 0);
+    TEST_CHECK(result.pass_count == 1);
+    TEST_CHECK(result.bytes_tested == EXT_SRAM_MEM_SIZE);
+    TEST_CHECK(memcmp(before, m_cells, sizeof(before)) == 0);
+}
+
+static void test_stuck_data_bit_found(void)
+{
+    sram_test_result_t result;
+
+    m_reset();
+    m_data_stuck_high = 0x10;
+
+    TEST_CHECK(!m_run_full(&result));
+    TEST_CHECK(result.fault_count == EXT_SRAM_MEM_SIZE / SRAM_TEST_BLOCK_MAX);
+    TEST_CHECK(result.fault_addr[0] == EXT_SRAM_MEM_START);
+}
+
+static void test_stuck_address_lines_found(void)
+{
+    for (uint8_t bit = 0; bit < 11; bit++)
+    {
+        sram_test_result_t result;
+        uint16_t fault_offset;
+
+        m_reset();
+        m_addr_stuck_low = 1u << bit;
+        TEST_CHECK(!m_run_full(&result));
+        TEST_CHECK(result.address_fault_count == 1);
+        TEST_CHECK(!sram_test_address(0, EXT_SRAM_MEM_SIZE, &fault_offset));
+
+        m_reset();
+        m_addr_stuck_high = 1u << bit;
+        TEST_CHECK(!m_run_full(&result));
+        TEST_CHECK(result.address_fault_count == 1);
+        TEST_CHECK(!sram_test_address(0, EXT_SRAM_MEM_SIZE, &fault_offset));
+    }
+}
+
+// Lines above the block size alias whole blocks, which the blocks alone cannot see
+static void test_upper_address_lines_need_address_pass(void)
+{
+    uint16_t fault_offset;
+
+    m_reset();
+    m_addr_stuck_low = 1u << 10;
+    for (uint16_t offset = 0; offset < EXT_SRAM_MEM_SIZE; offset += SRAM_TEST_BLOCK_MAX)
+    {
+        TEST_CHECK(sram_test_block(offset, SRAM_TEST_BLOCK_MAX, NULL));
+    }
+    TEST_CHECK(!sram_test_address(0, EXT_SRAM_MEM_SIZE, &fault_offset));
+    TEST_CHECK(fault_offset == 1u << 10 || fault_offset == 0);
+}
+
+static void test_shorted_address_lines_found(void)
+{
+    sram_test_result_t result;
+
+    m_reset();
+    m_short_a = 1u << 5;
+    m_short_b = 1u << 9;
+
+    TEST_CHECK(!m_run_full(&result));
+    TEST_CHECK(result.address_fault_count == 1);
+}
+
+static void test_partial_region(void)
+{
+    sram_test_result_t result;
+
+    m_reset();
+    TEST_CHECK(sram_test_run(100, 37, &result));
+    TEST_CHECK(result.bytes_tested == 37);
+
+    // A region of 300 bytes only reaches A8
+    m_reset();
+    m_addr_stuck_low = 1u << 9;
+    TEST_CHECK(sram_test_run(0, 300, &result));
+    m_addr_stuck_low = 1u << 8;
+    TEST_CHECK(!sram_test_run(0, 300, &result));
+}
+
+static void test_step_spreads_passes(void)
+{
+    sram_test_t test;
+    uint16_t steps = 0;
+
+    m_reset();
+    TEST_CHECK(sram_test_init(&test, 0, EXT_SRAM_MEM_SIZE));
+    while (!sram_test_step(&test, SRAM_TEST_BLOCK_MAX))
+    {
+        steps++;
+    }
+    TEST_CHECK(steps == EXT_SRAM_MEM_SIZE / SRAM_TEST_BLOCK_MAX - 1);
+    TEST_CHECK(test.result.pass_count == 1);
+    TEST_CHECK(test.cursor == 0);
+}
+
+static void test_invalid_regions_rejected(void)
+{
+    sram_test_t test = { 0 };
+    sram_test_result_t result;
+
+    m_reset();
+    // A test that was never initialized must not loop forever
+    TEST_CHECK(!sram_test_step(&test, 16));
+    TEST_CHECK(!sram_test_init(&test, 0, 0));
+    TEST_CHECK(!sram_test_init(&test, EXT_SRAM_MEM_SIZE, 1));
+    TEST_CHECK(!sram_test_init(&test, 1, EXT_SRAM_MEM_SIZE));
+    TEST_CHECK(!sram_test_run(0, EXT_SRAM_MEM_SIZE + 1, &result));
+    TEST_CHECK(!sram_test_block(0, SRAM_TEST_BLOCK_MAX + 1, NULL));
+    TEST_CHECK(!sram_test_address(0, 0, NULL));
+}
+
+int main(void)
+{
+    TEST_RUN(test_fault_free_passes_and_keeps_contents);
+    TEST_RUN(test_stuck_data_bit_found);
+    TEST_RUN(test_stuck_address_lines_found);
+    TEST_RUN(test_upper_address_lines_need_address_pass);
+    TEST_RUN(test_shorted_address_lines_found);
+    TEST_RUN(test_partial_region);
+    TEST_RUN(test_step_spreads_passes);
+    TEST_RUN(test_invalid_regions_rejected);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,283 @@
+/*
+ * Host test of the external SRAM arena and pool allocators
+ * (PingPong/xmem.c): alignment, exhaustion and long allocation cycles.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "test.h"
+
+// The .xmem section flags are AVR assembler syntax, the default arena lives
+// in host RAM instead
+#include "../PingPong/xmem.h"
+#undef XMEM
+#define XMEM
+#include "../PingPong/xmem.c"
+
+volatile uint8_t SREG;
+
+#define M_MEM_SIZE (512)
+#define M_BLOCK_SIZE (16)
+#define M_BLOCK_COUNT (M_MEM_SIZE / M_BLOCK_SIZE)
+#define M_CYCLES (10000)
+
+static uint8_t m_mem[M_MEM_SIZE + 1] __attribute__((aligned(64)));
+
+static bool m_aligned(const void * p_mem, uint8_t align)
+{
+    return ((uintptr_t) p_mem & (align - 1)) == 0;
+}
+
+static void test_arena_alignment(void)
+{
+    xmem_arena_t arena;
+
+    // A base that is itself misaligned
+    xmem_arena_init(&arena, &m_mem[1], M_MEM_SIZE);
+
+    for (uint8_t align = 1; align <= 64; align <<= 1)
+    {
+        TEST_CHECK(xmem_arena_alloc(&arena, 1, 1) != NULL);
+        uint8_t * p_mem = xmem_arena_alloc(&arena, 3, align);
+        TEST_CHECK(p_mem != NULL);
+        TEST_CHECK(m_aligned(p_mem, align));
+        TEST_CHECK(p_mem >= &m_mem[1] && p_mem + 3 <= &m_mem[1] + M_MEM_SIZE);
+    }
+
+    // Padding is only added when needed
+    (void) xmem_arena_alloc(&arena, 0, 8);
+    uint16_t mark = xmem_arena_mark(&arena);
+    TEST_CHECK(xmem_arena_alloc(&arena, 8, 8) == &arena.p_base[mark]);
+}
+
+static void test_arena_exhaustion(void)
+{
+    xmem_arena_t arena;
+    xmem_stats_t stats;
+
+    xmem_arena_init(&arena, m_mem, M_MEM_SIZE);
+
+    TEST_CHECK(xmem_arena_alloc(&arena, M_MEM_SIZE + 1, 1) == NULL);
+    // Must not wrap around in the size check
+    TEST_CHECK(xmem_arena_alloc(&arena, UINT16_MAX, 1) == NULL);
+    TEST_CHECK(xmem_arena_alloc(&arena, M_MEM_SIZE - 1, 1) == m_mem);
+    TEST_CHECK(xmem_arena_alloc(&arena, 1, 1) == &m_mem[M_MEM_SIZE - 1]);
+    TEST_CHECK(xmem_arena_alloc(&arena, 1, 1) == NULL);
+    // Fits in size, but not once aligned
+    xmem_arena_release(&arena, M_MEM_SIZE - 2);
+    TEST_CHECK(xmem_arena_alloc(&arena, 1, 4) == NULL);
+    TEST_CHECK(xmem_arena_alloc(&arena, 2, 64) == NULL);
+
+    xmem_arena_stats_get(&arena, &stats);
+    TEST_CHECK(stats.capacity == M_MEM_SIZE);
+    TEST_CHECK(stats.used == M_MEM_SIZE - 2);
+    TEST_CHECK(stats.peak == M_MEM_SIZE);
+    TEST_CHECK(stats.fail_count == 5);
+}
+
+// Nested marks, as screens push and pop their buffers
+static void test_arena_mark_release_cycles(void)
+{
+    xmem_arena_t arena;
+    xmem_stats_t stats;
+    uint16_t marks[8];
+    uint8_t * p_first[8];
+    uint16_t sizes[8];
+    uint8_t depth = 0;
+    uint16_t peak = 0;
+
+    srand(1);
+    xmem_arena_init(&arena, m_mem, M_MEM_SIZE);
+
+    for (uint32_t cycle = 0; cycle < M_CYCLES; cycle++)
+    {
+        if (depth < NUMELTS(marks) && (depth == 0 || rand() % 2))
+        {
+            marks[depth] = xmem_arena_mark(&arena);
+            uint16_t size = (uint16_t) (rand() % 64);
+            uint8_t align = (uint8_t) (1 << (rand() % 4));
+            uint8_t * p_mem = xmem_arena_alloc(&arena, size, align);
+
+            if (p_mem)
+            {
+                TEST_CHECK(m_aligned(p_mem, align));
+                TEST_CHECK(p_mem >= &m_mem[marks[depth]] && p_mem + size <= &m_mem[M_MEM_SIZE]);
+                memset(p_mem, depth, size);
+                peak = arena.used > peak ? arena.used : peak;
+            }
+            sizes[depth] = size;
+            p_first[depth++] = p_mem;
+        }
+        else
+        {
+            depth--;
+            // The buffers below the mark are untouched
+            for (uint8_t i = 0; i < depth; i++)
+            {
+                TEST_CHECK(!p_first[i] || sizes[i] == 0 || p_first[i][sizes[i] - 1] == i);
+            }
+            xmem_arena_release(&arena, marks[depth]);
+            TEST_CHECK(xmem_arena_mark(&arena) == marks[depth]);
+        }
+    }
+
+    while (depth > 0)
+    {
+        xmem_arena_release(&arena, marks[--depth]);
+    }
+    xmem_arena_stats_get(&arena, &stats);
+    TEST_CHECK(stats.used == 0);
+    TEST_CHECK(stats.peak == peak);
+}
+
+static void test_pool_init_arguments(void)
+{
+    xmem_pool_t pool;
+
+    TEST_CHECK(!xmem_pool_init(NULL, m_mem, M_BLOCK_SIZE, M_BLOCK_COUNT));
+    TEST_CHECK(!xmem_pool_init(&pool, NULL, M_BLOCK_SIZE, M_BLOCK_COUNT));
+    TEST_CHECK(!xmem_pool_init(&pool, m_mem, sizeof(void *) - 1, M_BLOCK_COUNT));
+    TEST_CHECK(!xmem_pool_init(&pool, m_mem, M_BLOCK_SIZE, 0));
+    TEST_CHECK(xmem_pool_init(&pool, m_mem, sizeof(void *), 1));
+}
+
+static void test_pool_exhaustion(void)
+{
+    xmem_pool_t pool;
+    xmem_stats_t stats;
+    uint8_t * p_blocks[M_BLOCK_COUNT];
+
+    TEST_CHECK(xmem_pool_init(&pool, m_mem, M_BLOCK_SIZE, M_BLOCK_COUNT));
+
+    // Every block once, each at a block boundary
+    for (uint8_t i = 0; i < M_BLOCK_COUNT; i++)
+    {
+        p_blocks[i] = xmem_pool_alloc(&pool);
+        TEST_CHECK(p_blocks[i] != NULL);
+        TEST_CHECK((p_blocks[i] - m_mem) % M_BLOCK_SIZE == 0);
+        TEST_CHECK(p_blocks[i] >= m_mem && p_blocks[i] < &m_mem[M_MEM_SIZE]);
+        for (uint8_t j = 0; j < i; j++)
+        {
+            TEST_CHECK(p_blocks[j] != p_blocks[i]);
+        }
+    }
+    TEST_CHECK(xmem_pool_alloc(&pool) == NULL);
+    TEST_CHECK(xmem_pool_alloc(&pool) == NULL);
+
+    // The last block freed is the next one handed out
+    xmem_pool_free(&pool, p_blocks[7]);
+    xmem_pool_free(&pool, NULL);
+    TEST_CHECK(xmem_pool_alloc(&pool) == p_blocks[7]);
+
+    xmem_pool_stats_get(&pool, &stats);
+    TEST_CHECK(stats.capacity == M_BLOCK_COUNT);
+    TEST_CHECK(stats.used == M_BLOCK_COUNT);
+    TEST_CHECK(stats.peak == M_BLOCK_COUNT);
+    TEST_CHECK(stats.fail_count == 2);
+}
+
+// Allocation and free in random order, checking that no block is handed out
+// twice and that a block's contents survive other allocations
+static void test_pool_random_cycles(void)
+{
+    xmem_pool_t pool;
+    xmem_stats_t stats;
+    uint8_t * p_owned[M_BLOCK_COUNT] = { NULL };
+    uint8_t used = 0;
+    uint8_t peak = 0;
+
+    srand(2);
+    TEST_CHECK(xmem_pool_init(&pool, m_mem, M_BLOCK_SIZE, M_BLOCK_COUNT));
+
+    for (uint32_t cycle = 0; cycle < M_CYCLES; cycle++)
+    {
+        uint8_t slot = (uint8_t) (rand() % M_BLOCK_COUNT);
+
+        if (p_owned[slot])
+        {
+            // The free list link overwrites the block only once it is freed
+            for (uint8_t i = 0; i < M_BLOCK_SIZE; i++)
+            {
+                TEST_CHECK(p_owned[slot][i] == slot);
+            }
+            xmem_pool_free(&pool, p_owned[slot]);
+            p_owned[slot] = NULL;
+            used--;
+        }
+        else
+        {
+            uint8_t * p_block = xmem_pool_alloc(&pool);
+
+            TEST_CHECK(p_block != NULL);
+            if (!p_block)
+            {
+                continue;
+            }
+            for (uint8_t i = 0; i < M_BLOCK_COUNT; i++)
+            {
+                TEST_CHECK(p_owned[i] != p_block);
+            }
+            memset(p_block, slot, M_BLOCK_SIZE);
+            p_owned[slot] = p_block;
+            used++;
+            peak = used > peak ? used : peak;
+        }
+
+        TEST_CHECK(pool.used == used);
+    }
+
+    xmem_pool_stats_get(&pool, &stats);
+    TEST_CHECK(stats.peak == peak);
+    TEST_CHECK(stats.fail_count == 0);
+}
+
+static void test_default_heap(void)
+{
+    xmem_stats_t stats;
+
+    TEST_CHECK(xmem_init());
+    TEST_CHECK(xmem_heap_get()->p_base == m_heap_mem);
+
+    uint16_t mark = xmem_mark();
+    TEST_CHECK(xmem_alloc(XMEM_HEAP_SIZE, 1) == m_heap_mem);
+    TEST_CHECK(xmem_alloc(1, 1) == NULL);
+    xmem_release(mark);
+
+    xmem_arena_stats_get(xmem_heap_get(), &stats);
+    TEST_CHECK(stats.capacity == XMEM_HEAP_SIZE);
+    TEST_CHECK(stats.used == 0);
+    TEST_CHECK(stats.fail_count == 1);
+}
+
+// Each critical section restores the interrupt flag it found
+static void test_sreg_restored(void)
+{
+    xmem_arena_t arena;
+    xmem_pool_t pool;
+    xmem_stats_t stats;
+
+    SREG = 0x80;
+    xmem_arena_init(&arena, m_mem, M_MEM_SIZE);
+    (void) xmem_arena_alloc(&arena, 8, 4);
+    xmem_arena_release(&arena, xmem_arena_mark(&arena));
+    xmem_arena_stats_get(&arena, &stats);
+    TEST_CHECK(xmem_pool_init(&pool, m_mem, M_BLOCK_SIZE, M_BLOCK_COUNT));
+    xmem_pool_free(&pool, xmem_pool_alloc(&pool));
+    xmem_pool_stats_get(&pool, &stats);
+    TEST_CHECK(SREG == 0x80);
+}
+
+int main(void)
+{
+    TEST_RUN(test_arena_alignment);
+    TEST_RUN(test_arena_exhaustion);
+    TEST_RUN(test_arena_mark_release_cycles);
+    TEST_RUN(test_pool_init_arguments);
+    TEST_RUN(test_pool_exhaustion);
+    TEST_RUN(test_pool_random_cycles);
+    TEST_RUN(test_default_heap);
+    TEST_RUN(test_sreg_restored);
+
+    return TEST_RESULT();
+}
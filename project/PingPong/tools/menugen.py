@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Pre-render the static menu strings of ui.c into PROGMEM bitmaps.
+
+Runs as a pre-build step of Node1:
+
+    python3 menugen.py ui.c fonts.h menu_bitmaps.h
+
+Every menu option string in ui.c, i.e. every
+`static const char m_<menu>_option_<n>[] PROGMEM = "...";`, is rendered with
+the 4x7 font from fonts.h into one OLED page row (one byte per column, LSB on top),
+exactly as oled_printf() would draw it. The output is only rewritten when it
+changes, so an unchanged menu does not trigger a rebuild.
+"""
+
+import re
+import sys
+
+FONT_NAME = "font4"
+FIRST_CHAR = 32
+OLED_WIDTH = 128
+
+OPTION_RE = re.compile(r'\bm_\w+_option_\d+\[\]\s+PROGMEM\s*=\s*"((?:[^"\\]|\\.)*)"')
+GLYPH_RE = re.compile(r"\{([^{}]*)\}")
+
+
+def parse_font(text, name):
+    start = text.index(name + "[")
+    body = text[text.index("{", start) + 1:text.index("};", start)]
+    glyphs = []
+    for match in GLYPH_RE.finditer(body):
+        glyphs.append([int(v, 0) for v in match.group(1).split(",") if v.strip()])
+    return glyphs
+
+
+def parse_strings(text):
+    strings = []
+    for match in OPTION_RE.finditer(text):
+        s = bytes(match.group(1), "latin-1").decode("unicode_escape")
+        if s not in strings:
+            strings.append(s)
+    return strings
+
+
+def render(s, font):
+    columns = []
+    for c in s:
+        index = ord(c) - FIRST_CHAR
+        if not 0 <= index < len(font):
+            sys.exit("menugen: no glyph for %r in %r" % (c, s))
+        columns.extend(font[index])
+    if len(columns) > OLED_WIDTH:
+        sys.exit("menugen: %r is wider than the display" % s)
+    return columns
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def generate(strings, font):
+    out = [
+        "/*",
+        " * Menu strings pre-rendered with %s." % FONT_NAME,
+        " *",
+        " * Generated by tools/menugen.py from ui.c and fonts.h, do not edit.",
+        " */",
+        "#ifndef MENU_BITMAPS_H__",
+        "#define MENU_BITMAPS_H__",
+        "",
+        "#include <stdint.h>",
+        "#include <avr/pgmspace.h>",
+        "",
+        "typedef struct",
+        "{",
+        "    const char * p_text;",
+        "    const uint8_t * p_bitmap;",
+        "    uint8_t width;",
+        "} menu_bitmap_t;",
+        "",
+    ]
+    for i, s in enumerate(strings):
+        columns = render(s, font)
+        out.append("// %s" % s)
+        out.append("static const char m_menu_text_%d[] PROGMEM = %s;" % (i, c_string(s)))
+        out.append("static const uint8_t m_menu_bitmap_%d[%d] PROGMEM = {" % (i, len(columns)))
+        for row in range(0, len(columns), 16):
+            out.append("    " + ", ".join("0x%02X" % b for b in columns[row:row + 16]) + ",")
+        out.append("};")
+        out.append("")
+    out.append("#define MENU_BITMAP_COUNT (%d)" % len(strings))
+    out.append("")
+    out.append("static const menu_bitmap_t menu_bitmaps[MENU_BITMAP_COUNT] PROGMEM = {")
+    for i, s in enumerate(strings):
+        out.append("    { m_menu_text_%d, m_menu_bitmap_%d, %d }," % (i, i, len(render(s, font))))
+    out.append("};")
+    out.append("")
+    out.append("#endif /* MENU_BITMAPS_H__ */")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: menugen.py ui.c fonts.h menu_bitmaps.h")
+    ui_c, fonts_h, out_h = sys.argv[1:]
+
+    with open(ui_c, encoding="latin-1") as f:
+        strings = parse_strings(f.read())
+    with open(fonts_h, encoding="latin-1") as f:
+        font = parse_font(f.read(), FONT_NAME)
+
+    output = generate(strings, font)
+    try:
+        with open(out_h, encoding="latin-1") as f:
+            if f.read() == output:
+                return
+    except FileNotFoundError:
+        pass
+    with open(out_h, "w", encoding="latin-1", newline="\n") as f:
+        f.write(output)
+
+
+if __name__ == "__main__":
+    main()
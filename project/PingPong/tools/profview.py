@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+Render a flat profile from a Node1 profiler dump.
+
+Send 'p' to Node1 over the serial port and capture the output, then:
+
+    python3 profview.py capture.log
+
+Reads stdin if no file is given. Only the last #PROF dump in the input is used.
+Probes may nest (sched_task contains the others), so %total is only a rough
+indication of where the cycles go.
+"""
+
+import sys
+
+BIN_FACTOR = 4
+SPARK = " .:-=+*#%@"
+
+
+def parse(lines):
+    dump = None
+    for line in lines:
+        fields = line.strip().split()
+        if not fields or fields[0] != "#PROF":
+            continue
+        if fields[1] == "begin":
+            dump = {"f_cpu": int(fields[2]), "bins": int(fields[3]), "probes": []}
+        elif fields[1] == "end":
+            continue
+        elif dump is not None:
+            values = [int(v) for v in fields[2:]]
+            dump["probes"].append({
+                "name": fields[1],
+                "count": values[0],
+                "total": values[1],
+                "min": values[2],
+                "max": values[3],
+                "hist": values[4:4 + dump["bins"]],
+            })
+    return dump
+
+
+def sparkline(hist):
+    peak = max(hist) or 1
+    return "".join(SPARK[(h * (len(SPARK) - 1) + peak - 1) // peak] for h in hist)
+
+
+def render(dump):
+    us_per_cycle = 1e6 / dump["f_cpu"]
+    probes = sorted(dump["probes"], key=lambda p: p["total"], reverse=True)
+    grand_total = sum(p["total"] for p in probes) or 1
+
+    print("%-16s %7s %12s %10s %10s %10s  %s" %
+          ("probe", "%total", "calls", "avg [us]", "min [us]", "max [us]",
+           "hist (x%d cycles/bin)" % BIN_FACTOR))
+    for p in probes:
+        avg = p["total"] / p["count"] if p["count"] else 0
+        print("%-16s %6.1f%% %12d %10.1f %10.1f %10.1f  |%s|" % (
+            p["name"],
+            100.0 * p["total"] / grand_total,
+            p["count"],
+            avg * us_per_cycle,
+            p["min"] * us_per_cycle,
+            p["max"] * us_per_cycle,
+            sparkline(p["hist"])))
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    dump = parse(source)
+    if dump is None:
+        sys.exit("no #PROF dump found")
+    render(dump)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Report flash and internal SRAM use of a Node1 build.
+
+Runs as a post-build step of Node1:
+
+    python3 sizereport.py [--size avr-size] PingPong.elf [baseline.elf]
+
+Prints the .text, .data and .bss sizes and the internal SRAM they take up,
+and the size of .xmem in the external SRAM.
+The sizes of each build are saved next to the ELF file. The report compares
+against the baseline ELF if one is given, or otherwise against the previous
+build.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+# ATmega162
+FLASH_SIZE = 16 * 1024
+SRAM_SIZE = 1024
+XMEM_SIZE = 2048
+
+SECTIONS = (".text", ".data", ".bss", ".noinit", ".xmem")
+
+
+def sizes(size_tool, elf):
+    out = subprocess.run([size_tool, "-A", elf], check=True,
+                         capture_output=True, text=True).stdout
+    result = dict.fromkeys(SECTIONS, 0)
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in result:
+            result[fields[0]] = int(fields[1])
+    return result
+
+
+def usage(s):
+    flash = s[".text"] + s[".data"]
+    ram = s[".data"] + s[".bss"] + s[".noinit"]
+    return flash, ram
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--size", default="avr-size", help="avr-size executable")
+    parser.add_argument("elf")
+    parser.add_argument("baseline", nargs="?")
+    args = parser.parse_args()
+
+    current = sizes(args.size, args.elf)
+    saved = args.elf + ".sizes.json"
+
+    if args.baseline:
+        previous = sizes(args.size, args.baseline)
+    elif os.path.exists(saved):
+        with open(saved) as f:
+            previous = json.load(f)
+    else:
+        previous = None
+
+    print("%-8s %8s %8s" % ("section", "bytes", "change"))
+    for name in SECTIONS:
+        change = "" if previous is None else "%+d" % (current[name] - previous.get(name, 0))
+        print("%-8s %8d %8s" % (name, current[name], change))
+
+    flash, ram = usage(current)
+    print("flash    %8d  %5.1f%% of %d" % (flash, 100.0 * flash / FLASH_SIZE, FLASH_SIZE))
+    print("sram     %8d  %5.1f%% of %d (stack not included)" % (ram, 100.0 * ram / SRAM_SIZE, SRAM_SIZE))
+    xmem = current[".xmem"]
+    print("xmem     %8d  %5.1f%% of %d" % (xmem, 100.0 * xmem / XMEM_SIZE, XMEM_SIZE))
+
+    with open(saved, "w") as f:
+        json.dump(current, f)
+
+    if ram > SRAM_SIZE:
+        sys.exit("sizereport: static data does not fit in internal SRAM")
+    if xmem > XMEM_SIZE:
+        sys.exit("sizereport: .xmem does not fit in external SRAM")
+
+
+if __name__ == "__main__":
+    main()